@@ -0,0 +1,91 @@
+#pragma once
+
+// Wire format between perf-agent (device) and perf-doctor (host).
+// Every record starts with a RecordHeader, all fields are little endian and the structs are packed,
+// so the host can decode them with a memcpy. Timestamps are CLOCK_MONOTONIC, the same clock as SurfaceFlinger.
+
+#include <cstdint>
+
+namespace agent
+{
+    const uint32_t kProtocolVersion = 1;
+    const int kDefaultPort = 27183;
+
+    enum RecordType : uint16_t
+    {
+        RECORD_HELLO = 1,
+        RECORD_CPU,
+        RECORD_APP_CPU,
+        RECORD_MEMORY,
+        RECORD_THERMAL,
+        RECORD_FRAME,
+    };
+
+#pragma pack(push, 1)
+    struct RecordHeader
+    {
+        uint16_t type;
+        uint16_t size; // of the whole record, header included
+        uint32_t reserved;
+        uint64_t timestamp_ns;
+    };
+
+    struct HelloRecord
+    {
+        RecordHeader header;
+        uint32_t version;
+        uint32_t cpu_count;
+    };
+
+    // One line of /proc/stat plus scaling_cur_freq, cpu_id is -1 for the total line
+    struct CpuRecord
+    {
+        RecordHeader header;
+        int32_t cpu_id;
+        int32_t freq_khz; // -1 if unknown
+        uint64_t user, nice, sys, idle, iowait, irq, softirq;
+    };
+
+    // /proc/<pid>/stat
+    struct AppCpuRecord
+    {
+        RecordHeader header;
+        uint64_t utime, stime, cutime, cstime;
+    };
+
+    // /proc/<pid>/smaps_rollup
+    struct MemoryRecord
+    {
+        RecordHeader header;
+        uint32_t pss_kb;
+        uint32_t private_clean_kb;
+        uint32_t private_dirty_kb;
+        uint32_t swap_pss_kb;
+    };
+
+    // thermal_zone*/temp in millidegree, INT32_MIN if the zone is unknown
+    struct ThermalRecord
+    {
+        RecordHeader header;
+        int32_t cpu, gpu, battery;
+        int32_t reserved;
+    };
+
+    // One line of `dumpsys SurfaceFlinger --latency`, refresh_period_ns is the header of the window
+    struct FrameRecord
+    {
+        RecordHeader header;
+        int64_t desired_present_ns;
+        int64_t actual_present_ns;
+        int64_t frame_ready_ns;
+        int64_t refresh_period_ns;
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(RecordHeader) == 16, "wire format");
+    static_assert(sizeof(CpuRecord) == 16 + 8 + 7 * 8, "wire format");
+    static_assert(sizeof(FrameRecord) == 16 + 4 * 8, "wire format");
+
+    // largest record, the receiver rejects anything bigger as a corrupt stream
+    const uint16_t kMaxRecordSize = sizeof(CpuRecord);
+}
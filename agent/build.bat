@@ -0,0 +1,9 @@
+@echo off
+REM Builds perf-agent for arm64 Android, the binary is shipped next to perfetto in Bin/adb
+REM Linux x86_64: g++ -O2 -std=c++17 -o perf-agent perf-agent.cpp
+IF "%ANDROID_NDK_HOME%"=="" (
+    echo ANDROID_NDK_HOME is not set
+    exit /b 1
+)
+cd %~dp0
+"%ANDROID_NDK_HOME%\toolchains\llvm\prebuilt\windows-x86_64\bin\clang++.exe" --target=aarch64-linux-android24 -O2 -std=c++17 -static-libstdc++ -o ..\Bin\adb\perf-agent perf-agent.cpp
@@ -0,0 +1,337 @@
+// perf-agent: samples /proc, /sys and SurfaceFlinger on the device and streams binary records to perf-doctor.
+//
+// Android: build.bat (NDK), pushed to /data/local/tmp/perf-agent and reached through `adb forward tcp:N tcp:N`
+// Linux:   g++ -O2 -std=c++17 -o perf-agent perf-agent.cpp
+//
+// perf-agent --port 27183 --pid 1234 [--surface "SurfaceView - ..."] [--thermal-cpu path] [--thermal-gpu path]
+//            [--thermal-battery path] [--cpu-hz 20] [--mem-hz 4] [--frame-hz 4] [--thermal-hz 1]
+
+#include "AgentProtocol.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace std;
+using namespace agent;
+
+struct Options
+{
+    int port = kDefaultPort;
+    int pid = 0;
+    string surface;
+    string thermalCpu, thermalGpu, thermalBattery;
+    float cpuHz = 20;
+    float memHz = 4;
+    float frameHz = 4;
+    float thermalHz = 1;
+};
+
+static uint64_t nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template <typename T>
+static void initRecord(T& record, RecordType type, uint64_t timestamp)
+{
+    memset(&record, 0, sizeof(T));
+    record.header.type = type;
+    record.header.size = sizeof(T);
+    record.header.timestamp_ns = timestamp;
+}
+
+// Reads a whole /proc or /sys file with a single read(), they are generated on the fly and can't be mmapped
+static bool readFile(const char* path, string& content)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    content.clear();
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        content.append(buf, n);
+    close(fd);
+    return true;
+}
+
+struct Sampler
+{
+    Options options;
+    string buffer; // records waiting to be sent
+    string content;
+    int cpuCount = 0;
+    int64_t lastFrameReady = 0;
+
+    template <typename T>
+    void emit(const T& record)
+    {
+        buffer.append((const char*)&record, sizeof(T));
+    }
+
+    void sampleCpu()
+    {
+        auto ts = nowNs();
+        if (!readFile("/proc/stat", content)) return;
+
+        const char* p = content.c_str();
+        while (strncmp(p, "cpu", 3) == 0)
+        {
+            CpuRecord record;
+            initRecord(record, RECORD_CPU, ts);
+            record.freq_khz = -1;
+            record.cpu_id = -1;
+            p += 3;
+            if (*p >= '0' && *p <= '9')
+                record.cpu_id = strtol(p, (char**)&p, 10);
+            unsigned long long v[7] = {};
+            for (auto& value : v)
+                value = strtoull(p, (char**)&p, 10);
+            record.user = v[0]; record.nice = v[1]; record.sys = v[2]; record.idle = v[3];
+            record.iowait = v[4]; record.irq = v[5]; record.softirq = v[6];
+
+            if (record.cpu_id >= 0)
+            {
+                char path[128];
+                string freq;
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", record.cpu_id);
+                if (readFile(path, freq))
+                    record.freq_khz = atoi(freq.c_str());
+            }
+            emit(record);
+
+            p = strchr(p, '\n');
+            if (!p) break;
+            p++;
+        }
+
+        if (options.pid > 0)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%d/stat", options.pid);
+            if (readFile(path, content))
+            {
+                // comm may contain spaces, the fields are counted from the closing parenthesis
+                auto pos = content.rfind(')');
+                if (pos != string::npos)
+                {
+                    AppCpuRecord record;
+                    initRecord(record, RECORD_APP_CPU, ts);
+                    const char* q = content.c_str() + pos + 1;
+                    // state is field 3, utime is field 14
+                    int field = 2;
+                    while (*q && field < 14)
+                    {
+                        if (*q == ' ') field++;
+                        q++;
+                    }
+                    record.utime = strtoull(q, (char**)&q, 10);
+                    record.stime = strtoull(q, (char**)&q, 10);
+                    record.cutime = strtoull(q, (char**)&q, 10);
+                    record.cstime = strtoull(q, (char**)&q, 10);
+                    emit(record);
+                }
+            }
+        }
+    }
+
+    void sampleMemory()
+    {
+        if (options.pid <= 0) return;
+
+        auto ts = nowNs();
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", options.pid);
+        if (!readFile(path, content)) return;
+
+        MemoryRecord record;
+        initRecord(record, RECORD_MEMORY, ts);
+        const char* p = content.c_str();
+        while (p && *p)
+        {
+            auto value = [&](const char* key, uint32_t& field) {
+                auto len = strlen(key);
+                if (strncmp(p, key, len) == 0)
+                    field = strtoul(p + len, nullptr, 10);
+            };
+            value("Pss:", record.pss_kb);
+            value("Private_Clean:", record.private_clean_kb);
+            value("Private_Dirty:", record.private_dirty_kb);
+            value("SwapPss:", record.swap_pss_kb);
+            p = strchr(p, '\n');
+            if (p) p++;
+        }
+        emit(record);
+    }
+
+    void sampleThermal()
+    {
+        ThermalRecord record;
+        initRecord(record, RECORD_THERMAL, nowNs());
+        auto zone = [&](const string& path) {
+            if (path.empty() || !readFile(path.c_str(), content)) return INT32_MIN;
+            return atoi(content.c_str());
+        };
+        record.cpu = zone(options.thermalCpu);
+        record.gpu = zone(options.thermalGpu);
+        record.battery = zone(options.thermalBattery);
+        emit(record);
+    }
+
+    void sampleFrames()
+    {
+        if (options.surface.empty()) return;
+
+        // SurfaceFlinger has no file interface, the only way in from the shell uid is the dumpsys binder call
+        string cmd = "dumpsys SurfaceFlinger --latency '" + options.surface + "'";
+        FILE* fp = popen(cmd.c_str(), "r");
+        if (!fp) return;
+
+        auto ts = nowNs();
+        char line[256];
+        int64_t refreshPeriod = 0;
+        int64_t maxFrameReady = lastFrameReady;
+        while (fgets(line, sizeof(line), fp))
+        {
+            long long a = 0, b = 0, c = 0;
+            int n = sscanf(line, "%lld %lld %lld", &a, &b, &c);
+            if (n == 1 && refreshPeriod == 0)
+            {
+                refreshPeriod = a;
+                continue;
+            }
+            // pending fences are reported as INT64_MAX, empty slots as 0
+            if (n != 3 || a == 0 || c == INT64_MAX) continue;
+            if (c <= lastFrameReady) continue;
+
+            FrameRecord record;
+            initRecord(record, RECORD_FRAME, ts);
+            record.desired_present_ns = a;
+            record.actual_present_ns = b;
+            record.frame_ready_ns = c;
+            record.refresh_period_ns = refreshPeriod;
+            emit(record);
+            if (c > maxFrameReady) maxFrameReady = c;
+        }
+        pclose(fp);
+        lastFrameReady = maxFrameReady;
+    }
+};
+
+static bool sendAll(int fd, const string& data)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        auto n = send(fd, data.c_str() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        offset += n;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Sampler sampler;
+    auto& options = sampler.options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string key = argv[i];
+        const char* value = argv[i + 1];
+        if (key == "--port") options.port = atoi(value);
+        else if (key == "--pid") options.pid = atoi(value);
+        else if (key == "--surface") options.surface = value;
+        else if (key == "--thermal-cpu") options.thermalCpu = value;
+        else if (key == "--thermal-gpu") options.thermalGpu = value;
+        else if (key == "--thermal-battery") options.thermalBattery = value;
+        else if (key == "--cpu-hz") options.cpuHz = atof(value);
+        else if (key == "--mem-hz") options.memHz = atof(value);
+        else if (key == "--frame-hz") options.frameHz = atof(value);
+        else if (key == "--thermal-hz") options.thermalHz = atof(value);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", key.c_str());
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(options.port);
+    if (bind(server, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 1) != 0)
+    {
+        perror("perf-agent: bind");
+        return 1;
+    }
+    printf("perf-agent listening on %d\n", options.port);
+    fflush(stdout);
+
+    // one client, the agent exits when perf-doctor disconnects
+    int client = accept(server, nullptr, nullptr);
+    close(server);
+    if (client < 0) return 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sampler.cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    HelloRecord hello;
+    initRecord(hello, RECORD_HELLO, nowNs());
+    // the latency window still holds up to 128 frames from before we started, the session begins now
+    sampler.lastFrameReady = hello.header.timestamp_ns;
+    hello.version = kProtocolVersion;
+    hello.cpu_count = sampler.cpuCount;
+    sampler.emit(hello);
+
+    auto period = [](float hz) -> uint64_t { return hz > 0 ? uint64_t(1e9 / hz) : UINT64_MAX; };
+    uint64_t cpuPeriod = period(options.cpuHz);
+    uint64_t memPeriod = period(options.memHz);
+    uint64_t framePeriod = period(options.frameHz);
+    uint64_t thermalPeriod = period(options.thermalHz);
+    uint64_t nextCpu = 0, nextMem = 0, nextFrame = 0, nextThermal = 0;
+
+    while (true)
+    {
+        auto now = nowNs();
+        if (now >= nextCpu) { sampler.sampleCpu(); nextCpu = now + cpuPeriod; }
+        if (now >= nextMem) { sampler.sampleMemory(); nextMem = now + memPeriod; }
+        if (now >= nextFrame) { sampler.sampleFrames(); nextFrame = now + framePeriod; }
+        if (now >= nextThermal) { sampler.sampleThermal(); nextThermal = now + thermalPeriod; }
+
+        if (!sampler.buffer.empty())
+        {
+            if (!sendAll(client, sampler.buffer))
+                break;
+            sampler.buffer.clear();
+        }
+
+        uint64_t next = min(min(nextCpu, nextMem), min(nextFrame, nextThermal));
+        now = nowNs();
+        if (next > now)
+        {
+            timespec ts = { time_t((next - now) / 1000000000ull), long((next - now) % 1000000000ull) };
+            nanosleep(&ts, nullptr);
+        }
+    }
+
+    close(client);
+    return 0;
+}
@@ -0,0 +1,337 @@
+#include "AdbClient.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+namespace
+{
+    const int kConnectTimeoutMs = 1000;
+    const int kReplyTimeoutMs = 10000;
+    const size_t kSyncMaxChunk = 64 * 1024;
+    const size_t kMaxIdleSyncs = 2; // per device
+
+    void putU32(char* dst, uint32_t value)
+    {
+        dst[0] = (char)(value & 0xff);
+        dst[1] = (char)((value >> 8) & 0xff);
+        dst[2] = (char)((value >> 16) & 0xff);
+        dst[3] = (char)((value >> 24) & 0xff);
+    }
+
+    uint32_t getU32(const char* src)
+    {
+        auto p = (const uint8_t*)src;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    // sync requests are a 4 byte id followed by a little-endian length or value
+    bool sendSyncPacket(TcpSocket& socket, const char* id, uint32_t value, const char* data = nullptr, size_t len = 0)
+    {
+        char header[8];
+        memcpy(header, id, 4);
+        putU32(header + 4, value);
+        if (!socket.sendAll(header, sizeof(header))) return false;
+        return len == 0 || socket.sendAll(data, len);
+    }
+
+    bool recvSyncPacket(TcpSocket& socket, char id[4], uint32_t& value)
+    {
+        char header[8];
+        if (!socket.recvAll(header, sizeof(header), kReplyTimeoutMs)) return false;
+        memcpy(id, header, 4);
+        value = getU32(header + 4);
+        return true;
+    }
+}
+
+AdbClient::AdbClient(const string& host, int port) : mHost(host), mPort(port)
+{
+}
+
+string AdbClient::getLastError()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mLastError;
+}
+
+void AdbClient::setLastError(const string& error)
+{
+    lock_guard<mutex> lock(mMutex);
+    mLastError = error;
+}
+
+bool AdbClient::connect(TcpSocket& socket)
+{
+    if (!socket.connect(mHost, mPort, kConnectTimeoutMs))
+    {
+        setLastError("adb server is not running");
+        return false;
+    }
+    return true;
+}
+
+bool AdbClient::sendRequest(TcpSocket& socket, const string& request)
+{
+    char prefix[8];
+    snprintf(prefix, sizeof(prefix), "%04x", (unsigned)request.size());
+    if (!socket.sendAll(prefix, 4) || !socket.sendAll(request))
+    {
+        setLastError("failed to send " + request);
+        return false;
+    }
+    return readStatus(socket);
+}
+
+bool AdbClient::readStatus(TcpSocket& socket)
+{
+    char status[4];
+    if (!socket.recvAll(status, sizeof(status), kReplyTimeoutMs))
+    {
+        setLastError("no reply from adb server");
+        return false;
+    }
+    if (memcmp(status, "OKAY", 4) == 0)
+        return true;
+
+    string message = "unknown reply from adb server";
+    if (memcmp(status, "FAIL", 4) == 0)
+        readLengthPrefixed(socket, message);
+    setLastError(message);
+    return false;
+}
+
+bool AdbClient::readLengthPrefixed(TcpSocket& socket, string& data)
+{
+    char prefix[5] = {};
+    if (!socket.recvAll(prefix, 4, kReplyTimeoutMs))
+        return false;
+    size_t len = strtoul(prefix, nullptr, 16);
+    data.resize(len);
+    return len == 0 || socket.recvAll(&data[0], len, kReplyTimeoutMs);
+}
+
+bool AdbClient::isServerRunning()
+{
+    string version;
+    return hostQuery("host:version", version);
+}
+
+bool AdbClient::hostQuery(const string& service, string& response)
+{
+    TcpSocket socket;
+    if (!connect(socket) || !sendRequest(socket, service))
+        return false;
+    return readLengthPrefixed(socket, response);
+}
+
+bool AdbClient::openStream(const string& serial, const string& service, TcpSocket& stream)
+{
+    TcpSocket socket;
+    if (!connect(socket))
+        return false;
+
+    string transport = serial.empty() ? "host:transport-any" : "host:transport:" + serial;
+    if (!sendRequest(socket, transport) || !sendRequest(socket, service))
+        return false;
+
+    stream = move(socket);
+    return true;
+}
+
+bool AdbClient::shell(const string& serial, const string& cmd, string& output, int timeoutMs)
+{
+    output.clear();
+    TcpSocket stream;
+    if (!openStream(serial, "shell:" + cmd, stream))
+        return false;
+
+    // the device closes the stream once the command exits
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    char buf[16 * 1024];
+    while (true)
+    {
+        auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+        {
+            setLastError("timeout: " + cmd);
+            return false;
+        }
+        int n = stream.recvSome(buf, sizeof(buf), (int)remaining);
+        if (n < 0)
+            break;
+        output.append(buf, n);
+    }
+    return true;
+}
+
+bool AdbClient::forward(const string& serial, const string& local, const string& remote)
+{
+    TcpSocket socket;
+    if (!connect(socket))
+        return false;
+
+    string service = serial.empty() ? "host:forward:" : "host-serial:" + serial + ":forward:";
+    // the first OKAY acknowledges the request, the second one the forward itself
+    return sendRequest(socket, service + local + ";" + remote) && readStatus(socket);
+}
+
+unique_ptr<TcpSocket> AdbClient::acquireSync(const string& serial)
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        auto& idle = mIdleSyncs[serial];
+        while (!idle.empty())
+        {
+            auto socket = move(idle.back());
+            idle.pop_back();
+            if (socket->isOpen())
+                return socket;
+        }
+    }
+
+    auto socket = make_unique<TcpSocket>();
+    if (!openStream(serial, "sync:", *socket))
+        return nullptr;
+    return socket;
+}
+
+void AdbClient::releaseSync(const string& serial, unique_ptr<TcpSocket> socket)
+{
+    lock_guard<mutex> lock(mMutex);
+    auto& idle = mIdleSyncs[serial];
+    if (socket->isOpen() && idle.size() < kMaxIdleSyncs)
+        idle.emplace_back(move(socket));
+}
+
+bool AdbClient::pull(const string& serial, const string& remotePath, const string& localPath)
+{
+    auto socket = acquireSync(serial);
+    if (!socket)
+        return false;
+
+    if (!sendSyncPacket(*socket, "RECV", (uint32_t)remotePath.size(), remotePath.c_str(), remotePath.size()))
+    {
+        setLastError("failed to request " + remotePath);
+        return false;
+    }
+
+    FILE* fp = fopen(localPath.c_str(), "wb");
+    if (!fp)
+    {
+        // the transfer is already running, the connection can't be reused
+        setLastError("failed to write " + localPath);
+        return false;
+    }
+
+    vector<char> chunk;
+    bool ok = false;
+    while (true)
+    {
+        char id[4];
+        uint32_t len = 0;
+        if (!recvSyncPacket(*socket, id, len))
+        {
+            setLastError("connection lost while pulling " + remotePath);
+            break;
+        }
+        if (memcmp(id, "DONE", 4) == 0)
+        {
+            ok = true;
+            break;
+        }
+        if (memcmp(id, "FAIL", 4) == 0)
+        {
+            string message(len, '\0');
+            if (len > 0) socket->recvAll(&message[0], len, kReplyTimeoutMs);
+            setLastError(remotePath + ": " + message);
+            break;
+        }
+        if (memcmp(id, "DATA", 4) != 0 || len > kSyncMaxChunk)
+        {
+            setLastError("unexpected sync reply while pulling " + remotePath);
+            break;
+        }
+        chunk.resize(len);
+        if (!socket->recvAll(chunk.data(), len, kReplyTimeoutMs))
+        {
+            setLastError("connection lost while pulling " + remotePath);
+            break;
+        }
+        fwrite(chunk.data(), 1, len, fp);
+    }
+    fclose(fp);
+
+    if (ok)
+        releaseSync(serial, move(socket));
+    else
+        remove(localPath.c_str());
+    return ok;
+}
+
+bool AdbClient::push(const string& serial, const string& localPath, const string& remotePath, int mode)
+{
+    FILE* fp = fopen(localPath.c_str(), "rb");
+    if (!fp)
+    {
+        setLastError("failed to read " + localPath);
+        return false;
+    }
+
+    auto socket = acquireSync(serial);
+    if (!socket)
+    {
+        fclose(fp);
+        return false;
+    }
+
+    // regular file bit plus the permissions
+    string spec = remotePath + "," + to_string(0100000 | mode);
+    bool ok = sendSyncPacket(*socket, "SEND", (uint32_t)spec.size(), spec.c_str(), spec.size());
+
+    vector<char> chunk(kSyncMaxChunk);
+    while (ok)
+    {
+        size_t n = fread(chunk.data(), 1, chunk.size(), fp);
+        if (n == 0) break;
+        ok = sendSyncPacket(*socket, "DATA", (uint32_t)n, chunk.data(), n);
+    }
+    fclose(fp);
+
+    ok = ok && sendSyncPacket(*socket, "DONE", (uint32_t)time(nullptr));
+    if (!ok)
+    {
+        setLastError("connection lost while pushing " + localPath);
+        return false;
+    }
+
+    char id[4];
+    uint32_t len = 0;
+    if (!recvSyncPacket(*socket, id, len))
+    {
+        setLastError("connection lost while pushing " + localPath);
+        return false;
+    }
+    if (memcmp(id, "OKAY", 4) != 0)
+    {
+        string message(len, '\0');
+        if (len > 0 && len < kSyncMaxChunk) socket->recvAll(&message[0], len, kReplyTimeoutMs);
+        setLastError(remotePath + ": " + message);
+        return false;
+    }
+
+    releaseSync(serial, move(socket));
+    return true;
+}
+
+AdbClient& getAdbClient()
+{
+    // the port adb itself is pointed at, the tests use it to keep away from a real server
+    auto port = getenv("ANDROID_ADB_SERVER_PORT");
+    static AdbClient client("127.0.0.1", port ? atoi(port) : 5037);
+    return client;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Socket.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+// Talks to the adb server (tcp:5037) directly instead of launching adb.exe for every command.
+// https://android.googlesource.com/platform/packages/modules/adb/+/refs/heads/main/docs/dev/services.md
+//
+// Every call opens its own connection, so streams to one or several devices can run concurrently.
+// Sync connections are kept per device and reused by the following push/pull.
+struct AdbClient
+{
+    AdbClient(const std::string& host = "127.0.0.1", int port = 5037);
+
+    // false if no adb server is listening, callers fall back to the adb executable which also starts one
+    bool isServerRunning();
+
+    // host:version, host:devices, host-serial:<serial>:forward:tcp:1;tcp:2 ...
+    bool hostQuery(const std::string& service, std::string& response);
+
+    // host:transport:<serial> then <service>, the returned socket is the raw stream of the service
+    bool openStream(const std::string& serial, const std::string& service, TcpSocket& stream);
+
+    // shell:<cmd>, returns the combined stdout and stderr
+    bool shell(const std::string& serial, const std::string& cmd, std::string& output, int timeoutMs = 10000);
+
+    bool forward(const std::string& serial, const std::string& local, const std::string& remote);
+
+    bool pull(const std::string& serial, const std::string& remotePath, const std::string& localPath);
+    bool push(const std::string& serial, const std::string& localPath, const std::string& remotePath, int mode = 0755);
+
+    std::string getLastError();
+
+private:
+    bool connect(TcpSocket& socket);
+    bool sendRequest(TcpSocket& socket, const std::string& request);
+    bool readStatus(TcpSocket& socket);
+    bool readLengthPrefixed(TcpSocket& socket, std::string& data);
+    void setLastError(const std::string& error);
+
+    std::unique_ptr<TcpSocket> acquireSync(const std::string& serial);
+    void releaseSync(const std::string& serial, std::unique_ptr<TcpSocket> socket);
+
+    std::string mHost;
+    int mPort;
+
+    std::mutex mMutex;
+    std::string mLastError;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<TcpSocket>>> mIdleSyncs; // serial -> idle sync connections
+};
+
+// The adb server shared by the whole app
+AdbClient& getAdbClient();
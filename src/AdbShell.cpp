@@ -0,0 +1,242 @@
+#include "AdbShell.h"
+#include "AdbClient.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+string shellQuote(const string& arg)
+{
+    string quoted = "'";
+    for (auto c : arg)
+    {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    quoted += "'";
+    return quoted;
+}
+
+AdbShell::AdbShell(const string& adbExe, const string& serial)
+    : mAdbExe(adbExe), mSerial(serial)
+{
+    // a random tag so that app output can't be mistaken for a sentinel
+    random_device rd;
+    char tag[32];
+    sprintf(tag, "__perf_doctor_%08x", rd());
+    mSentinel = tag;
+}
+
+AdbShell::~AdbShell()
+{
+    stop();
+}
+
+bool AdbShell::startProcess()
+{
+    mProcess = make_unique<Process>();
+    if (!mProcess->start("\"" + mAdbExe + "\" -s " + mSerial + " shell", true))
+    {
+        mProcess.reset();
+        return false;
+    }
+    mPending.clear();
+    mAlive = true;
+    return true;
+}
+
+void AdbShell::stopProcess()
+{
+    if (!mProcess) return;
+
+    mProcess->writeStdin("exit\n");
+    mProcess->closeStdin();
+    int exitCode;
+    if (!mProcess->wait(500, exitCode))
+        mProcess->kill();
+    mProcess.reset();
+}
+
+bool AdbShell::writePipe(const string& data)
+{
+    return mProcess && mProcess->writeStdin(data);
+}
+
+bool AdbShell::readPipe(int timeoutMs)
+{
+    // stderr goes to mPending as well, it is redirected per command on the device anyway
+    return mProcess && mProcess->read(mPending, nullptr, timeoutMs) >= 0;
+}
+
+bool AdbShell::start()
+{
+    stop();
+
+    // exec: has no pty so nothing is echoed back, adb.exe is only needed when the server isn't up yet
+    if (getAdbClient().openStream(mSerial, "exec:sh", mStream))
+    {
+        mPending.clear();
+        mAlive = true;
+        return true;
+    }
+    return startProcess();
+}
+
+void AdbShell::stop()
+{
+    if (mStream.isOpen())
+    {
+        mStream.sendAll("exit\n");
+        mStream.close();
+    }
+    stopProcess();
+    mAlive = false;
+}
+
+bool AdbShell::writeAll(const string& data)
+{
+    if (mStream.isOpen())
+        return mStream.sendAll(data);
+    return writePipe(data);
+}
+
+bool AdbShell::readSome(int timeoutMs)
+{
+    if (mStream.isOpen())
+    {
+        char buf[4096];
+        int n = mStream.recvSome(buf, sizeof(buf), timeoutMs);
+        if (n < 0)
+            return false; // the device side shell exited
+        mPending.append(buf, n);
+        return true;
+    }
+    return readPipe(timeoutMs);
+}
+
+string AdbShell::wrapCommand(const string& cmd, uint32_t idx)
+{
+    // { cmd
+    // } </dev/null 2>&1; echo; echo <sentinel>:<batch>:<idx>
+    // The extra echo guarantees the sentinel starts a line even if the output lacks a trailing newline.
+    char tag[64];
+    sprintf(tag, "%s:%u:%u", mSentinel.c_str(), mBatchId, idx);
+    return "{ " + cmd + "\n} </dev/null 2>&1; echo; echo " + tag + "\n";
+}
+
+bool AdbShell::readUntil(uint32_t idx, chrono::steady_clock::time_point deadline, string& output)
+{
+    char tag[64];
+    sprintf(tag, "\n%s:%u:%u", mSentinel.c_str(), mBatchId, idx);
+    size_t tagLen = strlen(tag);
+
+    size_t searchFrom = 0;
+    while (true)
+    {
+        auto pos = mPending.find(tag, searchFrom);
+        // the tag must be a whole line, ":1" is also the prefix of ":10"
+        if (pos != string::npos && pos + tagLen < mPending.size())
+        {
+            char next = mPending[pos + tagLen];
+            if (next == '\n' || next == '\r')
+            {
+                auto end = mPending.find('\n', pos + tagLen);
+                size_t outputLen = pos;
+                if (outputLen > 0 && mPending[outputLen - 1] == '\r')
+                    outputLen--;
+                output.assign(mPending, 0, outputLen);
+                mPending.erase(0, end + 1);
+                return true;
+            }
+            searchFrom = pos + 1;
+            continue;
+        }
+        if (mPending.size() > tagLen)
+            searchFrom = mPending.size() - tagLen;
+
+        auto now = chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            // the late output would be mixed up with the next batch, start over with a fresh shell
+            stop();
+            return false;
+        }
+        int timeoutMs = (int)chrono::duration_cast<chrono::milliseconds>(deadline - now).count();
+        if (!readSome(timeoutMs))
+        {
+            stop();
+            return false;
+        }
+    }
+}
+
+bool AdbShell::execute(const vector<string>& cmds, vector<vector<string>>& outputs, float timeoutSeconds)
+{
+    outputs.clear();
+    outputs.resize(cmds.size());
+    if (!mAlive) return false;
+
+    mBatchId++;
+    string script;
+    for (size_t i = 0; i < cmds.size(); i++)
+        script += wrapCommand(cmds[i], i);
+    if (!writeAll(script))
+    {
+        stop();
+        return false;
+    }
+
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(int(timeoutSeconds * 1000));
+    string output;
+    for (size_t i = 0; i < cmds.size(); i++)
+    {
+        if (!readUntil(i, deadline, output))
+            return false;
+
+        size_t lineStart = 0;
+        while (lineStart < output.size())
+        {
+            auto lineEnd = output.find('\n', lineStart);
+            if (lineEnd == string::npos)
+                lineEnd = output.size();
+            auto len = lineEnd - lineStart;
+            if (len > 0 && output[lineEnd - 1] == '\r')
+                len--;
+            if (len > 0)
+                outputs[i].push_back(output.substr(lineStart, len));
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    return true;
+}
+
+vector<string> AdbShell::execute(const string& cmd, float timeoutSeconds)
+{
+    vector<vector<string>> outputs;
+    if (!execute({ cmd }, outputs, timeoutSeconds))
+        return {};
+    return outputs[0];
+}
+
+bool AdbShell::executeRaw(const string& cmd, string& output, float timeoutSeconds)
+{
+    output.clear();
+    if (!mAlive) return false;
+
+    mBatchId++;
+    if (!writeAll(wrapCommand(cmd, 0)))
+    {
+        stop();
+        return false;
+    }
+
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(int(timeoutSeconds * 1000));
+    return readUntil(0, deadline, output);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Socket.h"
+#include "Process.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+
+// A long-lived shell session on the device, an `exec:sh` stream of the adb server
+// or an `adb -s <serial> shell` process when the server can't be reached.
+// Commands are written to the stdin of the shell, each one followed by an echo of a sentinel line,
+// so a whole batch of probes costs one round trip and the output is split back per command.
+struct AdbShell
+{
+    AdbShell(const std::string& adbExe, const std::string& serial);
+    ~AdbShell();
+
+    bool start();
+    void stop();
+    bool isAlive() const { return mAlive; }
+    const std::string& getSerial() const { return mSerial; }
+
+    // Runs every command of the batch, outputs[i] receives the non-empty lines printed by cmds[i].
+    // Returns false if the shell died or timed out, the session is stopped and needs a start() then.
+    bool execute(const std::vector<std::string>& cmds, std::vector<std::vector<std::string>>& outputs, float timeoutSeconds = 5);
+
+    std::vector<std::string> execute(const std::string& cmd, float timeoutSeconds = 5);
+
+    // Same round trip but the output is returned untouched, e.g. for framed sample scripts
+    bool executeRaw(const std::string& cmd, std::string& output, float timeoutSeconds = 5);
+
+private:
+    std::string wrapCommand(const std::string& cmd, uint32_t idx);
+    // Reads until the sentinel of command idx in the current batch, output receives what was printed before it
+    bool readUntil(uint32_t idx, std::chrono::steady_clock::time_point deadline, std::string& output);
+    bool writeAll(const std::string& data);
+    // Appends whatever is readable to mPending, waits at most timeoutMs
+    bool readSome(int timeoutMs);
+
+    bool startProcess();
+    void stopProcess();
+    bool writePipe(const std::string& data);
+    bool readPipe(int timeoutMs);
+
+    std::string mAdbExe;
+    std::string mSerial;
+    std::string mSentinel;
+    std::string mPending;
+    uint32_t mBatchId = 0;
+    bool mAlive = false;
+
+    TcpSocket mStream;
+    std::unique_ptr<Process> mProcess;
+};
+
+// Quotes an argument for the device side shell, e.g. a SurfaceView name with spaces
+std::string shellQuote(const std::string& arg);
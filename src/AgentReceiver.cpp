@@ -0,0 +1,82 @@
+#include "AgentReceiver.h"
+
+#include <cstring>
+
+using namespace std;
+using namespace agent;
+
+bool AgentReceiver::connect(int port, int timeoutMs)
+{
+    mPending.clear();
+    return mSocket.connect("127.0.0.1", port, timeoutMs);
+}
+
+template <typename T>
+static void decode(const char* data, uint16_t size, vector<T>& records)
+{
+    if (size < sizeof(T)) return;
+    records.emplace_back();
+    memcpy(&records.back(), data, sizeof(T));
+}
+
+bool AgentReceiver::receive(AgentSamples& samples, int timeoutMs)
+{
+    char buf[16 * 1024];
+    int n = mSocket.recvSome(buf, sizeof(buf), timeoutMs);
+    if (n < 0)
+        return false;
+    // drain whatever else is already queued without waiting again
+    while (n > 0)
+    {
+        mPending.append(buf, n);
+        n = mSocket.recvSome(buf, sizeof(buf), 0);
+    }
+
+    size_t offset = 0;
+    while (mPending.size() - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader header;
+        memcpy(&header, mPending.data() + offset, sizeof(header));
+        if (header.size < sizeof(RecordHeader) || header.size > kMaxRecordSize)
+        {
+            mSocket.close();
+            return false;
+        }
+        if (mPending.size() - offset < header.size)
+            break;
+
+        const char* data = mPending.data() + offset;
+        switch (header.type)
+        {
+        case RECORD_HELLO:
+        {
+            // a truncated hello is no agent we know, the version is in its tail
+            HelloRecord hello;
+            if (header.size < sizeof(hello))
+            {
+                mSocket.close();
+                return false;
+            }
+            memcpy(&hello, data, sizeof(hello));
+            if (hello.version != kProtocolVersion)
+            {
+                mSocket.close();
+                return false;
+            }
+            samples.start_ns = hello.header.timestamp_ns;
+            samples.cpu_count = hello.cpu_count;
+            break;
+        }
+        case RECORD_CPU: decode(data, header.size, samples.cpu); break;
+        case RECORD_APP_CPU: decode(data, header.size, samples.app_cpu); break;
+        case RECORD_MEMORY: decode(data, header.size, samples.memory); break;
+        case RECORD_THERMAL: decode(data, header.size, samples.thermal); break;
+        case RECORD_FRAME: decode(data, header.size, samples.frames); break;
+        default: break; // newer agent, skip what we don't know
+        }
+        offset += header.size;
+    }
+    mPending.erase(0, offset);
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../agent/AgentProtocol.h"
+#include "Socket.h"
+
+#include <string>
+#include <vector>
+
+// Records decoded from one read of the agent stream, in arrival order per type
+struct AgentSamples
+{
+    uint64_t start_ns = 0; // timestamp of the hello record, only set in the first batch
+    uint32_t cpu_count = 0;
+    std::vector<agent::CpuRecord> cpu;
+    std::vector<agent::AppCpuRecord> app_cpu;
+    std::vector<agent::MemoryRecord> memory;
+    std::vector<agent::ThermalRecord> thermal;
+    std::vector<agent::FrameRecord> frames;
+
+    bool empty() const
+    {
+        return start_ns == 0 && cpu.empty() && app_cpu.empty() && memory.empty() && thermal.empty() && frames.empty();
+    }
+};
+
+// Host side of perf-agent, connects to the port forwarded with `adb forward tcp:N tcp:N`
+struct AgentReceiver
+{
+    bool connect(int port, int timeoutMs = 2000);
+    bool isConnected() const { return mSocket.isOpen(); }
+    void close() { mSocket.close(); }
+
+    // Decodes every complete record available within timeoutMs.
+    // Returns false once the stream is closed or corrupt.
+    bool receive(AgentSamples& samples, int timeoutMs);
+
+private:
+    TcpSocket mSocket;
+    std::string mPending; // bytes of a partially received record
+};
@@ -0,0 +1,65 @@
+#include "Capture.h"
+
+using namespace std;
+
+CaptureWriter::~CaptureWriter()
+{
+    if (mFile) fclose(mFile);
+}
+
+bool CaptureWriter::open(const string& path)
+{
+    mFile = fopen(path.c_str(), "wb");
+    mPath = path;
+    mStartTime = chrono::steady_clock::now();
+    return mFile != nullptr;
+}
+
+void CaptureWriter::write(const string& kind, const string& key, const string& payload)
+{
+    lock_guard<mutex> lock(mMutex);
+    if (!mFile) return;
+
+    auto timeMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - mStartTime).count();
+    fprintf(mFile, "%s %llu %zu %zu\n", kind.c_str(), (unsigned long long)timeMs, key.size(), payload.size());
+    fwrite(key.data(), 1, key.size(), mFile);
+    fwrite(payload.data(), 1, payload.size(), mFile);
+    fputc('\n', mFile);
+}
+
+bool readCapture(const string& path, vector<CaptureRecord>& records)
+{
+    records.clear();
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+
+    bool ok = true;
+    char kind[32];
+    unsigned long long timeMs = 0;
+    size_t keyLen = 0, payloadLen = 0;
+    while (fscanf(fp, "%31s %llu %zu %zu", kind, &timeMs, &keyLen, &payloadLen) == 4)
+    {
+        if (fgetc(fp) != '\n')
+        {
+            ok = false;
+            break;
+        }
+
+        CaptureRecord record;
+        record.kind = kind;
+        record.timeMs = timeMs;
+        record.key.resize(keyLen);
+        record.payload.resize(payloadLen);
+        if ((keyLen > 0 && fread(&record.key[0], 1, keyLen, fp) != keyLen)
+            || (payloadLen > 0 && fread(&record.payload[0], 1, payloadLen, fp) != payloadLen)
+            || fgetc(fp) != '\n')
+        {
+            ok = false; // truncated, the app was closed while recording
+            break;
+        }
+        records.push_back(move(record));
+    }
+    fclose(fp);
+
+    return ok || !records.empty();
+}
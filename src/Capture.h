@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One command that went to the device and what came back.
+// kind is "info" (key = field, payload = value), "adb" (command -> output) or "sample" (sample script -> blob).
+struct CaptureRecord
+{
+    std::string kind;
+    uint64_t timeMs = 0; // since the capture started
+    std::string key;
+    std::string payload;
+};
+
+// Appends records to a capture file, every record is
+//
+// <kind> <timeMs> <key bytes> <payload bytes>\n<key><payload>\n
+//
+// so raw output of any size and content goes through unchanged.
+struct CaptureWriter
+{
+    ~CaptureWriter();
+
+    bool open(const std::string& path);
+    const std::string& getPath() const { return mPath; }
+
+    // thread safe, the UI thread writes adb records while the sampler writes samples
+    void write(const std::string& kind, const std::string& key, const std::string& payload);
+
+private:
+    FILE* mFile = nullptr;
+    std::string mPath;
+    std::mutex mMutex;
+    std::chrono::steady_clock::time_point mStartTime;
+};
+
+bool readCapture(const std::string& path, std::vector<CaptureRecord>& records);
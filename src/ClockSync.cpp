@@ -0,0 +1,134 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace
+{
+    const double kWindowMs = 5000;
+    const size_t kMaxEstimates = 12; // one minute of windows for the drift
+    // a window whose best bound is that much above the line had no fresh frames (app paused, loading)
+    const double kOutlierMs = 50;
+    // NTP gives up on clocks drifting more than 500 ppm, phones are well within that
+    const double kMaxDrift = 500e-6;
+    // shorter spans can't tell drift from the jitter of the bounds
+    const double kMinDriftSpanMs = 30000;
+    // windows in a row above the line, yet agreeing with each other, before the line moves to them
+    const size_t kReanchorWindows = 3;
+}
+
+void ClockSync::addObservation(double realtimeEnd, double newestFrame)
+{
+    if (mIdentity) return;
+
+    Estimate bound = { realtimeEnd, realtimeEnd - newestFrame };
+    if (!mWindowOpen)
+    {
+        mWindow = bound;
+        mWindowStart = realtimeEnd;
+        mWindowOpen = true;
+    }
+    else if (bound.offset < mWindow.offset)
+    {
+        mWindow = bound;
+    }
+
+    if (realtimeEnd - mWindowStart >= kWindowMs)
+    {
+        mWindowOpen = false;
+        if (!mEstimates.empty() && mWindow.offset < predict(mWindow.t) - kOutlierMs)
+        {
+            // the bounds are never below the true offset, so the realtime clock went back (NTP, the user)
+            mEstimates.clear();
+        }
+        if (mEstimates.empty() || mWindow.offset < predict(mWindow.t) + kOutlierMs)
+        {
+            mRejected.clear();
+            mEstimates.push_back(mWindow);
+            if (mEstimates.size() > kMaxEstimates)
+                mEstimates.erase(mEstimates.begin());
+        }
+        else
+        {
+            // a pause moves the bound up by a window each time, a clock stepping forward moves it once
+            if (!mRejected.empty() && fabs(mWindow.offset - mRejected.back().offset) > kOutlierMs)
+                mRejected.clear();
+            mRejected.push_back(mWindow);
+            if (mRejected.size() >= kReanchorWindows)
+            {
+                mEstimates = mRejected;
+                mRejected.clear();
+            }
+        }
+    }
+
+    fit();
+    mSynced = true;
+}
+
+void ClockSync::fit()
+{
+    if (mEstimates.empty())
+    {
+        mRef = mWindow;
+        mDrift = 0;
+        return;
+    }
+
+    // least squares line through the window estimates
+    double meanT = 0, meanOffset = 0;
+    for (const auto& e : mEstimates)
+    {
+        meanT += e.t;
+        meanOffset += e.offset;
+    }
+    meanT /= mEstimates.size();
+    meanOffset /= mEstimates.size();
+
+    double num = 0, den = 0;
+    for (const auto& e : mEstimates)
+    {
+        num += (e.t - meanT) * (e.offset - meanOffset);
+        den += (e.t - meanT) * (e.t - meanT);
+    }
+    double span = mEstimates.back().t - mEstimates.front().t;
+    mDrift = span >= kMinDriftSpanMs ? max(-kMaxDrift, min(num / den, kMaxDrift)) : 0;
+    mRef = { meanT, meanOffset };
+
+    // every observation is an upper bound of the true offset, never predict above the tightest recent one
+    if (mWindowOpen && mWindow.offset < predict(mWindow.t))
+        mRef = { mWindow.t, mWindow.offset };
+}
+
+void ClockSync::setIdentity()
+{
+    reset();
+    mIdentity = true;
+    mSynced = true;
+}
+
+void ClockSync::reset()
+{
+    mEstimates.clear();
+    mRejected.clear();
+    mWindow = {};
+    mWindowStart = 0;
+    mWindowOpen = false;
+    mRef = {};
+    mDrift = 0;
+    mSynced = false;
+    mIdentity = false;
+}
+
+double ClockSync::getOffset(double realtime) const
+{
+    if (!mSynced) return 0;
+    return predict(realtime);
+}
+
+double ClockSync::toMonotonic(double realtime) const
+{
+    return realtime - getOffset(realtime);
+}
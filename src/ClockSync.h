@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+// Maps the device CLOCK_REALTIME ($EPOCHREALTIME, what the shell can read) onto CLOCK_MONOTONIC,
+// the clock of SurfaceFlinger and gfxinfo frame timestamps. All times are in ms.
+//
+// The shell has no monotonic clock, but every frame window bounds the offset: the newest frame was
+// submitted before the read ended, so `realtime at the end of the read - newest frame` can only be
+// larger than the true offset. Like NTP keeps the sample with the shortest round trip, the tightest
+// bound of each window is the estimate, and a line through the estimates of recent windows gives the drift.
+struct ClockSync
+{
+    // realtimeEnd: $EPOCHREALTIME right after the frame window was read, newestFrame: last frame in that window
+    void addObservation(double realtimeEnd, double newestFrame);
+
+    // The samples are stamped with CLOCK_MONOTONIC already (perf-agent)
+    void setIdentity();
+
+    void reset();
+
+    bool isSynced() const { return mSynced; }
+    double toMonotonic(double realtime) const;
+
+    // realtime - monotonic at the given realtime
+    double getOffset(double realtime) const;
+    double getDriftPpm() const { return mDrift * 1e6; }
+
+private:
+    struct Estimate
+    {
+        double t = 0; // realtime of the observation
+        double offset = 0;
+    };
+    std::vector<Estimate> mEstimates; // tightest bound of each finished window
+    std::vector<Estimate> mRejected; // the windows in a row far above the line
+    Estimate mWindow; // tightest bound of the running window
+    double mWindowStart = 0;
+    bool mWindowOpen = false;
+
+    // offset(t) = mRef.offset + mDrift * (t - mRef.t)
+    Estimate mRef;
+    double mDrift = 0;
+    bool mSynced = false;
+    bool mIdentity = false;
+
+    double predict(double t) const { return mRef.offset + mDrift * (t - mRef.t); }
+    void fit();
+};
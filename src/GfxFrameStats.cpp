@@ -0,0 +1,131 @@
+#include "GfxFrameStats.h"
+#include "TextParse.h"
+
+#include <algorithm>
+
+using namespace std;
+
+const char* kGfxPhaseNames[GfxPhase_Count] = {
+    "delay", "input", "animation", "traversal", "sync", "issue_draw", "swap",
+};
+
+namespace
+{
+    const string_view kProfileData = "---PROFILEDATA---";
+    // newer Android versions print about 20 columns
+    const size_t kMaxFields = 32;
+
+    // Next line of text starting at pos without the line break, pos moves past it
+    bool nextLine(string_view text, size_t& pos, string_view& line)
+    {
+        if (pos >= text.size()) return false;
+        auto end = text.find('\n', pos);
+        if (end == string_view::npos) end = text.size();
+        line = text.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        pos = end + 1;
+        return true;
+    }
+
+    float phaseMs(uint64_t start, uint64_t end)
+    {
+        // a stamp the frame never reached is 0
+        if (start == 0 || end <= start) return 0;
+        return (end - start) * 1e-6f;
+    }
+}
+
+float GfxFramePhases::getUiThreadMs() const
+{
+    return ms[GfxPhase_Delay] + ms[GfxPhase_Input] + ms[GfxPhase_Animation] + ms[GfxPhase_Traversal];
+}
+
+float GfxFramePhases::getRenderThreadMs() const
+{
+    return ms[GfxPhase_Sync] + ms[GfxPhase_IssueDraw] + ms[GfxPhase_Swap];
+}
+
+void GfxFrameStatsParser::reset()
+{
+    mHeader.clear();
+    mMinFields = 0;
+    mLastCompleted = 0;
+}
+
+bool GfxFrameStatsParser::parseHeader(string_view header)
+{
+    if (header == mHeader && mMinFields > 0)
+        return true;
+
+    static const string_view kNames[Column_Count] = {
+        "Flags", "IntendedVsync", "HandleInputStart", "AnimationStart", "PerformTraversalsStart",
+        "SyncQueued", "IssueDrawCommandsStart", "SwapBuffers", "FrameCompleted",
+    };
+
+    string_view fields[kMaxFields];
+    size_t count = splitFields(header, ',', fields, kMaxFields);
+    mMinFields = 0;
+    for (int column = 0; column < Column_Count; column++)
+    {
+        auto it = find(fields, fields + count, kNames[column]);
+        if (it == fields + count)
+            return false; // not the framestats we know
+        mColumns[column] = it - fields;
+        mMinFields = max(mMinFields, size_t(mColumns[column] + 1));
+    }
+    mHeader = string(header);
+    return true;
+}
+
+bool GfxFrameStatsParser::parse(string_view dump, vector<uint64_t>& window, vector<pair<uint64_t, GfxFramePhases>>& newFrames)
+{
+    // the first window of the package, rows until the closing marker
+    auto start = dump.find(kProfileData);
+    if (start == string_view::npos)
+        return false;
+    size_t pos = start + kProfileData.size();
+    string_view line;
+    nextLine(dump, pos, line); // rest of the marker line
+    if (!nextLine(dump, pos, line) || !parseHeader(line))
+        return false;
+
+    uint64_t lastCompleted = mLastCompleted;
+    string_view fields[kMaxFields];
+    while (nextLine(dump, pos, line))
+    {
+        if (line.compare(0, kProfileData.size(), kProfileData) == 0)
+            break;
+        if (splitFields(line, ',', fields, kMaxFields) < mMinFields)
+            continue;
+
+        uint64_t flags = 0, completed = 0;
+        if (!parseNumber(fields[mColumns[Column_Flags]], flags) || flags != 0)
+            continue; // an outlier such as the first frame of a window, its stamps are not meaningful
+        if (!parseNumber(fields[mColumns[Column_FrameCompleted]], completed) || completed == 0)
+            continue;
+        window.push_back(completed / 1000000);
+
+        if (completed <= mLastCompleted)
+            continue; // broken down by an earlier dump
+
+        uint64_t stamps[Column_Count] = {};
+        for (int column = Column_IntendedVsync; column < Column_FrameCompleted; column++)
+            parseNumber(fields[mColumns[column]], stamps[column]);
+        stamps[Column_FrameCompleted] = completed;
+
+        GfxFramePhases phases;
+        phases.ms[GfxPhase_Delay] = phaseMs(stamps[Column_IntendedVsync], stamps[Column_HandleInputStart]);
+        phases.ms[GfxPhase_Input] = phaseMs(stamps[Column_HandleInputStart], stamps[Column_AnimationStart]);
+        phases.ms[GfxPhase_Animation] = phaseMs(stamps[Column_AnimationStart], stamps[Column_PerformTraversalsStart]);
+        phases.ms[GfxPhase_Traversal] = phaseMs(stamps[Column_PerformTraversalsStart], stamps[Column_SyncQueued]);
+        phases.ms[GfxPhase_Sync] = phaseMs(stamps[Column_SyncQueued], stamps[Column_IssueDrawCommandsStart]);
+        phases.ms[GfxPhase_IssueDraw] = phaseMs(stamps[Column_IssueDrawCommandsStart], stamps[Column_SwapBuffers]);
+        phases.ms[GfxPhase_Swap] = phaseMs(stamps[Column_SwapBuffers], stamps[Column_FrameCompleted]);
+        newFrames.push_back({ completed / 1000000, phases });
+        lastCompleted = max(lastCompleted, completed);
+    }
+    mLastCompleted = lastCompleted;
+
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Where the time of a frame went, from the timestamps of `dumpsys gfxinfo <package> framestats`.
+// Delay to Traversal run on the UI thread, Sync to Swap on the RenderThread.
+enum GfxPhase
+{
+    GfxPhase_Delay,     // IntendedVsync -> HandleInputStart, the UI thread was busy or the vsync came late
+    GfxPhase_Input,     // HandleInputStart -> AnimationStart
+    GfxPhase_Animation, // AnimationStart -> PerformTraversalsStart
+    GfxPhase_Traversal, // PerformTraversalsStart -> SyncQueued, measure, layout and recording the draw
+    GfxPhase_Sync,      // SyncQueued -> IssueDrawCommandsStart, waiting for the RenderThread and uploading bitmaps
+    GfxPhase_IssueDraw, // IssueDrawCommandsStart -> SwapBuffers
+    GfxPhase_Swap,      // SwapBuffers -> FrameCompleted
+    GfxPhase_Count,
+};
+
+extern const char* kGfxPhaseNames[GfxPhase_Count];
+
+struct GfxFramePhases
+{
+    float ms[GfxPhase_Count] = {};
+
+    float getUiThreadMs() const;
+    float getRenderThreadMs() const;
+    float getTotalMs() const { return getUiThreadMs() + getRenderThreadMs(); }
+};
+
+// Reads the framestats of one gfxinfo dump after the other. The columns are looked up in the
+// `Flags,IntendedVsync,...` header, so Android versions that add columns keep working, and only
+// rows completed after the previous dump are broken down into phases.
+struct GfxFrameStatsParser
+{
+    // window: FrameCompleted in ms of every valid row, which addFrameWindow() needs to see gaps
+    // newFrames: FrameCompleted in ms and phases of the rows not seen before
+    // Returns false if the dump has no framestats
+    bool parse(std::string_view dump, std::vector<uint64_t>& window, std::vector<std::pair<uint64_t, GfxFramePhases>>& newFrames);
+
+    void reset();
+
+private:
+    enum Column
+    {
+        Column_Flags,
+        Column_IntendedVsync,
+        Column_HandleInputStart,
+        Column_AnimationStart,
+        Column_PerformTraversalsStart,
+        Column_SyncQueued,
+        Column_IssueDrawCommandsStart,
+        Column_SwapBuffers,
+        Column_FrameCompleted,
+        Column_Count,
+    };
+
+    bool parseHeader(std::string_view header);
+
+    std::string mHeader; // the column map below was built from it
+    int mColumns[Column_Count] = {}; // field index of each column
+    size_t mMinFields = 0; // a row needs that many fields to have all columns
+    uint64_t mLastCompleted = 0; // ns, newest row broken down so far
+};
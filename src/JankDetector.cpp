@@ -0,0 +1,64 @@
+#include "JankDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+void JankStats::add(FrameClass frameClass, float frameTimeMs, int vsyncs)
+{
+    frames++;
+    totalMs += frameTimeMs;
+    if (vsyncs > 0)
+    {
+        missedVsyncs += vsyncs - 1;
+        pacing[(vsyncs < kPacingBins ? vsyncs : kPacingBins) - 1]++;
+    }
+    if (frameClass == Frame_Smooth)
+        return;
+    janks++;
+    jankMs += frameTimeMs;
+    if (frameClass == Frame_BigJank)
+        bigJanks++;
+}
+
+int JankStats::getPacedFrames() const
+{
+    int count = 0;
+    for (int bin : pacing)
+        count += bin;
+    return count;
+}
+
+FrameClass JankDetector::addFrame(float frameTimeMs)
+{
+    FrameClass frameClass = Frame_Smooth;
+    if (mHistoryCount == 3)
+    {
+        float average = (mHistory[0] + mHistory[1] + mHistory[2]) / 3;
+        if (frameTimeMs > average * 2)
+        {
+            if (frameTimeMs > bigJankMs) frameClass = Frame_BigJank;
+            else if (frameTimeMs > jankMs) frameClass = Frame_Jank;
+        }
+    }
+
+    mHistory[mNext] = frameTimeMs;
+    mNext = (mNext + 1) % 3;
+    mHistoryCount = min(mHistoryCount + 1, 3);
+    return frameClass;
+}
+
+int JankDetector::getVsyncs(float frameTimeMs) const
+{
+    if (refreshPeriodMs <= 0)
+        return 0;
+    // the frame times are whole ms, so round to the nearest period rather than ceil
+    return max(1, int(lround(frameTimeMs / refreshPeriodMs)));
+}
+
+void JankDetector::reset()
+{
+    mHistoryCount = 0;
+    mNext = 0;
+}
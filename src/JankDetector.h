@@ -0,0 +1,51 @@
+#pragma once
+
+// Jank as PerfDog counts it: a frame is a jank when it takes more than twice the average of the three
+// frames before it and longer than two frames of a 24 fps movie, a big jank when longer than three.
+// The first keeps a steady 30 fps game from counting, the second only flags what a viewer notices.
+
+enum FrameClass
+{
+    Frame_Smooth,
+    Frame_Jank,
+    Frame_BigJank,
+};
+
+struct JankStats
+{
+    // frames by present interval in refresh periods, 1, 2, 3 and 4 or more
+    static const int kPacingBins = 4;
+
+    int frames = 0;
+    int janks = 0; // big janks included
+    int bigJanks = 0;
+    int missedVsyncs = 0; // refresh periods a frame was late by, when the refresh period is known
+    double totalMs = 0;
+    double jankMs = 0;
+    int pacing[kPacingBins] = {};
+
+    // vsyncs from JankDetector::getVsyncs(), 0 if the refresh period is unknown
+    void add(FrameClass frameClass, float frameTimeMs, int vsyncs);
+    // share of the time spent in jank frames
+    float getStutter() const { return totalMs > 0 ? float(jankMs / totalMs) : 0; }
+    // frames that made it into pacing
+    int getPacedFrames() const;
+};
+
+// Classifies frame times as they arrive, O(1) per frame
+struct JankDetector
+{
+    float jankMs = 1000.0f / 24 * 2;
+    float bigJankMs = 1000.0f / 24 * 3;
+    float refreshPeriodMs = 0; // the active one, it changes with the refresh rate of the display, 0 if unknown
+
+    FrameClass addFrame(float frameTimeMs);
+    // refresh periods the frame was on screen for, at least 1, 0 if the refresh period is unknown
+    int getVsyncs(float frameTimeMs) const;
+    void reset();
+
+private:
+    float mHistory[3] = {};
+    int mHistoryCount = 0; // up to 3
+    int mNext = 0;
+};
@@ -1,27 +1,19 @@
 #include "LightSpeedApp.h"
+#include "AdbClient.h"
+#include "LogScanner.h"
 #include "MiniConfig.h"
 #include "Cinder/Timeline.h"
 #include "cinder/Json.h"
 #include "cinder/Utilities.h"
 
-// TODO: so ugly
 float global_min_t = 0;
 float global_max_t = 1;
-uint64_t firstFrameTimestamp = 0;
-uint64_t deltaTimestamp = 0;
-uint64_t firstCpuStatTimestamp = 0;
-int pid;
-vector<pair<uint64_t, CpuStat>> mCpuStats;
-vector<CpuConfig> mCpuConfigs;
 
-AppCpuStat::AppCpuStat(const string& line)
-{
-    auto tokens = split(line, ' ');
-    utime = fromString<long int>(tokens[14]);
-    stime = fromString<long int>(tokens[15]);
-    cutime = fromString<long int>(tokens[16]);
-    cstime = fromString<long int>(tokens[17]);
-}
+// the sampler blocks this long on a full mAdbResults before it drops a batch
+static const int kMaxProducerStallMs = 1000;
+
+// set on exit so that a hanging adb or tidevice can't keep us alive
+atomic<bool> gCancelCommands{ false };
 
 string getTimestampForFilename()
 {
@@ -37,22 +29,6 @@ string getTimestampForFilename()
 
 string perfettoCmdTemplate;
 
-float calcCpuUsage(const CpuStat& lhs, const CpuStat& rhs)
-{
-    auto totalTime = rhs.getAll() - lhs.getAll();
-    auto idleTime = rhs.getIdle() - lhs.getIdle();
-    auto usage = (totalTime - idleTime) * 100.0f / totalTime;
-    return usage;
-}
-
-float calcAppCpuUsage(const CpuStat& lhs, const CpuStat& rhs, const AppCpuStat& appLhs, const AppCpuStat& appRhs)
-{
-    auto totalTime = rhs.getAll() - lhs.getAll();
-    auto appActiveTime = appRhs.getActiveTime() - appLhs.getActiveTime();
-    auto usage = appActiveTime * mCpuConfigs.size() * 100.0f / totalTime;
-    return usage;
-}
-
 
 #include <windows.h>
 #include <Dbghelp.h>
@@ -142,102 +118,40 @@ int runCmd(const string& cmd, std::string& outOutput, bool waitForCompletion)
 {
     CI_LOG_W(cmd);
 
-    HANDLE g_hChildStd_OUT_Rd = NULL;
-    HANDLE g_hChildStd_OUT_Wr = NULL;
-    HANDLE g_hChildStd_ERR_Rd = NULL;
-    HANDLE g_hChildStd_ERR_Wr = NULL;
-
-    SECURITY_ATTRIBUTES sa;
-    // Set the bInheritHandle flag so pipe handles are inherited.
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-    if (!CreatePipe(&g_hChildStd_ERR_Rd, &g_hChildStd_ERR_Wr, &sa, 0)) { return 1; } // Create a pipe for the child process's STDERR.
-    if (!SetHandleInformation(g_hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0)) { return 1; } // Ensure the read handle to the pipe for STDERR is not inherited.
-    if (!CreatePipe(&g_hChildStd_OUT_Rd, &g_hChildStd_OUT_Wr, &sa, 0)) { return 1; } // Create a pipe for the child process's STDOUT.
-    if (!SetHandleInformation(g_hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0)) { return 1; } // Ensure the read handle to the pipe for STDOUT is not inherited
-
-    PROCESS_INFORMATION piProcInfo;
-    STARTUPINFOA siStartInfo;
-    bool bSuccess = FALSE;
-
-    // Set up members of the PROCESS_INFORMATION structure.
-    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-
-    // Set up members of the STARTUPINFO structure.
-    // This structure specifies the STDERR and STDOUT handles for redirection.
-    ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
-    siStartInfo.cb = sizeof(STARTUPINFOA);
-    siStartInfo.hStdError = g_hChildStd_ERR_Wr;
-    siStartInfo.hStdOutput = g_hChildStd_OUT_Wr;
-    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
-
-    // Create the child process.
-    bSuccess = CreateProcessA(
-        NULL,             // program name
-        (char*)cmd.c_str(),       // command line
-        NULL,             // process security attributes
-        NULL,             // primary thread security attributes
-        TRUE,             // handles are inherited
-        CREATE_NO_WINDOW, // creation flags (this is what hides the window)
-        NULL,             // use parent's environment
-        NULL,             // use parent's current directory
-        &siStartInfo,     // STARTUPINFO pointer
-        &piProcInfo       // receives PROCESS_INFORMATION
-    );
-
-    CloseHandle(g_hChildStd_ERR_Wr);
-    CloseHandle(g_hChildStd_OUT_Wr);
-
-    if (waitForCompletion)
-    {
-        // read output
-    #define BUFSIZE 4096
-        DWORD dwRead;
-        CHAR chBuf[BUFSIZE];
-        bool bSuccess2 = FALSE;
-        for (;;) { // read stdout
-            bSuccess2 = ReadFile(g_hChildStd_OUT_Rd, chBuf, BUFSIZE, &dwRead, NULL);
-            if (!bSuccess2 || dwRead == 0) break;
-            std::string s(chBuf, dwRead);
-            outOutput += s;
-        }
-        dwRead = 0;
-        for (;;) { // read stderr
-            bSuccess2 = ReadFile(g_hChildStd_ERR_Rd, chBuf, BUFSIZE, &dwRead, NULL);
-            if (!bSuccess2 || dwRead == 0) break;
-            std::string s(chBuf, dwRead);
-            outOutput += s;
-        }
-    }
-
-    CloseHandle(g_hChildStd_OUT_Rd);
-    CloseHandle(g_hChildStd_ERR_Rd);
+    if (!waitForCompletion)
+    {
+        // nobody reads the output, the thread only reaps the child
+        thread([cmd] { runProcess(cmd, -1, &gCancelCommands); }).detach();
+        return 0;
+    }
+
+    auto result = runProcess(cmd, -1, &gCancelCommands);
+    outOutput += result.output;
+    outOutput += result.errors;
 
     CI_LOG_W(outOutput);
 
-    // The remaining open handles are cleaned up when this process terminates.
-    // To avoid resource leaks in a larger application,
-    // close handles explicitly.
-    return 0;
+    return result.exitCode;
 }
 
 
-vector<string> PerfDoctorApp::executeIdb(string cmd, bool async, bool oneDeviceOnly)
+vector<string> DeviceSession::executeIdb(const string& cmd, bool async)
 {
-    char fullCmd[256];
-    if (oneDeviceOnly)
-        sprintf(fullCmd, "tidevice -u %s %s", mSerialNames[DEVICE_ID].c_str(), cmd.c_str());
-    else
-        sprintf(fullCmd, "tidevice %s", cmd.c_str());
+    string fullCmd = "tidevice";
+    if (!mSerial.empty())
+        fullCmd += " -u " + mSerial;
+    fullCmd += " " + cmd;
 
-#if 1
-    fp_idb = nullptr;
-    fp_idb = _popen(fullCmd, "r");  // Open the command for reading.
-    if (fp_idb == NULL) {
+    if (async)
+    {
+        // streaming commands such as `perf` keep running, their output is read from mIdbProcess
+        CI_LOG_W(fullCmd);
+        mIdbProcess = make_unique<Process>();
+        if (!mIdbProcess->start(fullCmd))
+            mIdbProcess.reset();
         return {};
     }
-#else
+
     string result;
     runCmd(fullCmd, result);
     if (result.empty()) return {};
@@ -245,21 +159,33 @@ vector<string> PerfDoctorApp::executeIdb(string cmd, bool async, bool oneDeviceO
     if (lines[lines.size() - 1].empty())
         lines.pop_back();
     return lines;
-#endif
+}
+
+vector<string> PerfDoctorApp::executeIdb(string cmd, bool async, bool oneDeviceOnly)
+{
+    auto session = getSession();
+    if (oneDeviceOnly && session)
+        return session->executeIdb(cmd, async);
+
+    string result;
+    runCmd("tidevice " + cmd, result);
+    if (result.empty()) return {};
+    auto lines = split(result, "\r\n");
+    if (lines[lines.size() - 1].empty())
+        lines.pop_back();
+    return lines;
 }
 
 void PerfDoctorApp::executeUnrealCmd(const string& cmd)
 {
-    char str[256];
-    sprintf(str, "shell am broadcast -a android.intent.action.RUN -e cmd '%s'", cmd.c_str());
-    executeAdb(str);
+    executeAdb("shell am broadcast -a android.intent.action.RUN -e cmd '" + cmd + "'");
     if (cmd.find("memreport") != string::npos)
         getMemReport();
     if (cmd.find("dumpticks") != string::npos)
         getDumpTicks();
 }
 
-vector<string> PerfDoctorApp::executeAdb(string cmd, bool oneDeviceOnly)
+const string& getAdbExe()
 {
     static bool init = true;
     static string adbExe = "adb";
@@ -271,27 +197,269 @@ vector<string> PerfDoctorApp::executeAdb(string cmd, bool oneDeviceOnly)
         if (result.find("adb") == string::npos)
             adbExe = (getAppPath() / "adb" / "adb.exe").string();
     }
-    char fullCmd[256];
-    if (oneDeviceOnly)
-        sprintf(fullCmd, "%s -s %s %s", adbExe.c_str(), mSerialNames[DEVICE_ID].c_str(), cmd.c_str());
+    return adbExe;
+}
+
+// Splits a command line with the rules of the C runtime, so the adb server sees the same arguments as adb.exe would
+static vector<string> splitCommandLine(const string& cmdLine)
+{
+    vector<string> args;
+    string arg;
+    bool inArg = false, inQuotes = false;
+    for (size_t i = 0; i < cmdLine.size(); i++)
+    {
+        char c = cmdLine[i];
+        if (c == '\\')
+        {
+            size_t count = 0;
+            while (i < cmdLine.size() && cmdLine[i] == '\\')
+            {
+                count++;
+                i++;
+            }
+            if (i < cmdLine.size() && cmdLine[i] == '"')
+            {
+                // 2n backslashes + quote -> n backslashes + toggle, 2n+1 -> n backslashes + literal quote
+                arg.append(count / 2, '\\');
+                if (count % 2 == 1)
+                    arg += '"';
+                else
+                    inQuotes = !inQuotes;
+            }
+            else
+            {
+                arg.append(count, '\\');
+                i--;
+            }
+            inArg = true;
+        }
+        else if (c == '"')
+        {
+            inQuotes = !inQuotes;
+            inArg = true;
+        }
+        else if ((c == ' ' || c == '\t') && !inQuotes)
+        {
+            if (inArg)
+                args.emplace_back(move(arg));
+            arg.clear();
+            inArg = false;
+        }
+        else
+        {
+            arg += c;
+            inArg = true;
+        }
+    }
+    if (inArg)
+        args.emplace_back(move(arg));
+    return args;
+}
+
+enum NativeAdbStatus
+{
+    NativeAdb_Done,
+    NativeAdb_Failed, // the server took the command, e.g. a hung device timed out, adb.exe would only wait again
+    NativeAdb_Unavailable, // not a command of the server or no server, adb.exe starts one
+};
+
+// shell, pull, push and forward go straight to the adb server
+static NativeAdbStatus executeAdbNative(const string& serial, const string& cmd, string& result)
+{
+    auto args = splitCommandLine(cmd);
+    string device = serial;
+    if (args.size() >= 2 && args[0] == "-s")
+    {
+        device = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    if (args.size() < 2)
+        return NativeAdb_Unavailable;
+
+    auto& client = getAdbClient();
+    const auto& verb = args[0];
+    bool done = false;
+    if (verb == "shell")
+    {
+        // adb joins the remaining arguments with spaces as well
+        string shellCmd = args[1];
+        for (size_t i = 2; i < args.size(); i++)
+            shellCmd += " " + args[i];
+        done = client.shell(device, shellCmd, result);
+    }
+    else if (verb == "pull" && args.size() <= 3)
+    {
+        auto localPath = args.size() == 3 ? args[2] : fs::path(args[1]).filename().string();
+        done = client.pull(device, args[1], localPath);
+    }
+    else if (verb == "push" && args.size() == 3)
+    {
+        done = client.push(device, args[1], args[2]);
+    }
+    else if (verb == "forward" && args.size() == 3)
+    {
+        done = client.forward(device, args[1], args[2]);
+    }
     else
-        sprintf(fullCmd, "%s %s", adbExe.c_str(), cmd.c_str());
+    {
+        return NativeAdb_Unavailable;
+    }
 
+    if (done)
+        return NativeAdb_Done;
+    if (!client.isServerRunning())
+        return NativeAdb_Unavailable;
+    CI_LOG_W("adb " << cmd << ": " << client.getLastError());
+    return NativeAdb_Failed;
+}
+
+string runAdbOutput(const string& serial, const string& cmd)
+{
     string result;
-    runCmd(fullCmd, result);
-    if (result.empty()) return {};
-    auto lines = split(result, "\r\n");
+    auto status = executeAdbNative(serial, cmd, result);
+    if (status == NativeAdb_Unavailable)
+    {
+        // also starts the adb server if it isn't running yet
+        string fullCmd = "\"" + getAdbExe() + "\"";
+        if (!serial.empty())
+            fullCmd += " -s " + serial;
+        fullCmd += " " + cmd;
+        result.clear();
+        runCmd(fullCmd, result);
+    }
+    return result;
+}
+
+vector<string> splitAdbOutput(const string& output)
+{
+    if (output.empty()) return {};
+    auto lines = split(output, "\r\n");
     if (lines[lines.size() - 1].empty())
         lines.pop_back();
     return lines;
 }
 
+vector<string> runAdb(const string& serial, const string& cmd)
+{
+    return splitAdbOutput(runAdbOutput(serial, cmd));
+}
+
+vector<string> PerfDoctorApp::executeAdb(string cmd, bool oneDeviceOnly)
+{
+    auto session = getSession();
+    return runAdb(oneDeviceOnly && session ? session->mSerial : "", cmd);
+}
+
+vector<string> DeviceSession::executeAdb(const string& cmd)
+{
+    string output;
+    if (mIsReplay)
+    {
+        auto it = mReplayResponses.find(cmd);
+        if (it == mReplayResponses.end())
+        {
+            CI_LOG_W("Not in the capture: " << cmd);
+            return {};
+        }
+        // answers come back in capture order, the last one answers any later call
+        output = it->second.front();
+        if (it->second.size() > 1)
+            it->second.pop_front();
+    }
+    else
+    {
+        // recorded as the device sent it, a replay splits it the same way
+        output = runAdbOutput(mSerial, cmd);
+        mAdbResponses[cmd] = output;
+        if (auto capture = atomic_load(&mCapture))
+            capture->write("adb", cmd, output);
+    }
+
+    return splitAdbOutput(output);
+}
+
+bool DeviceSession::startCapture()
+{
+    auto folder = getAppPath() / "captures";
+    fs::create_directories(folder);
+
+    auto name = mDeviceName + "-" + mPackageName + "-" + trim(getTimestampForFilename());
+    for (auto& c : name)
+    {
+        if (!isalnum(c) && c != '.' && c != '-') c = '_';
+    }
+
+    auto capture = make_shared<CaptureWriter>();
+    if (!capture->open((folder / (name + ".pdcap")).string()))
+    {
+        CI_LOG_E("Failed to create " << capture->getPath());
+        return false;
+    }
+    capture->write("info", "device", mDeviceName);
+    capture->write("info", "serial", mSerial);
+    capture->write("info", "package", mPackageName);
+    // the details were read before recording started, replay needs them too
+    for (const auto& kv : mAdbResponses)
+        capture->write("adb", kv.first, kv.second);
+
+    atomic_store(&mCapture, capture);
+    CI_LOG_I("Recording to " << capture->getPath());
+    return true;
+}
+
+bool DeviceSession::loadReplay(const vector<CaptureRecord>& records)
+{
+    mIsReplay = true;
+    for (const auto& record : records)
+    {
+        if (record.kind == "adb")
+            mReplayResponses[record.key].push_back(record.payload);
+        else if (record.kind == "sample")
+            mReplaySamples.push_back(record);
+    }
+    return !mReplaySamples.empty();
+}
+
+void DeviceSession::replaySample()
+{
+    if (mReplayPos >= mReplaySamples.size())
+    {
+        sleep(10);
+        return;
+    }
+
+    const auto& record = mReplaySamples[mReplayPos];
+    double now = getElapsedSeconds();
+    if (mReplayPos == 0)
+        mReplayStartTime = now;
+    if (REPLAY_SPEED > 0)
+    {
+        // REPLAY_SPEED 10 plays the capture ten times faster, 0 as fast as the UI drains it
+        double due = mReplayStartTime + (record.timeMs - mReplaySamples[0].timeMs) * 1e-3 / REPLAY_SPEED;
+        if (now < due)
+        {
+            sleep(min(10.0, (due - now) * 1e3));
+            return;
+        }
+    }
+
+    AdbResults results;
+    parseAdbResults(record.payload, results);
+    // a replay waits for the UI instead of dropping
+    while (mIsRunning && !mAdbResults.tryPush(results))
+        sleep(1);
+
+    mReplayPos++;
+    if (mReplayPos == mReplaySamples.size())
+        CI_LOG_I("Replayed " << mReplayPos << " samples of " << mSerial << " in " << getElapsedSeconds() - mReplayStartTime << " s");
+}
+
 
 bool PerfDoctorApp::refreshDeviceNames()
 {
     mSerialNames.clear();
     mDeviceNames.clear();
-    mTemparatureStatSlot = { "","", "" };
+    mIsIOSDevices.clear();
 
     char cmd[256];
 
@@ -396,10 +564,142 @@ bool PerfDoctorApp::refreshDeviceNames()
             DEVICE_ID = 0;
     }
 
+    // keep the sessions of devices still connected, they may be profiling
+    vector<unique_ptr<DeviceSession>> sessions;
+    for (int i = 0; i < mSerialNames.size(); i++)
+    {
+        unique_ptr<DeviceSession> session;
+        for (auto& existing : mSessions)
+        {
+            if (existing && existing->mSerial == mSerialNames[i])
+            {
+                session = move(existing);
+                break;
+            }
+        }
+        if (!session)
+            session = make_unique<DeviceSession>(mSerialNames[i], mDeviceNames[i], mIsIOSDevices[i], storage);
+        sessions.emplace_back(move(session));
+    }
+    // replays go after the devices, DEVICE_ID never picks them
+    for (auto& existing : mSessions)
+    {
+        if (existing && existing->mIsReplay)
+            sessions.emplace_back(move(existing));
+    }
+    mSessions = move(sessions);
+    mDeviceId = -1; // DEVICE_ID may point to another session now
+
+    return true;
+}
+
+void DeviceSession::benchmarkReplay(int rounds)
+{
+    if (mReplaySamples.empty()) return;
+
+    // same details as the replay, the replay itself keeps its series
+    DeviceSession scratch("benchmark", mDeviceName, false, storage);
+    scratch.mCpuConfigs = mCpuConfigs;
+    scratch.mTemparatureStatSlot = mTemparatureStatSlot;
+    scratch.mPackageName = mPackageName;
+    scratch.mSurfaceViewName = mSurfaceViewName;
+
+    double parseSeconds = 0, ingestSeconds = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        scratch.resetPerfData();
+        for (const auto& record : mReplaySamples)
+        {
+            double start = getElapsedSeconds();
+            AdbResults results;
+            parseAdbResults(record.payload, results);
+            double parsed = getElapsedSeconds();
+            if (results.success)
+                scratch.updateProfiler(results);
+            parseSeconds += parsed - start;
+            ingestSeconds += getElapsedSeconds() - parsed;
+        }
+    }
+
+    int count = rounds * mReplaySamples.size();
+    CI_LOG_I("Benchmark of " << mSerial << ": " << count << " samples, parse " << parseSeconds * 1e6 / count
+        << " us + ingest " << ingestSeconds * 1e6 / count << " us per sample");
+
+    // the sealed chunks of a soak test, measured on the series of the replay
+    SeriesCodecStats timeStats, valueStats;
+    mSeries.measureCodec(timeStats, valueStats);
+    auto values = timeStats.values + valueStats.values;
+    auto decodeSeconds = timeStats.decodeSeconds + valueStats.decodeSeconds;
+    CI_LOG_I("Series of " << mSerial << ": " << values << " values, timestamps " << timeStats.getRatio()
+        << "x, values " << valueStats.getRatio() << "x smaller, decode "
+        << (decodeSeconds > 0 ? values / decodeSeconds * 1e-6 : 0) << " M values/s");
+}
+
+bool PerfDoctorApp::openCapture(const fs::path& path)
+{
+    vector<CaptureRecord> records;
+    if (!readCapture(path.string(), records))
+    {
+        CI_LOG_E("Failed to read " << path);
+        return false;
+    }
+
+    string deviceName = path.filename().string();
+    string packageName;
+    for (const auto& record : records)
+    {
+        if (record.kind != "info") continue;
+        if (record.key == "device") deviceName = record.payload + " [replay]";
+        else if (record.key == "package") packageName = record.payload;
+    }
+
+    auto session = make_unique<DeviceSession>("replay:" + path.string(), deviceName, false, storage);
+    if (packageName.empty() || !session->loadReplay(records))
+    {
+        CI_LOG_E(path << " has no samples");
+        return false;
+    }
+    session->refreshDeviceDetails();
+    session->startProfiler(packageName);
+    mSessions.emplace_back(move(session));
     return true;
 }
 
-bool PerfDoctorApp::refreshDeviceDetails_ios()
+DeviceSession* PerfDoctorApp::getSession()
+{
+    if (DEVICE_ID < 0 || DEVICE_ID >= mSessions.size())
+        return nullptr;
+    return mSessions[DEVICE_ID].get();
+}
+
+void DeviceSession::updateCpuClusters()
+{
+    mCpuClusters.clear();
+    vector<const CpuConfig*> sorted;
+    for (const auto& config : mCpuConfigs)
+        sorted.push_back(&config);
+    stable_sort(sorted.begin(), sorted.end(), [](const CpuConfig* a, const CpuConfig* b) {
+        return a->cpuinfo_max_freq < b->cpuinfo_max_freq;
+    });
+
+    const CpuConfig* last = nullptr;
+    for (auto config : sorted)
+    {
+        if (!last || config->part != last->part || config->cpuinfo_max_freq != last->cpuinfo_max_freq)
+        {
+            char name[128];
+            if (config->cpuinfo_max_freq > 0)
+                sprintf(name, "%s %.2f GHz", config->part.empty() ? "cpu" : config->part.c_str(), config->cpuinfo_max_freq / 1e6);
+            else
+                sprintf(name, "%s", config->part.empty() ? "offline" : config->part.c_str());
+            mCpuClusters.push_back({ name });
+        }
+        mCpuClusters.back().cpus.push_back(config->id);
+        last = config;
+    }
+}
+
+bool DeviceSession::refreshDeviceDetails_ios()
 {
     storage.metric_storage["frame_time"].visible = false;
     storage.metric_storage["cpu_usage"].visible = false;
@@ -407,6 +707,9 @@ bool PerfDoctorApp::refreshDeviceDetails_ios()
     storage.metric_storage["memory_usage"].visible = false;
     storage.metric_storage["core_freq"].visible = false;
     storage.metric_storage["temperature"].visible = false;
+    storage.metric_storage["frame_phases"].visible = false;
+
+    mHasDetails = true;
 
     auto lines = executeIdb("-c applist");
     for (auto& line : lines)
@@ -451,17 +754,12 @@ bool PerfDoctorApp::refreshDeviceDetails_ios()
 
 bool PerfDoctorApp::refreshDeviceDetails()
 {
-    mAppNames.clear();
-    mIsProfiling = false;
-    mAppId = -1;
-
-    mCpuConfigs.clear();
-
-    if (DEVICE_ID == -1) return true;
+    auto session = getSession();
+    if (!session) return true;
 
     storage.metric_storage["fps"].visible = fps_visible;
 
-    if (mIsIOSDevices[DEVICE_ID]) return refreshDeviceDetails_ios();
+    if (mIsIOSDevices[DEVICE_ID]) return session->refreshDeviceDetails();
 
     storage.metric_storage["frame_time"].visible = frame_time_visible;
     storage.metric_storage["cpu_usage"].visible = cpu_usage_visible;
@@ -469,6 +767,7 @@ bool PerfDoctorApp::refreshDeviceDetails()
     storage.metric_storage["memory_usage"].visible = memory_usage_visible;
     storage.metric_storage["core_freq"].visible = core_freq_visible;
     storage.metric_storage["temperature"].visible = temperature_visible;
+    storage.metric_storage["frame_phases"].visible = frame_phases_visible;
 
     if (count(mSerialNames[DEVICE_ID].begin(), mSerialNames[DEVICE_ID].end(), '.') == 3)
     {
@@ -483,9 +782,28 @@ bool PerfDoctorApp::refreshDeviceDetails()
             sprintf(cmd, "connect %s", mSerialNames[DEVICE_ID].c_str());
             auto connectResults = executeAdb(cmd, false);
             mSerialNames[DEVICE_ID] += ":5555";
+            session->mSerial = mSerialNames[DEVICE_ID];
         }
     }
+
+    return session->refreshDeviceDetails();
+}
+
+bool DeviceSession::refreshDeviceDetails()
+{
+    stopProfiler();
+    mAppNames.clear();
+    mAppId = -1;
+
+    mCpuConfigs.clear();
+    mTemparatureStatSlot = { "","", "" };
+
+    if (mIsIOS) return refreshDeviceDetails_ios();
+
+    mHasDetails = true;
+
     auto lines = executeAdb("shell cat /proc/cpuinfo");
+    CpuConfig* cpu = nullptr;
     for (auto& line : lines)
     {
         auto tokens = split(line, "\t:");
@@ -495,12 +813,24 @@ bool PerfDoctorApp::refreshDeviceDetails()
         const auto& value = tokens[1];
         if (key == "processor")
         {
-            mCpuConfigs.push_back({});
-            mCpuConfigs.back().id = mCpuConfigs.size() - 1;
+            // offline cores are not listed, keep the configs indexed by cpu id
+            int id = mCpuConfigs.size();
+            parseNumber(trim(value), id);
+            if (id >= mCpuConfigs.size())
+            {
+                int count = mCpuConfigs.size();
+                mCpuConfigs.resize(id + 1);
+                for (int i = count; i <= id; i++)
+                    mCpuConfigs[i].id = i;
+            }
+            cpu = &mCpuConfigs[id];
         }
+        if (key == "Hardware") mDeviceStat.hardware = value;
+        if (!cpu) continue;
+
         if (key == "Features")
         {
-            mCpuConfigs.back().features = value;
+            cpu->features = value;
         }
         if (key == "CPU implementer")
         {
@@ -519,10 +849,10 @@ bool PerfDoctorApp::refreshDeviceDetails()
             case 'S': name = "samsung"; break;
             case 'V': name = "marvell"; break;
             }
-            mCpuConfigs.back().implementer = name;
+            cpu->implementer = name;
         }
-        if (key == "CPU architecture") mCpuConfigs.back().architecture = value;
-        if (key == "CPU variant") mCpuConfigs.back().variant = value;
+        if (key == "CPU architecture") cpu->architecture = value;
+        if (key == "CPU variant") cpu->variant = value;
         if (key == "CPU part")
         {
             auto src = stoi(value, 0, 16);
@@ -573,20 +903,27 @@ bool PerfDoctorApp::refreshDeviceDetails()
             case 0xC00: name = "Falkor"; break;
             case 0xC01: name = "Saphira"; break;
             }
-            mCpuConfigs.back().part = name;
+            cpu->part = name;
         }
-        if (key == "CPU revision") mCpuConfigs.back().revision = value;
-        if (key == "Hardware") mDeviceStat.hardware = value;
+        if (key == "CPU revision") cpu->revision = value;
     }
 
     {
-        auto lines = executeAdb("shell cat /sys/devices/system/cpu/cpu*/cpufreq/cpuinfo_min_freq");
-        for (int i = 0; i < lines.size(); i++)
-            mCpuConfigs[i].cpuinfo_min_freq = stoi(lines[i]);
+        int cpu_id = 0, freq = 0;
+        auto lines = executeAdb("shell grep -H . /sys/devices/system/cpu/cpu*/cpufreq/cpuinfo_min_freq");
+        for (const auto& line : lines)
+        {
+            if (parseCpuFileLine(line, cpu_id, freq) && cpu_id < mCpuConfigs.size())
+                mCpuConfigs[cpu_id].cpuinfo_min_freq = freq;
+        }
 
-        lines = executeAdb("shell cat /sys/devices/system/cpu/cpu*/cpufreq/cpuinfo_max_freq");
-        for (int i = 0; i < lines.size(); i++)
-            mCpuConfigs[i].cpuinfo_max_freq = stoi(lines[i]);
+        lines = executeAdb("shell grep -H . /sys/devices/system/cpu/cpu*/cpufreq/cpuinfo_max_freq");
+        for (const auto& line : lines)
+        {
+            if (parseCpuFileLine(line, cpu_id, freq) && cpu_id < mCpuConfigs.size())
+                mCpuConfigs[cpu_id].cpuinfo_max_freq = freq;
+        }
+        updateCpuClusters();
     }
 
     {
@@ -724,6 +1061,9 @@ bool PerfDoctorApp::refreshDeviceDetails()
         mDeviceStat.fps_min = fromString<int>(tokens[2]);
         mDeviceStat.fps_max = fromString<int>(tokens[4]);
         mDeviceStat.fps_now = fromString<int>(tokens[6]);
+        // until the frames tell the active one
+        if (mDeviceStat.fps_now > 0 && mJankDetector.refreshPeriodMs == 0)
+            mJankDetector.refreshPeriodMs = 1000.0f / mDeviceStat.fps_now;
     }
 
     lines = executeAdb("shell \"dumpsys SurfaceFlinger | grep WxH\"");
@@ -736,12 +1076,12 @@ bool PerfDoctorApp::refreshDeviceDetails()
     return true;
 }
 
-bool PerfDoctorApp::startProfiler_ios(const string& pacakgeName)
+bool DeviceSession::startProfiler_ios(const string& pacakgeName)
 {
     //-o=cpu,memory,fps
     char cmd[256];
     sprintf(cmd, "perf -B %s -o=fps", pacakgeName.c_str());
-    auto perfResults = executeIdb(cmd);
+    executeIdb(cmd, true);
 
     return true;
 }
@@ -783,16 +1123,16 @@ bool PerfDoctorApp::screenshot()
 void PerfDoctorApp::exportGpuTrace()
 {
     auto ts = getTimestampForFilename();
-    string name = mAppNames[mAppId] + ts + ".gpu.json";
+    string name = APP_NAME + ts + ".gpu.json";
     Json tree;
 
     writeJson(getAppPath() / name, tree);
 }
 
-bool PerfDoctorApp::exportCsv()
+bool DeviceSession::exportCsv()
 {
     auto ts = getTimestampForFilename();
-    string name = mAppNames[mAppId] + "-" + ts + ".csv";
+    string name = mPackageName + "-" + ts + ".csv";
     FILE* fp = fopen((getAppPath() / name).string().c_str(), "w");
     if (!fp) return false;
 
@@ -806,10 +1146,10 @@ bool PerfDoctorApp::exportCsv()
         fprintf(fp, "DeviceInfo\n");
         fprintf(fp, "Device Name,OS,OpenGL,SerialNum,CPU Info, GPU\n"
             "%s,%s,%s,%s,%s,%s\n",
-            mDeviceNames[DEVICE_ID].c_str(),
+            mDeviceName.c_str(),
             mDeviceStat.os_version.c_str(),
             mDeviceStat.gfx_api_version.c_str(),
-            mSerialNames[DEVICE_ID].c_str(),
+            mSerial.c_str(),
             mDeviceStat.hardware.c_str(),
             mDeviceStat.gpu_name.c_str()
         );
@@ -817,16 +1157,35 @@ bool PerfDoctorApp::exportCsv()
     }
 
     {
-        fprintf(fp, "Avg(FPS),Avg(Memory)[MB],Peak(Memory)[MB]\n"
-            "%.1f,%.0f,%.0f\n",
+        fprintf(fp, "Avg(FPS),1%%Low(FPS),P50(FrameTime)[ms],P90(FrameTime)[ms],P99(FrameTime)[ms],"
+            "Jank,BigJank,Stutter[%%],Avg(Memory)[MB],Peak(Memory)[MB]\n"
+            "%.1f,%.1f,%.1f,%.1f,%.1f,%d,%d,%.2f,%.0f,%.0f\n",
             mFpsSummary.Avg,
+            getOnePercentLowFps(mFrameTimeSummary),
+            mFrameTimeSummary.getQuantile(0.5),
+            mFrameTimeSummary.getQuantile(0.9),
+            mFrameTimeSummary.getQuantile(0.99),
+            mJankStats.janks,
+            mJankStats.bigJanks,
+            mJankStats.getStutter() * 100,
             mMemorySummary.Avg,
             mMemorySummary.Max);
         fprintf(fp, "\n");
     }
 
+    int pacedFrames = mJankStats.getPacedFrames();
+    if (pacedFrames > 0)
+    {
+        // share of the frames on screen for 1, 2, 3 and 4+ refresh periods, 1-2-1-2 pacing is half and half
+        fprintf(fp, "Avg(Refresh)[Hz],Avg(FPS/Refresh)[%%],Pacing1[%%],Pacing2[%%],Pacing3[%%],Pacing4+[%%]\n"
+            "%.1f,%.1f", mRefreshRateSummary.Avg, mFpsOfRefreshSummary.Avg);
+        for (int bin : mJankStats.pacing)
+            fprintf(fp, ",%.1f", bin * 100.0f / pacedFrames);
+        fprintf(fp, "\n\n");
+    }
+
     {
-        fprintf(fp, "Num,FPS,");
+        fprintf(fp, "Num,FPS,FPS/Refresh[%%],");
 
         if (storage.metric_storage["memory_usage"].visible)
         {
@@ -839,23 +1198,27 @@ bool PerfDoctorApp::exportCsv()
 
         if (storage.metric_storage["core_freq"].visible)
         {
-            for (int i = 0; i < mCpuConfigs.size(); i++)
+            for (int i = 0; i < mCoreFreq.size(); i++)
                 fprintf(fp, "CPUClock%d[MHz],", i);
         }
         if (storage.metric_storage["core_usage"].visible)
         {
-            for (int i = 0; i < mCpuConfigs.size(); i++)
+            for (int i = 0; i < mCoreUsage.size(); i++)
                 fprintf(fp, "CPUUsage%d[%%],", i);
         }
         fprintf(fp, "\n");
 
+        // a row per memory sample, the other series are matched by index
         int memory_count = min<int>(mFpsArray.size(), mMemoryStats.size());
         int fps_offset = mFpsArray.size() - memory_count;
+        auto valueAt = [](const Series& series, int i, int field) {
+            return i < series.size() ? max<float>(series.get(i, field), 0) : 0;
+        };
         for (int i = 0; i < memory_count - 1; i++)
         {
-            const auto& memStat = mMemoryStats[i].second;
-            fprintf(fp, "%d,%.1f,",
-                i, mFpsArray[fps_offset + i].second);
+            const auto memStat = getMemoryStat(i);
+            fprintf(fp, "%d,%.1f,%.1f,",
+                i, mFpsArray.get(fps_offset + i), mFpsArray.get(fps_offset + i, 1));
             if (storage.metric_storage["memory_usage"].visible)
             {
                 fprintf(fp, "%.0f,%.0f,"
@@ -868,38 +1231,21 @@ bool PerfDoctorApp::exportCsv()
 
             if (storage.metric_storage["temperature"].visible)
             {
-                if (!mTemperatureStats.empty())
-                {
-                    fprintf(fp, "%.1f,%.1f,%.1f,",
-                        max<float>(mTemperatureStats[i].second.cpu, 0),
-                        max<float>(mTemperatureStats[i].second.gpu, 0),
-                        max<float>(mTemperatureStats[i].second.battery, 0));
-                }
-                else
-                {
-                    fprintf(fp, "0,0,0,");
-                }
+                fprintf(fp, "%.1f,%.1f,%.1f,",
+                    valueAt(mTemperatureStats, i, 0),
+                    valueAt(mTemperatureStats, i, 1),
+                    valueAt(mTemperatureStats, i, 2));
             }
 
             if (storage.metric_storage["core_freq"].visible)
             {
-                for (int k = 0; k < mCpuConfigs.size(); k++)
-                {
-                    if (i < mChildCpuStats[k].size())
-                        fprintf(fp, "%.0f,", max<float>(mChildCpuStats[k][i].second.freq * 1e-3, 0));
-                    else
-                        fprintf(fp, "0,");
-                }
+                for (const auto* series : mCoreFreq)
+                    fprintf(fp, "%.0f,", valueAt(*series, i, 0));
             }
             if (storage.metric_storage["core_usage"].visible)
             {
-                for (int k = 0; k < mCpuConfigs.size(); k++)
-                {
-                    if (i < mChildCpuStats[k].size())
-                        fprintf(fp, "%.0f,", calcCpuUsage(mChildCpuStats[k][i].second, mChildCpuStats[k][i + 1].second));
-                    else
-                        fprintf(fp, "0,");
-                }
+                for (const auto* series : mCoreUsage)
+                    fprintf(fp, "%.0f,", valueAt(*series, i, 0));
             }
 
             fprintf(fp, "\n");
@@ -914,33 +1260,71 @@ bool PerfDoctorApp::exportCsv()
 
 void PerfDoctorApp::trimMemory(const char* level)
 {
+    auto session = getSession();
+    if (!session || session->mAppId == -1) return;
+
     char cmd[256];
-    sprintf(cmd, "shell am send-trim-memory %s %s", mAppNames[mAppId].c_str(), level);
+    sprintf(cmd, "shell am send-trim-memory %s %s", session->mAppNames[session->mAppId].c_str(), level);
     auto lines = executeAdb(cmd);
 }
 
 bool PerfDoctorApp::startProfiler(const string& pacakgeName)
 {
-    if (mIsIOSDevices[DEVICE_ID]) return startProfiler_ios(pacakgeName);
+    auto session = getSession();
+    if (!session) return false;
+
+    if (!session->mIsIOS)
+    {
+        string perfettoCmd = perfettoCmdTemplate;
+        perfettoCmd.replace(perfettoCmd.find("ATRACE_APP_NAME"), strlen("ATRACE_APP_NAME"), pacakgeName);
+        ofstream ofs(getAppPath() / "p.cfg");
+        if (ofs.is_open())
+            ofs << perfettoCmd;
+    }
+
+    return session->startProfiler(pacakgeName);
+}
+
+void PerfDoctorApp::startProfilerOnAllDevices()
+{
+    if (APP_NAME.empty()) return;
+
+    for (auto& session : mSessions)
+    {
+        if (session->mIsProfiling) continue;
+        if (!session->mHasDetails)
+            session->refreshDeviceDetails();
+        if (find(session->mAppNames.begin(), session->mAppNames.end(), APP_NAME) == session->mAppNames.end())
+        {
+            CI_LOG_W(APP_NAME << " is not installed on " << session->mDeviceName);
+            continue;
+        }
+        session->startProfiler(APP_NAME);
+    }
+}
+
+bool PerfDoctorApp::stopProfiler()
+{
+    auto session = getSession();
+    if (!session) return false;
 
-    string perfettoCmd = perfettoCmdTemplate;
-    perfettoCmd.replace(perfettoCmd.find("ATRACE_APP_NAME"), strlen("ATRACE_APP_NAME"), pacakgeName);
-    ofstream ofs(getAppPath() / "p.cfg");
-    if (ofs.is_open())
-        ofs << perfettoCmd;
+    return session->stopProfiler();
+}
+
+bool DeviceSession::startProfiler(const string& pacakgeName)
+{
+    if (mIsIOS) return startProfiler_ios(pacakgeName);
+
+    resetPerfData();
 
     char cmd[256];
     mSurfaceViewName = "";
     mSurfaceResolution = "";
     mPackageName = pacakgeName;
+    if (RECORD_CAPTURE && !mIsReplay)
+        startCapture();
     pid = getPid(pacakgeName);
 
-    mFpsSummary.Min = FLT_MAX;
-    mMemorySummary.Min = FLT_MAX;
-    mAppCpuSummary.Min = FLT_MAX;
-    mCpuTempSummary.Min = FLT_MAX;
-    mFrameTimeSummary.Min = FLT_MAX;
-
     auto lines = executeAdb("shell dumpsys SurfaceFlinger --list");
     for (auto& line : lines)
     {
@@ -972,59 +1356,455 @@ bool PerfDoctorApp::startProfiler(const string& pacakgeName)
         }
     }
 
+    {
+        lock_guard<mutex> lock(mSamplerTargetMutex);
+        mSamplerTarget = { mSerial, mPackageName, mSurfaceViewName, pid, mTemparatureStatSlot };
+    }
     mIsProfiling = true;
 
     return true;
 }
 
-void PerfDoctorApp::resetPerfData()
+void DeviceSession::resetPerfData()
 {
-    AdbResults results;
-    while (mAdbResults.tryPopBack(&results))
-    {
-    }
+    mAdbResults.clear();
 
     mLastSnapshotTs = 0;
     mLastSnapshotIdx = 0;
     firstCpuStatTimestamp = 0;
     firstFrameTimestamp = 0;
-    mMemoryStats.clear();
-    mTimestamps.clear();
-    mFrameTimes.clear();
-    mFpsArray.clear();
-    mCpuStats.clear();
-    mAppCpuStats.clear();
-    for (auto& item : mChildCpuStats)
-        item.clear();
+    mClockSync.reset();
+    mSeries.clear();
+    mLastMeminfoIdx = -1;
+    mLastCpuStat = {};
+    mLastCoreStats.clear();
+    mLastCoreStats.resize(mCpuConfigs.size());
+    mLastAppCpuStat = {};
+    mCpuStatAtLastApp = {};
+    mCoreUsage.clear();
+    mCoreFreq.clear();
+    for (int i = 0; i < mCpuConfigs.size(); i++)
+    {
+        mCoreUsage.push_back(&mSeries.add("core_usage." + to_string(i), { "%" }));
+        mCoreFreq.push_back(&mSeries.add("core_freq." + to_string(i), { "MHz", "%" }));
+    }
 
     mFpsSummary.reset();
     mMemorySummary.reset();
     mAppCpuSummary.reset();
     mCpuTempSummary.reset();
     mFrameTimeSummary.reset();
-
-    mTemperatureStats.clear();
+    mRefreshRateSummary.reset();
+    mFpsOfRefreshSummary.reset();
 
     mLabelPairs.clear();
+    mJankDetector.reset();
+    mJankDetector.jankMs = JANK_MS;
+    mJankDetector.bigJankMs = BIG_JANK_MS;
+    mJankStats = {};
+    mMissingSpans.clear();
+    mMissingFrames = 0;
+    mFramePollSeconds = 0;
+
+    mGfxParser.reset();
+    mFramePhaseSummary.reset();
+    mUiThreadSummary.reset();
+    mRenderThreadSummary.reset();
 }
 
-bool PerfDoctorApp::stopProfiler()
+bool DeviceSession::stopProfiler()
 {
     mIsProfiling = false;
+    atomic_store(&mCapture, shared_ptr<CaptureWriter>());
 
     resetPerfData();
 
     return true;
 }
 
-bool PerfDoctorApp::updateProfiler(const AdbResults& results)
+MemoryStat DeviceSession::getMemoryStat(size_t idx) const
 {
-    {
-        // frame time
-        uint64_t prevMaxTimestamp = 0;
-        if (!mTimestamps.empty())
-            prevMaxTimestamp = mTimestamps[mTimestamps.size() - 1];
+    const auto& series = mMemoryStats;
+    MemoryStat stat;
+    stat.pssTotal = series.get(idx, Memory_Total);
+    stat.pssNativeHeap = series.get(idx, Memory_NativeHeap);
+    stat.pssGL = series.get(idx, Memory_GL);
+    stat.pssEGL = series.get(idx, Memory_EGL);
+    stat.pssGfx = series.get(idx, Memory_Gfx);
+    stat.pssUnknown = series.get(idx, Memory_Unknown);
+    stat.privateClean = series.get(idx, Memory_PrivateClean);
+    stat.privateDirty = series.get(idx, Memory_PrivateDirty);
+    stat.pssFast = series.get(idx, Memory_Fast);
+    return stat;
+}
+
+namespace
+{
+    void toMemoryRow(const MemoryStat& stat, float* row)
+    {
+        row[Memory_Total] = stat.pssTotal;
+        row[Memory_NativeHeap] = stat.pssNativeHeap;
+        row[Memory_GL] = stat.pssGL;
+        row[Memory_EGL] = stat.pssEGL;
+        row[Memory_Gfx] = stat.pssGfx;
+        row[Memory_Unknown] = stat.pssUnknown;
+        row[Memory_PrivateClean] = stat.privateClean;
+        row[Memory_PrivateDirty] = stat.privateDirty;
+        row[Memory_Fast] = stat.pssFast;
+        row[Memory_Graphics] = stat.pssGL + stat.pssEGL + stat.pssGfx;
+    }
+}
+
+void DeviceSession::setMemoryStat(size_t idx, const MemoryStat& stat)
+{
+    float row[Memory_Count];
+    toMemoryRow(stat, row);
+    for (int field = 0; field < Memory_Count; field++)
+        mMemoryStats.set(idx, field, row[field]);
+}
+
+void DeviceSession::addMemoryStat(uint64_t ts, const MemoryStat* full, const MemoryStat* fast)
+{
+    // the fast value is Pss of smaps_rollup or Rss of statm, a full sample is anchored to it by the difference
+    auto offsetOf = [](const MemoryStat& stat) {
+        return stat.pssFast >= 0 ? stat.pssTotal - stat.pssFast : 0;
+    };
+
+    MemoryStat stat;
+    if (full)
+    {
+        stat = *full;
+        if (fast)
+            stat.pssFast = fast->pssFast;
+        else if (!mMemoryStats.empty())
+            stat.pssFast = mMemoryStats.get(mMemoryStats.size() - 1, Memory_Fast); // at most one fast period old
+
+        // interpolate the breakdown of the fast samples since the previous full one
+        if (mLastMeminfoIdx >= 0)
+        {
+            auto t0 = mMemoryStats.getTime(mLastMeminfoIdx);
+            const auto prev = getMemoryStat(mLastMeminfoIdx);
+            float prevOffset = offsetOf(prev), offset = offsetOf(stat);
+            for (int i = mLastMeminfoIdx + 1; i < mMemoryStats.size(); i++)
+            {
+                float w = float(mMemoryStats.getTime(i) - t0) / max<uint64_t>(ts - t0, 1);
+                auto lerp = [w](float a, float b) { return a + (b - a) * w; };
+                auto s = getMemoryStat(i);
+                s.pssGL = lerp(prev.pssGL, stat.pssGL);
+                s.pssEGL = lerp(prev.pssEGL, stat.pssEGL);
+                s.pssGfx = lerp(prev.pssGfx, stat.pssGfx);
+                s.pssUnknown = lerp(prev.pssUnknown, stat.pssUnknown);
+                s.pssNativeHeap = lerp(prev.pssNativeHeap, stat.pssNativeHeap);
+                s.pssTotal = s.pssFast + lerp(prevOffset, offset);
+                setMemoryStat(i, s);
+            }
+        }
+        mLastMeminfoIdx = mMemoryStats.size();
+    }
+    else
+    {
+        // carry the last breakdown forward until the next full sample interpolates it
+        if (mLastMeminfoIdx >= 0)
+        {
+            const auto anchor = getMemoryStat(mLastMeminfoIdx);
+            stat = anchor;
+            stat.pssTotal = fast->pssFast + offsetOf(anchor);
+        }
+        else
+        {
+            stat.pssTotal = fast->pssFast;
+        }
+        stat.pssFast = fast->pssFast;
+        if (fast->privateClean >= 0)
+        {
+            stat.privateClean = fast->privateClean;
+            stat.privateDirty = fast->privateDirty;
+        }
+    }
+
+    float row[Memory_Count];
+    toMemoryRow(stat, row);
+    mMemoryStats.append(ts, row);
+
+    // from the series, a full sample rewrites the totals of the fast ones before it
+    mMemorySummary = mMemoryStats.getSummary(mMemoryStats.getTime(0), mMemoryStats.getLastTime() + 1, Memory_Total);
+}
+
+namespace
+{
+    // both the SurfaceFlinger ring (128) and gfxinfo framestats (120) keep at least this many frames
+    const int kFrameWindowSize = 120;
+    // a window with fewer frames is not full, so it can't have dropped anything
+    const int kFullFrameWindow = 100;
+    const float kMinFramePollSeconds = 0.1f;
+}
+
+void DeviceSession::addFrameWindow(vector<uint64_t> frames)
+{
+    sort(frames.begin(), frames.end());
+    if (frames.size() < 2) return;
+
+    uint64_t oldest = frames[0];
+    uint64_t newest = frames[frames.size() - 1];
+    float interval = float(newest - oldest) / (frames.size() - 1);
+
+    // poll at half the time the window covers, so consecutive windows overlap
+    float pollSeconds = mFramePollSeconds > 0 ? mFramePollSeconds.load() : REFRESH_SECONDS;
+    float targetSeconds = max(kMinFramePollSeconds, min(interval * kFrameWindowSize * 0.5f * 1e-3f, REFRESH_SECONDS));
+
+    bool afterGap = false;
+    if (!mTimestamps.empty() && frames.size() >= kFullFrameWindow)
+    {
+        uint64_t lastTs = mTimestamps.getLastTime();
+        if (oldest > lastTs)
+        {
+            // the window no longer reaches the last frame we have, everything in between is gone
+            MissingSpan span;
+            span.start = lastTs;
+            span.end = oldest;
+            span.frames = max(1, int((oldest - lastTs) / max(interval, 1.0f) + 0.5f) - 1);
+            mMissingSpans.push_back(span);
+            mMissingFrames += span.frames;
+            afterGap = true;
+
+            pollSeconds = max(kMinFramePollSeconds, min(pollSeconds, targetSeconds) * 0.5f);
+            CI_LOG_W(mDeviceName << " lost ~" << span.frames << " frames, polling frames every " << pollSeconds << " s");
+        }
+    }
+    if (!afterGap)
+    {
+        // catch up with the frame rate at once, relax slowly
+        pollSeconds = min(targetSeconds, pollSeconds * 1.1f);
+    }
+    mFramePollSeconds = pollSeconds;
+
+    for (auto ts : frames)
+    {
+        if (addFrame(ts, afterGap))
+            afterGap = false;
+    }
+}
+
+bool DeviceSession::addFrame(uint64_t ts, bool afterGap)
+{
+    if (!mTimestamps.empty() && ts <= mTimestamps.getLastTime()) // duplicated timestamps
+        return false;
+
+    if (mLastSnapshotTs == 0 || afterGap)
+    {
+        // the fps of the window spanning a gap would count the missing frames as idle time
+        mLastSnapshotTs = ts;
+        mLastSnapshotIdx = mTimestamps.size();
+    }
+    if (ts - mLastSnapshotTs >= 1000)
+    {
+        // calculate fps
+        float frameCount = (mTimestamps.size() - mLastSnapshotIdx) * 1000.0f / (ts - mLastSnapshotTs);
+
+        mFpsSummary.update(frameCount);
+
+        // against the refresh rate, 60 fps is every vsync at 60 Hz but two thirds of them at 90 Hz
+        float refreshRate = mJankDetector.refreshPeriodMs > 0 ? 1000 / mJankDetector.refreshPeriodMs : 0;
+        float ofRefresh = refreshRate > 0 ? frameCount * 100 / refreshRate : 0;
+        if (refreshRate > 0)
+            mFpsOfRefreshSummary.update(ofRefresh);
+        float row[] = { frameCount, ofRefresh };
+        mFpsArray.append(ts, row);
+
+        mLastSnapshotTs = ts;
+        mLastSnapshotIdx = mTimestamps.size();
+    }
+
+    uint64_t prevTs = mTimestamps.empty() ? 0 : mTimestamps.getLastTime();
+    mTimestamps.append(ts, nullptr);
+
+    if (afterGap)
+    {
+        // the frames before the gap are no history for the ones after it
+        mJankDetector.reset();
+    }
+
+    if (mJankDetector.refreshPeriodMs > 0)
+    {
+        // the display switches between 60, 90, 120 Hz as it likes, a sample per change keeps the steps in place
+        float refreshRate = 1000 / mJankDetector.refreshPeriodMs;
+        if (mRefreshRate.empty() || mRefreshRate.get(mRefreshRate.size() - 1) != refreshRate || ts - mRefreshRate.getLastTime() >= 1000)
+        {
+            mRefreshRateSummary.update(refreshRate);
+            mRefreshRate.append(ts, refreshRate);
+        }
+    }
+
+    if (prevTs != 0 && !afterGap)
+    {
+        auto frametime = ts - prevTs;
+        mFrameTimeSummary.update(frametime);
+        mFrameTimes.append(ts, (float)frametime);
+
+        auto frameClass = mJankDetector.addFrame(frametime);
+        int vsyncs = mJankDetector.getVsyncs(frametime);
+        mJankStats.add(frameClass, frametime, vsyncs);
+        if (frameClass != Frame_Smooth)
+            mJanks.append(ts, (float)frametime);
+        if (frameClass == Frame_BigJank)
+            mBigJanks.append(ts, (float)frametime);
+
+        if (!mLabelPairs.empty() && ts >= mLabelPairs.back().start)
+        {
+            mLabelPairs.back().frameTimes.update(frametime);
+            mLabelPairs.back().jank.add(frameClass, frametime, vsyncs);
+        }
+    }
+
+    return true;
+}
+
+void DeviceSession::addCpuStat(uint64_t ts, const CpuStat& stat)
+{
+    // the series keep the usage since the previous sample, the first one only starts the counting
+    if (stat.cpu_id == -1)
+    {
+        if (mLastCpuStat.getAll() != 0 && stat.getAll() > mLastCpuStat.getAll())
+            mCpuUsage.append(ts, calcCpuUsage(mLastCpuStat, stat));
+        mLastCpuStat = stat;
+        return;
+    }
+
+    int cpu_id = stat.cpu_id;
+    if (cpu_id < 0 || cpu_id >= mLastCoreStats.size())
+        return; // cpu configs may lag behind a hotplugged core
+    auto& last = mLastCoreStats[cpu_id];
+    if (last.getAll() != 0 && stat.getAll() > last.getAll())
+        mCoreUsage[cpu_id]->append(ts, calcCpuUsage(last, stat));
+    last = stat;
+    if (stat.freq >= 0)
+        addCoreFreq(ts, cpu_id, stat.freq);
+}
+
+void DeviceSession::addCoreFreq(uint64_t ts, int cpu_id, int freqKHz)
+{
+    if (cpu_id < 0 || cpu_id >= mCoreFreq.size() || freqKHz < 0)
+        return; // cpu configs may lag behind a hotplugged core
+    int maxFreq = mCpuConfigs[cpu_id].cpuinfo_max_freq;
+    float row[] = { freqKHz * 1e-3f, maxFreq > 0 ? freqKHz * 100.0f / maxFreq : 0 };
+    mCoreFreq[cpu_id]->append(ts, row);
+}
+
+void DeviceSession::addFramePhases(uint64_t ts, const GfxFramePhases& phases)
+{
+    mFramePhaseSummary.update(phases.getTotalMs());
+    mUiThreadSummary.update(phases.getUiThreadMs());
+    mRenderThreadSummary.update(phases.getRenderThreadMs());
+    mFramePhases.append(ts, phases.ms);
+
+    // the chart stacks the phases, its levels of detail need the tops
+    float tops[GfxPhase_Count];
+    float top = 0;
+    for (int phase = 0; phase < GfxPhase_Count; phase++)
+        tops[phase] = top += phases.ms[phase];
+    mFramePhaseStack.append(ts, tops);
+}
+
+void DeviceSession::addAppCpuStat(uint64_t ts, const AppCpuStat& stat)
+{
+    // over the total cpu time since the previous app sample, so call it after addCpuStat() of the same sample
+    if (mCpuStatAtLastApp.getAll() != 0 && mLastCpuStat.getAll() > mCpuStatAtLastApp.getAll())
+    {
+        float usage = calcAppCpuUsage(mCpuStatAtLastApp, mLastCpuStat, mLastAppCpuStat, stat, mCpuConfigs.size());
+        mAppCpuSummary.update(usage);
+        mAppCpuUsage.append(ts, usage);
+    }
+    mLastAppCpuStat = stat;
+    mCpuStatAtLastApp = mLastCpuStat;
+}
+
+bool DeviceSession::updateProfiler_agent(const AgentSamples& samples)
+{
+    if (samples.start_ns != 0 && firstFrameTimestamp == 0)
+    {
+        // frames and counters share CLOCK_MONOTONIC, so both series start at the launch of the agent
+        firstFrameTimestamp = samples.start_ns / 1000000;
+        firstCpuStatTimestamp = firstFrameTimestamp;
+        mClockSync.setIdentity();
+
+        // init first label
+        if (mLabelPairs.empty())
+        {
+            // starts with the agent, before any frame
+            mLabelPairs.push_back({ "default", firstFrameTimestamp, 0 });
+        }
+    }
+    if (firstFrameTimestamp == 0)
+        return false; // hello record not received yet
+
+    for (const auto& frame : samples.frames)
+    {
+        // the header of the window the frame was read with
+        if (frame.refresh_period_ns > 0)
+            mJankDetector.refreshPeriodMs = frame.refresh_period_ns * 1e-6f;
+        addFrame(frame.frame_ready_ns / 1000000);
+    }
 
+    for (const auto& record : samples.cpu)
+    {
+        CpuStat new_stat;
+        new_stat.cpu_id = record.cpu_id;
+        new_stat.user = record.user;
+        new_stat.nice = record.nice;
+        new_stat.sys = record.sys;
+        new_stat.idle = record.idle;
+        new_stat.iowait = record.iowait;
+        new_stat.irq = record.irq;
+        new_stat.softirq = record.softirq;
+        new_stat.freq = record.freq_khz;
+
+        addCpuStat(record.header.timestamp_ns / 1000000, new_stat);
+    }
+
+    for (const auto& record : samples.app_cpu)
+    {
+        AppCpuStat new_stat;
+        new_stat.utime = record.utime;
+        new_stat.stime = record.stime;
+        new_stat.cutime = record.cutime;
+        new_stat.cstime = record.cstime;
+        addAppCpuStat(record.header.timestamp_ns / 1000000, new_stat);
+    }
+
+    for (const auto& record : samples.memory)
+    {
+        // smaps_rollup has no per category breakdown
+        MemoryStat stat;
+        stat.pssFast = record.pss_kb / 1024.0f; // KB -> MB
+        stat.privateClean = record.private_clean_kb / 1024.0f;
+        stat.privateDirty = record.private_dirty_kb / 1024.0f;
+        addMemoryStat(record.header.timestamp_ns / 1000000, nullptr, &stat);
+    }
+
+    for (const auto& record : samples.thermal)
+    {
+        TemperatureStat stat;
+        if (record.cpu != INT32_MIN) stat.cpu = record.cpu * 1e-3;
+        if (record.gpu != INT32_MIN) stat.gpu = record.gpu * 1e-3;
+        if (record.battery != INT32_MIN) stat.battery = record.battery * 1e-3;
+        if (stat.cpu > 0 || stat.gpu > 0)
+        {
+            if (!mTemparatureStatSlot.cpu.empty())
+                mCpuTempSummary.update(stat.cpu);
+            float row[] = { stat.cpu, stat.gpu, stat.battery };
+            mTemperatureStats.append(record.header.timestamp_ns / 1000000, row);
+        }
+    }
+
+    return true;
+}
+
+bool DeviceSession::updateProfiler(const AdbResults& results)
+{
+    if (results.agent_mode) return updateProfiler_agent(results.agent);
+
+    {
+        // frame time
         // adb shell dumpsys SurfaceFlinger --latency <window name>
         // prints some information about the last 128 frames displayed in
         // that window.
@@ -1055,206 +1835,83 @@ bool PerfDoctorApp::updateProfiler(const AdbResults& results)
         // the activity's main window are not updated when the main web content is
         // composited into a SurfaceView.
 
-        vector<TripleTimestamp> timestamps;
+        vector<uint64_t> frames;
+        const auto& lines = results.SurfaceFlinger_latency;
+        auto refreshPeriod = parseLatency(lines, frames); // ns
+        if (refreshPeriod > 0)
+            mJankDetector.refreshPeriodMs = refreshPeriod * 1e-6f;
 
-        auto lines = results.SurfaceFlinger_latency;
-        for (int i = 1; i < lines.size(); i++)
+        if (lines.empty() && results.display_fps > 0)
+            mJankDetector.refreshPeriodMs = 1000 / results.display_fps; // gfxinfo has no refresh period
+        if (lines.empty() && !results.dumpsys_gfxinfo.empty())
         {
-            auto& tokens = split(lines[i], '\t');
-            if (tokens.size() < 3) continue; // it happens sometimes
-            if (tokens[0][0] == '0') continue;
-            timestamps.push_back({ tokens[0], tokens[1], tokens[2] });
-        }
-
-        if (lines.empty())
-        {
-            // https://developer.android.com/training/testing/performance
-            lines = results.dumpsys_gfxinfo;
-            bool find_app = false;
-            bool find_timestamps = false;
-            for (int i = 0; i < lines.size(); i++)
-            {
-                auto& line = lines[i];
-                if (find_timestamps)
-                {
-                    if (line.find("---PROFILEDATA---") != string::npos)
-                        // reach end of timestamp section
-                        break;
-
-                    auto& tokens = split(line, ',');
-                    if (fromString<uint64_t>(tokens[0]) != 0)
-                        // this frame is an outlier, skip it
-                        continue;
-
-                    // ��ȡINTENDED_VSYNC VSYNC FRAME_COMPLETEDʱ�� ����VSYNC����fps jank
-                    timestamps.push_back({ tokens[1], tokens[2], tokens[13] });
-                }
-                if (line.find(mPackageName) != string::npos)
-                    find_app = true;
-                if (find_app && line.find("Flags,IntendedVsync") != string::npos)
-                    find_timestamps = true;
-            }
-        }
-
-        for (const auto& triple : timestamps)
-        {
-            auto ts = fromString<uint64_t>(triple.frame_submitted);
-            if (ts == INT64_MAX)
-            {
-                // If a fence associated with a frame is still pending when we query the
-                // latency data, SurfaceFlinger gives the frame a timestamp of INT64_MAX.
-                // Since we only care about completed frames, we will ignore any timestamps
-                // with this value.
-                continue;
-            }
-            ts /= 1e6; // ns -> ms
-            if (ts <= prevMaxTimestamp) // duplicated timestamps
-                continue;
-            if (mLastSnapshotTs == 0)
-            {
-                mLastSnapshotTs = ts;
-                mLastSnapshotIdx = 0;
-            }
-            if (ts - mLastSnapshotTs >= 1000)
-            {
-                // calculate fps
-                float frameCount = (mTimestamps.size() - mLastSnapshotIdx) * 1000.0f / (ts - mLastSnapshotTs);
-
-                mFpsSummary.update(frameCount, mFpsArray.size());
-
-                mFpsArray.push_back({ ts, frameCount });
-
-                mLastSnapshotTs = ts;
-                mLastSnapshotIdx = mTimestamps.size();
-            }
-
-            mTimestamps.push_back(ts);
-
-            prevMaxTimestamp = mTimestamps[mTimestamps.size() - 1];
-            if (mTimestamps.size() > 1)
-            {
-                auto frametime = ts - mTimestamps[mTimestamps.size() - 2];
-                mFrameTimeSummary.update(frametime, mFrameTimes.size());
-                mFrameTimes.push_back({ ts, frametime }); // -2 is prev item
-            }
+            // https://developer.android.com/topic/performance/rendering/inspect-gpu-rendering
+            // the window of the last 120 frames for the gaps, the phases only of the new ones
+            vector<pair<uint64_t, GfxFramePhases>> newFrames;
+            mGfxParser.parse(results.dumpsys_gfxinfo, frames, newFrames);
+            for (const auto& frame : newFrames)
+                addFramePhases(frame.first, frame.second);
         }
+        addFrameWindow(frames);
+        if (!frames.empty() && results.frames_realtime > 0)
+            mClockSync.addObservation(results.frames_realtime * 1e3, *max_element(frames.begin(), frames.end()));
 
         if (firstFrameTimestamp == 0 && !mTimestamps.empty())
         {
-            // TODO: a potential bug
-            firstFrameTimestamp = mTimestamps[0];
-            deltaTimestamp = mTimestamps[mTimestamps.size() - 1] - firstFrameTimestamp;
+            firstFrameTimestamp = mTimestamps.getTime(0);
 
             // init first label
             if (mLabelPairs.empty())
             {
-                mLabelPairs.push_back({ "default", firstFrameTimestamp, 0 });
+                // it starts with the first frame, so it has seen every frame time so far
+                mLabelPairs.push_back({ "default", firstFrameTimestamp, 0, mFrameTimeSummary, mJankStats });
             }
         }
     }
-    auto lines = results.EPOCHREALTIME;
-    uint64_t millisec_since_epoch = fromString<double>(lines[0]) * 1e3;
-
-    //auto millisec_since_epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-    if (mCpuStats.empty())
-        firstCpuStatTimestamp = millisec_since_epoch - deltaTimestamp - 1e3; // TODO: magic 
+    // stored in CLOCK_REALTIME, getSampleSeconds() maps them with the latest clock estimate
+    uint64_t millisec_since_epoch = results.realtime * 1e3;
+    if (firstCpuStatTimestamp == 0)
+        firstCpuStatTimestamp = millisec_since_epoch;
 
     {
         // CPU Usage
-        auto lines = results.proc_stat;
-        for (auto& line : lines)
+        for (const auto& line : results.proc_stat)
         {
-            if (line.find("cpu") == string::npos)
+            if (line.compare(0, 3, "cpu") != 0)
                 continue;
 
-            CpuStat new_stat(line);
-
-            if (line[3] == ' ')
-            {
-                // total CPU
-                mCpuStats.push_back({ millisec_since_epoch, new_stat });
-            }
-            else
-            {
-                // child CPU
-                int cpu_id = line[3] - '0';
-                if (cpu_id >= 0 && cpu_id < mCpuConfigs.size())
-                {
-                    mChildCpuStats[cpu_id].push_back({ millisec_since_epoch, new_stat });
-                }
-            }
+            // the total comes first, the app usage below needs it
+            addCpuStat(millisec_since_epoch, CpuStat(line));
         }
 
         {
             // App CPU Usage
-            lines = results.proc_pid_stat;
-            if (!lines.empty() && lines[0].find("No such") == string::npos)
+            const auto& lines = results.proc_pid_stat;
+            if (!lines.empty() && lines[0].find(')') != string::npos) // not "No such file"
             {
-                AppCpuStat new_stat(lines[0]);
-                mAppCpuStats.push_back({ millisec_since_epoch, new_stat });
+                addAppCpuStat(millisec_since_epoch, AppCpuStat(lines[0]));
             }
         }
 
         {
             // Memory Usage
             // https://perfetto.dev/docs/case-studies/memory
-            lines = results.dumpsys_meminfo;
-            if (lines.size() > 1)
-            {
-                MemoryStat stat;
-                for (auto& line : lines)
-                {
-                    if (line.find("Native Heap") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssNativeHeap = fromString<float>(tokens[2]) / 1024; // KB -> MB
-                    }
-                    else if (line.find("EGL mtrack") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssEGL = fromString<float>(tokens[2]) / 1024;
-                    }
-                    else if (line.find("Gfx dev") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssGfx = fromString<float>(tokens[2]) / 1024;
-                    }
-                    else if (line.find("GL mtrack") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssGL = fromString<float>(tokens[2]) / 1024;
-                    }
-                    else if (line.find("Unknown") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssUnknown = fromString<float>(tokens[1]) / 1024;
-                    }
-                    else if (line.find("TOTAL") != string::npos)
-                    {
-                        auto& tokens = split(line, ' ');
-                        stat.pssTotal = fromString<float>(tokens[1]) / 1024;
-                        stat.privateDirty = fromString<float>(tokens[2]) / 1024;
-                        stat.privateClean = fromString<float>(tokens[3]) / 1024;
-
-                        mMemorySummary.update(stat.pssTotal, mMemoryStats.size());
-
-                        break;
-                    }
-                }
-
-                mMemoryStats.push_back({ millisec_since_epoch, stat });
-            }
+            MemoryStat full, fast;
+            bool hasFull = parseMeminfo(results.dumpsys_meminfo, full);
+            bool hasFast = parseFastMemory(results.proc_pid_smaps_rollup, fast);
+            if (hasFull || hasFast)
+                addMemoryStat(millisec_since_epoch, hasFull ? &full : nullptr, hasFast ? &fast : nullptr);
         }
 
         {
             // scaling_cur_freq
-            lines = results.scaling_cur_freq;
             int idx = 0;
-            for (auto& line : lines)
+            for (const auto& line : results.scaling_cur_freq)
             {
-                auto freq = stoi(line);
-                mChildCpuStats[idx].back().second.freq = freq;
-                idx++;
+                int cpu_id = idx++, freq = -1;
+                if (!parseCpuFileLine(line, cpu_id, freq))
+                    parseNumber(line, freq); // captures from before grep -H, one line per core in order
+                addCoreFreq(millisec_since_epoch, cpu_id, freq);
             }
         }
 
@@ -1262,15 +1919,188 @@ bool PerfDoctorApp::updateProfiler(const AdbResults& results)
             if (results.temperature.cpu > 0 || results.temperature.gpu > 0)
             {
                 if (!mTemparatureStatSlot.cpu.empty())
-                    mCpuTempSummary.update(results.temperature.cpu, mTemperatureStats.size());
-                mTemperatureStats.push_back({ millisec_since_epoch, results.temperature });
+                    mCpuTempSummary.update(results.temperature.cpu);
+                const auto& stat = results.temperature;
+                float row[] = { stat.cpu, stat.gpu, stat.battery };
+                mTemperatureStats.append(millisec_since_epoch, row);
             }
         }
     }
     return true;
 }
 
-int PerfDoctorApp::getPid(const string& pacakgeName)
+DeviceSession::SamplerTarget DeviceSession::getSamplerTarget() const
+{
+    lock_guard<mutex> lock(mSamplerTargetMutex);
+    return mSamplerTarget;
+}
+
+bool DeviceSession::isChartVisible(const string& name) const
+{
+    auto it = storage.metric_storage.find(name);
+    return it != storage.metric_storage.end() && it->second.visible;
+}
+
+bool DeviceSession::startAgent(const SamplerTarget& target)
+{
+    auto agentPath = getAppPath() / "adb" / "perf-agent";
+    if (!fs::exists(agentPath))
+    {
+        CI_LOG_E("Missing " << agentPath << ", build it with agent/build.bat");
+        return false;
+    }
+
+    const auto& serial = mAdbShell->getSerial();
+    auto& client = getAdbClient();
+    if (!client.push(serial, agentPath.string(), "/data/local/tmp/perf-agent", 0755)
+        || !client.forward(serial, "tcp:" + toString(mAgentLocalPort), "tcp:" + toString(AGENT_PORT)))
+    {
+        CI_LOG_E("Failed to install perf-agent: " << client.getLastError());
+        return false;
+    }
+
+    // launched from the persistent shell so there is no extra adb process, it exits once we disconnect
+    string cmd = "chmod 755 /data/local/tmp/perf-agent; killall perf-agent 2>/dev/null; ";
+    cmd += "/data/local/tmp/perf-agent --port " + toString(AGENT_PORT);
+    cmd += " --pid " + toString(target.pid);
+    cmd += " --cpu-hz " + toString(AGENT_CPU_HZ);
+    cmd += " --frame-hz " + toString(AGENT_FRAME_HZ);
+    if (!target.surfaceViewName.empty())
+        cmd += " --surface " + shellQuote(target.surfaceViewName);
+    if (!target.thermal.cpu.empty())
+        cmd += " --thermal-cpu " + target.thermal.cpu;
+    if (!target.thermal.gpu.empty())
+        cmd += " --thermal-gpu " + target.thermal.gpu;
+    if (!target.thermal.battery.empty())
+        cmd += " --thermal-battery " + target.thermal.battery;
+    cmd += " >/dev/null 2>&1 &";
+    mAdbShell->execute(cmd);
+
+    mAgentReceiver = make_unique<AgentReceiver>();
+    for (int i = 0; i < 10; i++)
+    {
+        // adb forward accepts the connection before the agent listens, wait for the hello record
+        AgentSamples samples;
+        if (mAgentReceiver->connect(mAgentLocalPort) && mAgentReceiver->receive(samples, 500) && !samples.empty())
+        {
+            AdbResults results;
+            results.agent_mode = true;
+            results.agent = move(samples);
+            mAdbResults.push(move(results), kMaxProducerStallMs);
+            return true;
+        }
+        sleep(200);
+    }
+
+    CI_LOG_E("Failed to connect to perf-agent on " << target.serial);
+    mAgentReceiver.reset();
+    return false;
+}
+
+vector<SampleProbe> DeviceSession::getSampleProbes(const SamplerTarget& target)
+{
+    // same visibility rules as the charts, a hidden chart costs nothing on the device
+    // frame data has to be read before the ring of 128 frames wraps, addFrameWindow() picks the period and it never backs off
+    float framePoll = mFramePollSeconds > 0 ? mFramePollSeconds.load() : REFRESH_SECONDS;
+    vector<SampleProbe> probes;
+    if (!target.surfaceViewName.empty())
+    {
+        probes.push_back({ "SurfaceFlinger_latency", "dumpsys SurfaceFlinger --latency " + shellQuote(target.surfaceViewName), framePoll, 50, framePoll });
+    }
+    else if (SUPPORT_NON_GAME && (isChartVisible("fps") || isChartVisible("frame_phases")))
+    {
+        probes.push_back({ "dumpsys_gfxinfo", "dumpsys gfxinfo " + target.packageName + " framestats", framePoll, 100, framePoll });
+        // the header of SurfaceFlinger --latency follows the refresh rate, without it the display dump has to
+        probes.push_back({ "display_refresh", "dumpsys SurfaceFlinger | grep -m 1 cur:", DISPLAY_SECONDS, 50, 10 });
+    }
+    if (isChartVisible("cpu_usage") || isChartVisible("core_usage"))
+    {
+        probes.push_back({ "proc_stat", "cat /proc/stat", REFRESH_SECONDS, 20, 2 });
+    }
+    if (isChartVisible("memory_usage"))
+    {
+        // cheap totals at the frame rate of the charts, the slow breakdown every MEMINFO_SECONDS
+        auto proc = "/proc/" + toString(target.pid);
+        probes.push_back({ "proc_pid_smaps_rollup", "cat " + proc + "/smaps_rollup 2>/dev/null || cat " + proc + "/statm", REFRESH_SECONDS, 20, 2 });
+        probes.push_back({ "dumpsys_meminfo", "dumpsys meminfo " + target.packageName, MEMINFO_SECONDS, 300, 30 });
+    }
+    if (isChartVisible("core_freq"))
+    {
+        probes.push_back({ "scaling_cur_freq", "grep -H . /sys/devices/system/cpu/cpu*/cpufreq/scaling_cur_freq", REFRESH_SECONDS, 20, 2 });
+    }
+    if (isChartVisible("cpu_usage"))
+    {
+        probes.push_back({ "proc_pid_stat", "cat /proc/" + toString(target.pid) + "/stat", REFRESH_SECONDS, 20, 2 });
+    }
+    if (!target.thermal.cpu.empty())
+        probes.push_back({ "temperature_cpu", "cat " + target.thermal.cpu, THERMAL_SECONDS, 20, 10 });
+    if (!target.thermal.gpu.empty())
+        probes.push_back({ "temperature_gpu", "cat " + target.thermal.gpu, THERMAL_SECONDS, 20, 10 });
+    if (!target.thermal.battery.empty())
+        probes.push_back({ "temperature_battery", "cat " + target.thermal.battery, THERMAL_SECONDS, 20, 10 });
+
+    return probes;
+}
+
+bool parseAdbResults(const string& blob, AdbResults& results, SampleScheduler* scheduler)
+{
+    vector<SampleSection> sections;
+    if (!parseSampleOutput(blob, sections))
+    {
+        results.success = false;
+        return false;
+    }
+
+    for (const auto& section : sections)
+    {
+        const auto& name = section.name;
+        vector<string> lines;
+        if (name == "dumpsys_gfxinfo")
+            results.dumpsys_gfxinfo = section.payload; // GfxFrameStatsParser reads it in place
+        else if (!section.payload.empty())
+            lines = split(section.payload, "\r\n");
+        if (!lines.empty() && lines[lines.size() - 1].empty())
+            lines.pop_back();
+
+        if (scheduler && section.elapsedMs >= 0)
+            scheduler->reportLatency(name, section.elapsedMs);
+        if (results.realtime == 0)
+            results.realtime = section.start;
+        if (name == "SurfaceFlinger_latency" || name == "dumpsys_gfxinfo")
+            results.frames_realtime = section.end;
+
+        if (name == "SurfaceFlinger_latency") results.SurfaceFlinger_latency = move(lines);
+        else if (name == "dumpsys_gfxinfo") continue;
+        else if (name == "proc_stat") results.proc_stat = move(lines);
+        else if (name == "proc_pid_stat") results.proc_pid_stat = move(lines);
+        else if (name == "dumpsys_meminfo") results.dumpsys_meminfo = move(lines);
+        else if (name == "proc_pid_smaps_rollup") results.proc_pid_smaps_rollup = move(lines);
+        else if (name == "scaling_cur_freq") results.scaling_cur_freq = move(lines);
+        else if (name == "display_refresh")
+        {
+            if (!lines.empty())
+                parseDisplayFps(lines[0], results.display_fps);
+        }
+        else if (!lines.empty())
+        {
+            // thermal zones report millidegree
+            int milli = 0;
+            parseNumber(lines[0], milli);
+            if (name == "temperature_cpu") results.temperature.cpu = milli * 1e-3;
+            else if (name == "temperature_gpu") results.temperature.gpu = milli * 1e-3;
+            else if (name == "temperature_battery") results.temperature.battery = milli * 1e-3;
+        }
+    }
+
+    if (!results.proc_pid_stat.empty() && results.proc_pid_stat[0].find("error") != string::npos)
+        results.success = false;
+    if (results.realtime == 0) // every sample is stamped by the shell
+        results.success = false;
+
+    return results.success;
+}
+
+int DeviceSession::getPid(const string& pacakgeName)
 {
     char cmd[256];
     sprintf(cmd, "shell pidof %s", pacakgeName.c_str());
@@ -1347,35 +2177,260 @@ bool PerfDoctorApp::stopApp(const string& pacakgeName)
     return true;
 }
 
-void PerfDoctorApp::updateMetricsData()
+DeviceSession::DeviceSession(const string& serial, const string& deviceName, bool isIOS, DataStorage& storage)
+    : mSerial(serial), mDeviceName(deviceName), mIsIOS(isIOS), storage(storage),
+    mTimestamps(mSeries.add("frames", {}, true)),
+    mFrameTimes(mSeries.add("frame_time", { "ms" }, true)),
+    mFpsArray(mSeries.add("fps", { "fps", "% refresh" }, true)),
+    mRefreshRate(mSeries.add("refresh_rate", { "Hz" }, true)),
+    mCpuUsage(mSeries.add("cpu_usage.sys", { "%" })),
+    mAppCpuUsage(mSeries.add("cpu_usage.app", { "%" })),
+    mMemoryStats(mSeries.add("memory_usage", { "Total", "NativeHeap", "GL", "EGL", "Gfx", "Unknown", "PrivateClean", "PrivateDirty", "Fast", "Graphics" })),
+    mTemperatureStats(mSeries.add("temperature", { "cpu", "gpu", "battery" })),
+    mFramePhases(mSeries.add("frame_phases", vector<string>(kGfxPhaseNames, kGfxPhaseNames + GfxPhase_Count), true)),
+    mFramePhaseStack(mSeries.add("frame_phases.stack", vector<string>(kGfxPhaseNames, kGfxPhaseNames + GfxPhase_Count), true)),
+    mJanks(mSeries.add("jank", { "ms" }, true)),
+    mBigJanks(mSeries.add("big_jank", { "ms" }, true))
 {
-    global_min_t = RANGE_START;
-    if (!mTimestamps.empty())
+    // adb forward needs a distinct host port per device
+    static int sessionCount = 0;
+    mAgentLocalPort = AGENT_PORT + 1 + sessionCount++;
+
+    mSamplerThread = make_unique<thread>([this] {
+        while (mIsRunning)
+        {
+            sample();
+        }
+        mAgentReceiver.reset();
+        mAdbShell.reset();
+    });
+}
+
+DeviceSession::~DeviceSession()
+{
+    mIsRunning = false;
+    mSamplerThread->join();
+}
+
+void DeviceSession::sample()
+{
+    if (!mIsProfiling)
+    {
+        // disconnecting stops the agent
+        mAgentReceiver.reset();
+    }
+
+    auto target = getSamplerTarget();
+    if (target.packageName.empty() || !mIsProfiling)
     {
-        auto finalTimestamp = mTimestamps[mTimestamps.size() - 1];
-        global_max_t = max<float>((finalTimestamp - mTimestamps[0]) * 1e-3, (RANGE_START + RANGE_DURATION));
-        if (!mLabelPairs.empty())
+        sleep(10);
+        return;
+    }
+
+    if (mIsReplay)
+    {
+        replaySample();
+        return;
+    }
+
+    // the agent streams at its own rate, the probes follow mScheduler
+    vector<SampleProbe> probes;
+    double now = getElapsedSeconds();
+    if (USE_NATIVE_AGENT)
+    {
+        if (now - mLastSampleTime < REFRESH_SECONDS)
         {
-            mLabelPairs[mLabelPairs.size() - 1].end = finalTimestamp;
+            sleep(10);
+            return;
         }
+        mLastSampleTime = now;
     }
     else
     {
-        // TODO: a bug here?
-        global_max_t = max<float>((mCpuStats[mCpuStats.size() - 1].first - firstCpuStatTimestamp) * 1e-3, (RANGE_START + RANGE_DURATION));
+        mScheduler.setProbes(getSampleProbes(target));
+        probes = mScheduler.takeDue(now);
+        if (probes.empty())
+        {
+            sleep(min(10.0, mScheduler.getWaitTime(now) * 1e3));
+            return;
+        }
+    }
+
+    if (!mAdbShell || !mAdbShell->isAlive() || mAdbShell->getSerial() != target.serial)
+    {
+        mAdbShell = make_unique<AdbShell>(getAdbExe(), target.serial);
+        mInstalledProbes.clear();
+        if (!mAdbShell->start())
+        {
+            CI_LOG_E("Failed to start adb shell for " << target.serial);
+            return;
+        }
+    }
+
+    if (USE_NATIVE_AGENT)
+    {
+        if (!mAgentReceiver && !startAgent(target))
+            return;
+
+        // the agent streams at its own rate, each tick hands over everything received since the last one
+        AdbResults results;
+        results.agent_mode = true;
+        if (!mAgentReceiver->receive(results.agent, 0))
+        {
+            CI_LOG_E("perf-agent disconnected on " << target.serial);
+            mAgentReceiver.reset();
+            return;
+        }
+        if (!results.agent.empty())
+            mAdbResults.push(move(results), kMaxProducerStallMs);
+        return;
+    }
+
+    // the probe functions are installed once and re-sent only when a probe changes
+    vector<SampleProbe> missingProbes;
+    for (const auto& probe : probes)
+    {
+        if (find(mInstalledProbes.begin(), mInstalledProbes.end(), probe) == mInstalledProbes.end())
+            missingProbes.push_back(probe);
+    }
+    string sampleCmd = buildSampleCall(probes, "perf_doctor");
+    if (!missingProbes.empty())
+    {
+        sampleCmd = buildSampleScript(missingProbes, "perf_doctor") + sampleCmd;
+        for (const auto& probe : missingProbes)
+        {
+            // a changed command replaces the function of the same name
+            mInstalledProbes.erase(remove_if(mInstalledProbes.begin(), mInstalledProbes.end(),
+                [&](const SampleProbe& p) { return p.name == probe.name; }), mInstalledProbes.end());
+            mInstalledProbes.push_back(probe);
+        }
+    }
+
+    string blob;
+    if (!mAdbShell->executeRaw(sampleCmd, blob))
+    {
+        CI_LOG_E("adb shell sample failed, restarting the session");
+        return;
+    }
+
+    if (auto capture = atomic_load(&mCapture))
+        capture->write("sample", sampleCmd, blob);
+
+    double parseStart = getElapsedSeconds();
+    AdbResults results;
+    parseAdbResults(blob, results, &mScheduler);
+    mParseUs += (getElapsedSeconds() - parseStart) * 1e6;
+    mParseCount++;
+
+    mAdbResults.push(move(results), kMaxProducerStallMs);
+}
+
+bool DeviceSession::update()
+{
+    if (!mIsProfiling) return false;
+
+    // drain everything, a stalled UI catches up in one frame instead of falling further behind
+    bool updated = false;
+    AdbResults results;
+    while (mAdbResults.tryPop(results))
+    {
+        if (!results.success) continue;
+        double ingestStart = getElapsedSeconds();
+        updateProfiler(results);
+        mIngestUs += (getElapsedSeconds() - ingestStart) * 1e6;
+        mIngestCount++;
+        updated = true;
+    }
+    if (!updated)
+        return false;
+
+    if (!mTimestamps.empty() && !mLabelPairs.empty())
+    {
+        mLabelPairs[mLabelPairs.size() - 1].end = mTimestamps.getLastTime();
+    }
+    return true;
+}
+
+float DeviceSession::getDuration() const
+{
+    if (!mTimestamps.empty())
+        return (mTimestamps.getLastTime() - mTimestamps.getTime(0)) * 1e-3;
+    float duration = 0;
+    for (const auto& kv : mSeries.getSeries())
+    {
+        const auto& series = *kv.second;
+        if (!series.empty())
+            duration = max(duration, getSeriesSeconds(series, series.getLastTime()));
+    }
+    return duration;
+}
+
+float DeviceSession::getSeriesSeconds(const Series& series, uint64_t ts) const
+{
+    if (series.frameClock)
+        return (double(ts) - firstFrameTimestamp) * 1e-3;
+    return getSampleSeconds(ts);
+}
+
+uint64_t DeviceSession::getSeriesTime(const Series& series, float seconds) const
+{
+    double ms = seconds * 1e3;
+    double ts = 0;
+    if (series.frameClock)
+    {
+        ts = firstFrameTimestamp + ms;
+    }
+    else if (mClockSync.isSynced() && firstFrameTimestamp != 0)
+    {
+        // the inverse of toMonotonic(), the offset barely moves between the two clocks
+        double monotonic = firstFrameTimestamp + ms;
+        ts = monotonic + mClockSync.getOffset(monotonic);
+        ts = monotonic + mClockSync.getOffset(ts);
+    }
+    else
+    {
+        ts = firstCpuStatTimestamp + ms;
+    }
+    return ts > 0 ? uint64_t(ts) : 0;
+}
+
+float DeviceSession::getSampleSeconds(uint64_t ts) const
+{
+    if (mClockSync.isSynced() && firstFrameTimestamp != 0)
+        return (mClockSync.toMonotonic(ts) - firstFrameTimestamp) * 1e-3;
+    // nothing to sync with, the samples have a time axis of their own
+    return (double(ts) - firstCpuStatTimestamp) * 1e-3;
+}
+
+void PerfDoctorApp::updateMetricsData()
+{
+    // every session starts at 0, so the longest one sets the range
+    global_min_t = RANGE_START;
+    global_max_t = RANGE_START + RANGE_DURATION;
+    MetricSummary fpsSummary = {}, memorySummary = {}, frameTimeSummary = {}, framePhaseSummary = {};
+    for (auto& session : mSessions)
+    {
+        if (!session->mVisible || !session->hasData()) continue;
+
+        global_max_t = max<float>(global_max_t, session->getDuration());
+        fpsSummary.Max = max(fpsSummary.Max, session->mFpsSummary.Max);
+        fpsSummary.Max = max(fpsSummary.Max, session->mRefreshRateSummary.Max); // the refresh rate is drawn with it
+        memorySummary.Max = max(memorySummary.Max, session->mMemorySummary.Max);
+        frameTimeSummary.Max = max(frameTimeSummary.Max, session->mFrameTimeSummary.Max);
+        framePhaseSummary.Max = max(framePhaseSummary.Max, session->mFramePhaseSummary.Max);
     }
 
     {
         auto& metrics = storage.metric_storage["frame_time"];
         metrics.name = "frame_time";
         metrics.min_x = -1;
-        metrics.max_x = mFrameTimeSummary.Max + 10;
+        metrics.max_x = frameTimeSummary.Max + 10;
     }
     {
         auto& metrics = storage.metric_storage["fps"];
         metrics.name = "fps";
         metrics.min_x = -1;
-        metrics.max_x = mFpsSummary.Max + 10;
+        metrics.max_x = fpsSummary.Max + 10;
     }
     {
         auto& metrics = storage.metric_storage["cpu_usage"];
@@ -1393,7 +2448,7 @@ void PerfDoctorApp::updateMetricsData()
         auto& metrics = storage.metric_storage["memory_usage"];
         metrics.name = "memory_usage";
         metrics.min_x = 0;
-        metrics.max_x = mMemorySummary.Max + 200;
+        metrics.max_x = memorySummary.Max + 200;
     }
     {
         auto& metrics = storage.metric_storage["core_freq"];
@@ -1407,13 +2462,27 @@ void PerfDoctorApp::updateMetricsData()
         metrics.min_x = -1;
         metrics.max_x = 101;
     }
+    {
+        auto& metrics = storage.metric_storage["frame_phases"];
+        metrics.name = "frame_phases";
+        metrics.min_x = -1;
+        metrics.max_x = framePhaseSummary.Max + 10;
+    }
+}
+
+static string getUnrealFolder()
+{
+    return "/sdcard/UE4Game/" + APP_FOLDER + "/" + APP_FOLDER;
+}
+
+static string getUnrealLogPath()
+{
+    return getUnrealFolder() + "/Saved/Logs/" + APP_FOLDER + ".log";
 }
 
 void PerfDoctorApp::getUnrealLog(bool openLogFile)
 {
-    char str[256];
-    sprintf(str, "pull /sdcard/UE4Game/%s/%s/Saved/Logs/%s.log", APP_FOLDER.c_str(), APP_FOLDER.c_str(), APP_FOLDER.c_str());
-    executeAdb(str);
+    executeAdb("pull " + getUnrealLogPath());
 
     if (openLogFile)
     {
@@ -1421,114 +2490,145 @@ void PerfDoctorApp::getUnrealLog(bool openLogFile)
     }
 }
 
+bool PerfDoctorApp::openMemReport(const string& path)
+{
+    MemReport report;
+    if (!loadMemReport(path, report))
+    {
+        CI_LOG_E("No memreport tables in " << path);
+        return false;
+    }
+    mMemReports.push_back(move(report));
+
+    // the usual question is what grew since the last one, e.g. across a level transition
+    auto& view = mMemReportView;
+    view.report = mMemReports.size() - 1;
+    view.baseline = view.report - 1;
+    view.visible = true;
+    view.dirty = true;
+    return true;
+}
+
 void PerfDoctorApp::getMemReport()
 {
     auto fn = [&]() {
-        char str[256];
-        sprintf(str, "shell ls -l /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports", APP_FOLDER.c_str(), APP_FOLDER.c_str());
-        auto lines = executeAdb(str);
+        auto reportFolder = getUnrealFolder() + "/Saved/Profiling/MemReports";
+        auto lines = executeAdb("shell ls -l " + reportFolder);
         if (lines.size() > 1)
         {
             auto folder = lines[lines.size() - 1];;
             auto tokens = split(folder, ' ');
             folder = tokens[tokens.size() - 1];
 
-            sprintf(str, "shell ls -l /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports/%s", APP_FOLDER.c_str(), APP_FOLDER.c_str(), folder.c_str());
-            lines = executeAdb(str);
+            lines = executeAdb("shell ls -l " + reportFolder + "/" + folder);
             if (lines.size() > 1)
             {
                 auto lastLine = lines[lines.size() - 1];
                 tokens = split(lastLine, ' ');
                 auto lastFile = tokens[tokens.size() - 1];
-                sprintf(str, "pull /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports/%s/%s", APP_FOLDER.c_str(), APP_FOLDER.c_str(), folder.c_str(), lastFile.c_str());
-                executeAdb(str);
-                launchWebBrowser(Url(lastFile, true));
+                executeAdb("pull " + reportFolder + "/" + folder + "/" + lastFile);
+                openMemReport(lastFile);
             }
         }
     };
     timeline().add(fn, timeline().getCurrentTime() + 1);
 }
 
-void PerfDoctorApp::getDumpTicks()
+// One row of dumpticks after the 30 characters of "[2021.05.06-08.12.34:567][123]":
+// "BP_Foo_C /Game/Maps/Map.Map:PersistentLevel.BP_Foo_C_1.Movement[TickComponent], Enabled, ActualStartTickGroup: TG_PrePhysics, Prerequesities: 0"
+static bool parseTickFunction(string_view line, TickFunction& tick)
 {
-    auto fn = [&]() {
-        mTickFunctions.clear();
-
-        getUnrealLog();
-
-        int line_startDumpTicks = 0; // track the latest one
-        int line_endDumpTicks = 0; // track the latest one
-        std::ifstream ifs(APP_FOLDER + ".log");
-        if (ifs.is_open())
+    const size_t kLogPrefix = 30;
+    const size_t kTickGroupPrefix = sizeof(" ActualStartTickGroup: ") - 1;
+    if (line.size() <= kLogPrefix) return false;
+
+    string_view tokens[5];
+    if (splitTokens(line.substr(kLogPrefix), ",", tokens, 5) != 4) return false;
+    if (tokens[2].size() < kTickGroupPrefix) return false;
+    string_view actor = tokens[0];
+    tick.status = string(tokens[1].substr(1));
+    tick.tick_group = string(tokens[2].substr(kTickGroupPrefix));
+    tick.actor = string(actor);
+
+    if (splitTokens(actor, " ", tokens, 3) == 2)
+    {
+        // has object field
+        tick.type = string(tokens[0]);
+        actor = tokens[1];
+        tick.actor = string(actor);
+        if (splitTokens(actor, ":", tokens, 2) >= 2)
         {
-            std::string line;
-
-            // first pass
-            int lineNumber = 0;
-            while (std::getline(ifs, line))
-            {
-                if (line.find("Tick Functions (All)") != string::npos)
-                {
-                    line_startDumpTicks = lineNumber;
-                }
-                if (line.find("Total registered tick") != string::npos)
-                {
-                    line_endDumpTicks = lineNumber;
-                }
-
-                lineNumber++;
-            }
-            CI_ASSERT(line_endDumpTicks > line_startDumpTicks);
+            // separate level and actor
+            tick.level = string(tokens[0]);
+            auto tk = tokens[1];
+            if (tk.find("PersistentLevel") != string_view::npos)
+                tk = tk.substr(min(tk.size(), sizeof("PersistentLevel")));
+
+            auto count = splitTokens(tk, "[].", tokens, 3);
+            if (count > 2)
+                tick.component = string(tokens[1]);
+            if (count > 1)
+                tick.actor = string(tokens[0]);
+        }
+    }
+    return true;
+}
 
-            // second pass
-            lineNumber = 0;
-            ifs.clear();                 // clear fail and eof bits
-            ifs.seekg(0, std::ios::beg); // back to the start!
-            while (std::getline(ifs, line))
-            {
-                if (lineNumber > line_startDumpTicks && lineNumber < line_endDumpTicks)
-                {
-                    line = line.substr(30);
-                    auto tokens = split(line, ",");
-                    if (tokens.size() != 4) continue;
-                    TickFunction tick = { tokens[0], tokens[1].substr(1), tokens[2].substr(23)};
-                    tokens = split(tick.actor, ' ');
-                    if (tokens.size() == 2)
-                    {
-                        // has object field
-                        tick.type = tokens[0];
-                        tick.actor = tokens[1];
-                        tokens = split(tick.actor, ':');
-                        if (tokens.size() >= 2)
-                        {
-                            // separate level and actor
-                            tick.level = tokens[0];
-                            auto tk = tokens[1];
-                            if (tk.find("PersistentLevel") != string::npos)
-                                tk = tk.substr(sizeof("PersistentLevel"));
-
-                            tokens = split(tk, "[].");
-                            if (tokens.size() > 2)
-                                tick.component = tokens[1];
-                            if (tokens.size() > 1)
-                                tick.actor = tokens[0];
-                        }
+// The tick functions of the last dumpticks in the log
+static vector<TickFunction> scanDumpTicks(const string& logPath)
+{
+    vector<TickFunction> ticks;
+    LogScanner scanner;
+    if (!scanner.open(logPath))
+    {
+        CI_LOG_E("Failed to open " << logPath);
+        return ticks;
+    }
 
-                    }
-                    mTickFunctions.push_back(tick);
-                }
-                lineNumber++;
-            }
+    auto start = scanner.findLastLine("Tick Functions (All)");
+    if (start == LogScanner::npos)
+    {
+        CI_LOG_W("No dumpticks in " << logPath);
+        return ticks;
+    }
+    scanner.forEachLine(scanner.nextLine(start), [&](string_view line) {
+        if (line.find("Total registered tick") != string_view::npos)
+            return false;
+        TickFunction tick;
+        if (parseTickFunction(line, tick))
+            ticks.push_back(move(tick));
+        return true;
+    });
+    return ticks;
+}
 
-            if (!mTickFunctions.empty())
+void PerfDoctorApp::getDumpTicks()
+{
+    if (mIsScanningLog)
+    {
+        CI_LOG_W("Still busy with the last dumpticks");
+        return;
+    }
+    mIsScanningLog = true;
+
+    auto session = getSession();
+    string serial = session ? session->mSerial : "";
+    auto fn = [this, serial]() {
+        // pulling and scanning a log of hundreds of MB takes a while, the UI keeps going meanwhile
+        mLogTask = async(launch::async, [this, serial] {
+            runAdb(serial, "pull " + getUnrealLogPath());
+
+            string csv_name;
+            auto ticks = scanDumpTicks(APP_FOLDER + ".log");
+            if (!ticks.empty())
             {
                 auto ts = getTimestampForFilename();
-                string csv_name = APP_FOLDER + "-ticks-" + ts + ".csv";
+                csv_name = APP_FOLDER + "-ticks-" + ts + ".csv";
                 ofstream ofs(getAppPath() / csv_name);
                 if (ofs.is_open())
                 {
                     ofs << "Actor,Component,Type,Level,Status,TickGroup" << endl;
-                    for (const auto& item : mTickFunctions)
+                    for (const auto& item : ticks)
                     {
                         ofs << item.actor << ","
                             << item.component << ","
@@ -1539,31 +2639,15 @@ void PerfDoctorApp::getDumpTicks()
                     }
                 }
                 ofs.close();
-                launchWebBrowser(Url(csv_name, true));
             }
-        }
 
-        //char str[256];
-        //sprintf(str, "shell ls -l /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports", APP_FOLDER.c_str(), APP_FOLDER.c_str());
-        //auto lines = executeAdb(str);
-        //if (lines.size() > 1)
-        //{
-        //    auto folder = lines[lines.size() - 1];;
-        //    auto tokens = split(folder, ' ');
-        //    folder = tokens[tokens.size() - 1];
-
-        //    sprintf(str, "shell ls -l /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports/%s", APP_FOLDER.c_str(), APP_FOLDER.c_str(), folder.c_str());
-        //    lines = executeAdb(str);
-        //    if (lines.size() > 1)
-        //    {
-        //        auto lastLine = lines[lines.size() - 1];
-        //        tokens = split(lastLine, ' ');
-        //        auto lastFile = tokens[tokens.size() - 1];
-        //        sprintf(str, "pull /sdcard/UE4Game/%s/%s/Saved/Profiling/MemReports/%s/%s", APP_FOLDER.c_str(), APP_FOLDER.c_str(), folder.c_str(), lastFile.c_str());
-        //        executeAdb(str);
-        //        launchWebBrowser(Url(lastFile, true));
-        //    }
-        //}
+            // the browser is opened from the UI thread like everything else
+            dispatchAsync([this, csv_name] {
+                if (!csv_name.empty())
+                    launchWebBrowser(Url(csv_name, true));
+                mIsScanningLog = false;
+            });
+        });
     };
     timeline().add(fn, timeline().getCurrentTime() + 1);
 }
@@ -1612,102 +2696,33 @@ void PerfDoctorApp::setup()
     //ImPlot::SetNextMarkerStyle(ImPlotMarker_Square, 5, ImVec4(1, 0.5f, 0, 0.25f));
 
     mAdbThread = make_unique<thread>([this] {
-        static auto lastTimestamp = getElapsedSeconds();
         while (mIsRunning)
         {
             string asyncCmd;
-            if (mAsyncCommands.tryPopBack(&asyncCmd))
-            {
-                string output;
-                runCmd(asyncCmd, output);
-                if (asyncCmd.find("perfetto") != string::npos)
-                {
-                    auto cmds = split(asyncCmd, " ");
-                    launchWebBrowser(Url("https://ui.perfetto.dev/#!/", true));
-                    goto_folder(getAppPath(), getAppPath() / (cmds[1] + ".perfetto"));
-                }
-                else if (asyncCmd.find("screenshot") != string::npos && asyncCmd.find("hide_screenshot") == string::npos)
-                {
-                    auto cmds = split(asyncCmd, " ");
-                    launchWebBrowser(Url(cmds[1] + ".png", true));
-                }
-            }
-
-            if (mPackageName.empty() || !mIsProfiling || getElapsedSeconds() - lastTimestamp < REFRESH_SECONDS)
+            if (!mAsyncCommands.tryPopBack(&asyncCmd))
             {
-                sleep(1);
+                sleep(10);
                 continue;
             }
-            lastTimestamp = getElapsedSeconds();
-
-            AdbResults results;
-            char cmd[256];
-            if (!mSurfaceViewName.empty())
-            {
-                sprintf(cmd, "shell dumpsys SurfaceFlinger --latency \\\"%s\\\"", mSurfaceViewName.c_str());
-                results.SurfaceFlinger_latency = executeAdb(cmd);
-            }
-            else if (SUPPORT_NON_GAME && storage.metric_storage["fps"].visible)
-            {
-                sprintf(cmd, "shell dumpsys gfxinfo %s framestats", mPackageName.c_str());
-                results.dumpsys_gfxinfo = executeAdb(cmd);
-            }
-            results.EPOCHREALTIME = executeAdb("shell echo $EPOCHREALTIME");
-            if (storage.metric_storage["cpu_usage"].visible || storage.metric_storage["core_usage"].visible)
-            {
-                results.proc_stat = executeAdb("shell cat /proc/stat");
-            }
 
-            if (storage.metric_storage["memory_usage"].visible)
+            string output;
+            runCmd(asyncCmd, output);
+            if (asyncCmd.find("perfetto") != string::npos)
             {
-                sprintf(cmd, "shell dumpsys meminfo %s", mPackageName.c_str());
-                results.dumpsys_meminfo = executeAdb(cmd);
+                auto cmds = split(asyncCmd, " ");
+                launchWebBrowser(Url("https://ui.perfetto.dev/#!/", true));
+                goto_folder(getAppPath(), getAppPath() / (cmds[1] + ".perfetto"));
             }
-
-            if (storage.metric_storage["core_freq"].visible)
+            else if (asyncCmd.find("screenshot") != string::npos && asyncCmd.find("hide_screenshot") == string::npos)
             {
-                results.scaling_cur_freq = executeAdb("shell cat /sys/devices/system/cpu/cpu*/cpufreq/scaling_cur_freq");
-            }
-
-            if (storage.metric_storage["cpu_usage"].visible)
-            {
-                sprintf(cmd, "shell cat /proc/%d/stat", pid);
-                results.proc_pid_stat = executeAdb(cmd);
-                if (!results.proc_pid_stat.empty() && results.proc_pid_stat[0].find("error") != string::npos)
-                {
-                    results.success = false;
-                }
-            }
-
-            {
-                if (!mTemparatureStatSlot.cpu.empty())
-                {
-                    sprintf(cmd, "shell cat %s", mTemparatureStatSlot.cpu.c_str());
-                    auto lines = executeAdb(cmd);
-                    if (!lines.empty()) results.temperature.cpu = stoi(lines[0]) * 1e-3;
-                }
-                if (!mTemparatureStatSlot.gpu.empty())
-                {
-                    sprintf(cmd, "shell cat %s", mTemparatureStatSlot.gpu.c_str());
-                    auto lines = executeAdb(cmd);
-                    if (!lines.empty()) results.temperature.gpu = stoi(lines[0]) * 1e-3;
-                }
-                if (!mTemparatureStatSlot.battery.empty())
-                {
-                    sprintf(cmd, "shell cat %s", mTemparatureStatSlot.battery.c_str());
-                    auto lines = executeAdb(cmd);
-                    if (!lines.empty()) results.temperature.battery = stoi(lines[0]) * 1e-3;
-                }
+                auto cmds = split(asyncCmd, " ");
+                launchWebBrowser(Url(cmds[1] + ".png", true));
             }
-
-            mAdbResults.pushFront(results);
         }
     });
 
     refreshDeviceNames();
 
-    mLastUpdateTime = getElapsedSeconds();
-
     getWindow()->getSignalKeyDown().connect([&](KeyEvent& event) {
         if (event.getCode() == KeyEvent::KEY_ESCAPE)
         {
@@ -1718,6 +2733,7 @@ void PerfDoctorApp::setup()
             memory_usage_visible = storage.metric_storage["memory_usage"].visible;
             core_freq_visible = storage.metric_storage["core_freq"].visible;
             temperature_visible = storage.metric_storage["temperature"].visible;
+            frame_phases_visible = storage.metric_storage["frame_phases"].visible;
 
             COLOR_MAP = ImPlot::GetStyle().Colormap;
 
@@ -1735,7 +2751,10 @@ void PerfDoctorApp::setup()
 
     getWindow()->getSignalClose().connect([&] {
         mIsRunning = false;
+        gCancelCommands = true;
         mAdbThread->join();
+        if (mLogTask.valid()) mLogTask.wait();
+        mSessions.clear();
     });
 
     getWindow()->getSignalResize().connect([&] {
@@ -1756,18 +2775,14 @@ void PerfDoctorApp::setup()
             ImGui::End();
         }
 
-        if (mIsProfiling)
+        bool updated = false;
+        for (auto& session : mSessions)
         {
-            AdbResults results;
-            if (mAdbResults.tryPopBack(&results))
-            {
-                if (results.success)
-                {
-                    updateProfiler(results);
-                    updateMetricsData();
-                }
-            }
+            if (session->update())
+                updated = true;
         }
+        if (updated)
+            updateMetricsData();
 
         if (ImGui::Begin("Performance"))
         {
@@ -1775,6 +2790,9 @@ void PerfDoctorApp::setup()
         }
         ImGui::End();
 
+        drawMemReportWindow();
+        drawSelectionWindow();
+
     });
 
     getSignalCleanup().connect([&] {
@@ -2,107 +2,57 @@
 #include "MiniConfigImgui.h"
 
 
-static ImPlotPoint frameTime_getter(void* data, int idx)
+// What a getter plots, a field of what is visible of a series of one session.
+// The series hold the values as plotted, anything derived is computed when the sample arrives.
+struct PlotContext
 {
-    const auto& self = *(vector<pair<uint64_t, uint64_t>>*)data;
-    return ImPlotPoint((self[idx].first - firstFrameTimestamp) * 1e-3, self[idx].second);
-}
-
-static ImPlotPoint fps_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, float>>*)data;
-    return ImPlotPoint((self[idx].first - firstFrameTimestamp) * 1e-3, self[idx].second);
-}
-
-static ImPlotPoint cpuUsage_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, CpuStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, calcCpuUsage(self[idx].second, self[idx + 1].second));
-}
-
-static ImPlotPoint cpuFreq_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, CpuStat>>*)data;
-    int cpu_id = self[idx].second.cpu_id;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.freq * 100 / mCpuConfigs[cpu_id].cpuinfo_max_freq);
-}
+    const DeviceSession* session;
+    SeriesView view;
+    int field;
+};
 
-static ImPlotPoint app_cpuUsage_getter(void* data, int idx)
+// The part of a series in the time range of the plots at about two points per horizontal pixel,
+// so a chart costs the same however long the session is. Call it between BeginPlot and EndPlot.
+static PlotContext getPlotContext(const DeviceSession* session, const Series& series, int field)
 {
-    const auto& self = *(vector<pair<uint64_t, AppCpuStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, calcAppCpuUsage(
-        mCpuStats[idx].second, mCpuStats[idx + 1].second,
-        self[idx].second, self[idx + 1].second));
+    auto start = session->getSeriesTime(series, global_min_t);
+    auto end = session->getSeriesTime(series, global_max_t);
+    size_t maxPoints = max(2.0f, ImPlot::GetPlotSize().x * 2);
+    return { session, series.getView(start, end, maxPoints), field };
 }
 
-static ImPlotPoint memoryUsage_getter(void* data, int idx)
+static double getPlotSeconds(const PlotContext& ctx, int idx)
 {
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.pssTotal);
+    return ctx.session->getSeriesSeconds(*ctx.view.series, ctx.view.getTime(idx));
 }
 
-static ImPlotPoint gl_memoryUsage_getter(void* data, int idx)
+static ImPlotPoint series_getter(void* data, int idx)
 {
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.pssGL + self[idx].second.pssEGL + self[idx].second.pssGfx);
+    const auto& ctx = *(PlotContext*)data;
+    return ImPlotPoint(getPlotSeconds(ctx, idx), ctx.view.get(idx, ctx.field));
 }
 
-static ImPlotPoint nativeheap_memoryUsage_getter(void* data, int idx)
+static ImPlotPoint base_getter(void* data, int idx)
 {
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.pssNativeHeap);
-}
-
-static ImPlotPoint unknown_memoryUsage_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.pssUnknown);
-}
-
-static ImPlotPoint privateClean_memoryUsage_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.privateClean);
-}
-
-static ImPlotPoint privateDirty_memoryUsage_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, MemoryStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.privateDirty);
-}
-
-static ImPlotPoint temp_cpu_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, TemperatureStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.cpu);
-}
-
-static ImPlotPoint temp_gpu_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, TemperatureStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.gpu);
-}
-
-static ImPlotPoint temp_battery_getter(void* data, int idx)
-{
-    const auto& self = *(vector<pair<uint64_t, TemperatureStat>>*)data;
-    return ImPlotPoint((self[idx].first - firstCpuStatTimestamp) * 1e-3, self[idx].second.battery);
+    const auto& ctx = *(PlotContext*)data;
+    return ImPlotPoint(getPlotSeconds(ctx, idx), 0);
 }
 
 // Plots axis-aligned, filled rectangles. Every two consecutive points defines opposite corners of a single rectangle.
 static ImPlotPoint label_getter(void* data, int idx)
 {
-    auto* self = (LabelPair*)data;
+    const auto& ctx = *(PlotContext*)data;
+    const auto& self = ctx.session->mLabelPairs;
     int span_idx = idx / 2;
     int tag = idx % 2;
     if (tag == 0)
     {
-        float start_t = (self[span_idx].start - firstFrameTimestamp) * 1e-3;
+        float start_t = (self[span_idx].start - ctx.session->firstFrameTimestamp) * 1e-3;
         return ImPlotPoint(start_t, 0);
     }
     else
     {
-        float end_t = (self[span_idx].end - firstFrameTimestamp) * 1e-3;
+        float end_t = (self[span_idx].end - ctx.session->firstFrameTimestamp) * 1e-3;
         return ImPlotPoint(end_t, 10);
     }
 }
@@ -137,6 +87,11 @@ void PerfDoctorApp::drawLeftSidePanel()
             {
                 getUnrealLog(true);
             }
+            ImGui::SameLine();
+            if (ImGui::Button("MemReports"))
+            {
+                mMemReportView.visible = !mMemReportView.visible;
+            }
 
             if (ImGui::CollapsingHeader("UE4CommandLine", ImGuiTreeNodeFlags_DefaultOpen))
             {
@@ -206,16 +161,19 @@ void PerfDoctorApp::drawDeviceTab()
 
     if (DEVICE_ID != mDeviceId)
     {
-        refreshDeviceDetails();
-        resetPerfData();
+        // the other sessions keep profiling, only fetch what the newly picked device is missing
+        auto session = getSession();
+        if (session && !session->mHasDetails)
+            refreshDeviceDetails();
         mDeviceId = DEVICE_ID;
     }
 
-    if (DEVICE_ID != -1)
+    auto session = getSession();
+    if (session)
     {
-        if (ImGui::Combo("Pick an app", &mAppId, mAppNames, ImGuiComboFlags_HeightLarge))
+        if (ImGui::Combo("Pick an app", &session->mAppId, session->mAppNames, ImGuiComboFlags_HeightLarge))
         {
-            APP_NAME = mAppNames[mAppId];
+            APP_NAME = session->mAppNames[session->mAppId];
         }
 
         ImGui::SameLine();
@@ -230,16 +188,16 @@ void PerfDoctorApp::drawDeviceTab()
                 if (APP_NAME != topAppName)
                 {
                     APP_NAME = topAppName;
-                    mPackageName = APP_NAME;
+                    session->mPackageName = APP_NAME;
                     stopProfiler();
                 }
 
                 int idx = 0;
-                for (auto& name : mAppNames)
+                for (auto& name : session->mAppNames)
                 {
                     if (name == APP_NAME)
                     {
-                        mAppId = idx;
+                        session->mAppId = idx;
                         break;
                     }
                     idx++;
@@ -247,19 +205,19 @@ void PerfDoctorApp::drawDeviceTab()
             }
         }
 
-        if (mAppId != -1)
+        if (session->mAppId != -1)
         {
             if (ImGui::Button("Start App"))
             {
-                startApp(mAppNames[mAppId]);
+                startApp(session->mAppNames[session->mAppId]);
             }
             ImGui::SameLine();
             if (ImGui::Button("Stop App"))
             {
-                stopApp(mAppNames[mAppId]);
+                stopApp(session->mAppNames[session->mAppId]);
             }
             
-            if (mIsProfiling)
+            if (session->mIsProfiling)
             {
                 if (ImGui::Button("Stop Profiling"))
                 {
@@ -270,28 +228,36 @@ void PerfDoctorApp::drawDeviceTab()
 
                 if (ImGui::Button("Export"))
                 {
-                    exportCsv();
+                    session->exportCsv();
                 }
-                if (!mSurfaceResolution.empty())
+                if (!session->mSurfaceResolution.empty())
                 {
                     ImGui::SameLine();
-                    ImGui::Text("WxH: %s", mSurfaceResolution.c_str());
+                    ImGui::Text("WxH: %s", session->mSurfaceResolution.c_str());
                 }
             }
             else
             {
                 if (mAutoStart)
                 {
-                    startProfiler(mAppNames[mAppId]);
+                    startProfiler(session->mAppNames[session->mAppId]);
                     mAutoStart = false;
                 }
                 if (ImGui::Button("Start Profiling"))
                 {
-                    startProfiler(mAppNames[mAppId]);
+                    startProfiler(session->mAppNames[session->mAppId]);
                 }
             }
         }
 
+        if (mSessions.size() > 1 && !APP_NAME.empty())
+        {
+            if (ImGui::Button("Profile on all devices"))
+            {
+                startProfilerOnAllDevices();
+            }
+        }
+
         if (ImGui::Button("Screenshot"))    screenshot();
         ImGui::SameLine();
         if (ImGui::Button("Perfetto"))      capturePerfetto();
@@ -301,39 +267,52 @@ void PerfDoctorApp::drawDeviceTab()
         if (ImGui::CollapsingHeader("Config", ImGuiTreeNodeFlags_DefaultOpen))
         {
             ImGui::Indent();
-            if (!mDeviceStat.os_version.empty())
-                ImGui::Text(mDeviceStat.os_version.c_str());
-            if (!mDeviceStat.hardware.empty())
-                ImGui::Text("%s", mDeviceStat.hardware.c_str());
-            if (!mDeviceStat.gpu_name.empty())
-                ImGui::Text("%s", mDeviceStat.gpu_name.c_str());
+            if (!session->mDeviceStat.os_version.empty())
+                ImGui::Text(session->mDeviceStat.os_version.c_str());
+            if (!session->mDeviceStat.hardware.empty())
+                ImGui::Text("%s", session->mDeviceStat.hardware.c_str());
+            if (!session->mDeviceStat.gpu_name.empty())
+                ImGui::Text("%s", session->mDeviceStat.gpu_name.c_str());
 #if 0
-            if (mDeviceStat.width > 0 && mDeviceStat.height > 0)
-                ImGui::Text("%d x %d", mDeviceStat.width, mDeviceStat.height);
+            if (session->mDeviceStat.width > 0 && session->mDeviceStat.height > 0)
+                ImGui::Text("%d x %d", session->mDeviceStat.width, session->mDeviceStat.height);
 #endif
-            if (!mDeviceStat.gfx_api_version.empty())
-                ImGui::Text(mDeviceStat.gfx_api_version.c_str());
-            if (!mDeviceStat.display_WxH.empty())
-                ImGui::Text("Phone WxH: %s", mDeviceStat.display_WxH.c_str());
-            if (mDeviceStat.fps_max != 0)
-                ImGui::Text("FPS max:%d now:%d", mDeviceStat.fps_max, mDeviceStat.fps_now);
-            for (const auto& config : mCpuConfigs)
-            {
-                if (config.cpuinfo_min_freq > 0)
-                {
-                    ImGui::Text("cpu_%d: %s %.2f~%.2f GHz",
-                        config.id, config.part.c_str(),
-                        config.cpuinfo_min_freq / 1e6, config.cpuinfo_max_freq / 1e6);
-                }
-                else
-                {
-                    ImGui::Text("cpu_%d: %s",
-                        config.id, config.part.c_str());
-                }
+            if (!session->mDeviceStat.gfx_api_version.empty())
+                ImGui::Text(session->mDeviceStat.gfx_api_version.c_str());
+            if (!session->mDeviceStat.display_WxH.empty())
+                ImGui::Text("Phone WxH: %s", session->mDeviceStat.display_WxH.c_str());
+            if (session->mDeviceStat.fps_max != 0)
+                ImGui::Text("FPS max:%d now:%d", session->mDeviceStat.fps_max, session->mDeviceStat.fps_now);
+            for (const auto& cluster : session->mCpuClusters)
+            {
+                // cpu_4-6: Cortex-A76 2.40 GHz
+                string cpus = toString(cluster.cpus[0]);
+                if (cluster.cpus.size() > 1)
+                    cpus += (cluster.cpus.back() - cluster.cpus[0] + 1 == cluster.cpus.size() ? "-" : "..") + toString(cluster.cpus.back());
+                ImGui::Text("cpu_%s: %s", cpus.c_str(), cluster.name.c_str());
             }
             ImGui::Unindent();
         }
 
+        int pacedFrames = session->mJankStats.getPacedFrames();
+        if (pacedFrames > 0 && ImGui::CollapsingHeader("Frame Pacing", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            // frames by the refresh periods they stayed on screen, a steady frame rate is a single bar
+            static const double kBins[] = { 0, 1, 2, 3 };
+            static const char* kBinNames[] = { "1", "2", "3", "4+" };
+            float shares[JankStats::kPacingBins];
+            for (int i = 0; i < JankStats::kPacingBins; i++)
+                shares[i] = session->mJankStats.pacing[i] * 100.0f / pacedFrames;
+            ImPlot::SetNextAxisLimits(ImAxis_Y1, 0, 100, ImGuiCond_Always);
+            if (ImPlot::BeginPlot("##pacing", NULL, NULL, ImVec2(-1, PANEL_HEIGHT / 2),
+                ImPlotFlags_NoChild | ImPlotFlags_NoMenus | ImPlotFlags_NoLegend, ImPlotAxisFlags_AutoFit))
+            {
+                ImPlot::SetupAxisTicks(ImAxis_X1, kBins, JankStats::kPacingBins, kBinNames);
+                ImPlot::PlotBars("vsyncs", shares, JankStats::kPacingBins);
+                ImPlot::EndPlot();
+            }
+        }
+
         if (ImGui::CollapsingHeader("Charts", ImGuiTreeNodeFlags_DefaultOpen))
         {
             for (auto& kv : storage.metric_storage)
@@ -349,9 +328,80 @@ void PerfDoctorApp::drawDeviceTab()
             if (ImGui::Button("Running Critical")) trimMemory("RUNNING_CRITICAL");
         }
 
+        if (mSessions.size() > 1 && ImGui::CollapsingHeader("Sessions", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            drawSessionList();
+        }
+    }
+}
+
+void PerfDoctorApp::drawSessionList()
+{
+    ImGui::Checkbox("Overlay devices", &OVERLAY_DEVICES);
+    ImGui::Checkbox("Record capture", &RECORD_CAPTURE);
+    ImGui::SameLine();
+    if (ImGui::Button("Open capture..."))
+    {
+        auto path = getOpenFilePath(getAppPath() / "captures", { "pdcap" });
+        if (!path.empty())
+            openCapture(path);
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    ImGui::DragFloat("Replay speed", &REPLAY_SPEED, 1, 0, 1000, REPLAY_SPEED > 0 ? "%.0fx" : "max");
+
+    int closedReplay = -1;
+    for (int i = 0; i < mSessions.size(); i++)
+    {
+        auto& session = *mSessions[i];
+        ImGui::PushID(i);
+        ImGui::Checkbox("##visible", &session.mVisible);
+        ImGui::SameLine();
+        if (session.mIsProfiling)
+        {
+            ImGui::Text("%s: %s %.0fs", session.mDeviceName.c_str(), session.mPackageName.c_str(), session.getDuration());
+            if (ImGui::IsItemHovered())
+            {
+                const auto& queue = session.mAdbResults;
+                ImGui::SetTooltip("sample queue %d/%d, %d dropped, sampler stalled %.1f s\n"
+                    "clock %s, drift %.0f ppm\n"
+                    "parse %.0f us + ingest %.0f us per sample\n"
+                    "series %.1f MB",
+                    (int)queue.size(), (int)queue.capacity(), (int)queue.getDrops(), queue.getStallUs() * 1e-6,
+                    session.mClockSync.isSynced() ? "synced to frames" : "not synced", session.mClockSync.getDriftPpm(),
+                    session.mParseCount > 0 ? (double)session.mParseUs / session.mParseCount : 0.0,
+                    session.mIngestCount > 0 ? session.mIngestUs / session.mIngestCount : 0.0,
+                    session.mSeries.getMemoryBytes() / (1024.0 * 1024.0));
+            }
+            if (session.mMissingFrames > 0)
+            {
+                ImGui::SameLine();
+                ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "~%d frames missing", session.mMissingFrames);
+            }
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Stop"))
+                session.stopProfiler();
+            if (session.mIsReplay)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Close"))
+                    closedReplay = i;
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Benchmark"))
+                    session.benchmarkReplay(10);
+            }
+        }
+        else
+        {
+            ImGui::TextDisabled("%s", session.mDeviceName.c_str());
+        }
+        ImGui::PopID();
     }
+    if (closedReplay != -1)
+        mSessions.erase(mSessions.begin() + closedReplay);
 }
 
+
 void PerfDoctorApp::drawPerfPanel()
 {
 #if 0
@@ -405,6 +455,58 @@ void PerfDoctorApp::drawPerfPanel()
     }
 #endif
 
+    vector<DeviceSession*> sessions;
+    for (auto& session : mSessions)
+    {
+        if (session->mVisible && (session->mIsProfiling || session->hasData()))
+            sessions.push_back(session.get());
+    }
+    if (sessions.empty() && getSession())
+        sessions.push_back(getSession()); // empty charts of the picked device
+
+    if (OVERLAY_DEVICES || sessions.size() <= 1)
+    {
+        drawSessionPlots(sessions);
+        return;
+    }
+
+    // side by side, one column per device
+    if (ImGui::BeginTable("sessions", sessions.size(), ImGuiTableFlags_BordersInnerV))
+    {
+        for (auto session : sessions)
+        {
+            ImGui::TableNextColumn();
+            ImGui::PushID(session);
+            ImGui::Text("%s", session->mDeviceName.c_str());
+            drawSessionPlots({ session });
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+}
+
+void PerfDoctorApp::drawSessionPlots(const vector<DeviceSession*>& sessions)
+{
+    if (sessions.empty()) return;
+
+    // item names are prefixed by the device once several sessions share a plot
+    auto itemName = [&](const DeviceSession* session, const string& name) {
+        return sessions.size() > 1 ? session->mDeviceName + "/" + name : name;
+    };
+    const auto& first = *sessions[0];
+
+    auto plotCores = [&](const DeviceSession* session, const string& series_name, const vector<int>& cpus) {
+        bool usage = series_name == "core_usage";
+        for (int i : cpus)
+        {
+            if (i >= session->mCoreUsage.size()) continue;
+            // frequencies in % of the max of the core
+            auto core = usage ? getPlotContext(session, *session->mCoreUsage[i], 0) : getPlotContext(session, *session->mCoreFreq[i], 1);
+            auto label = itemName(session, "cpu_" + toString(i));
+            ImPlot::PlotLineG(label.c_str(), series_getter, (void*)&core, core.view.count);
+        }
+    };
+
     bool s_drawLabel = true;
     for (const auto& kv : storage.metric_storage)
     {
@@ -425,20 +527,100 @@ void PerfDoctorApp::drawPerfPanel()
                 ImPlotFlags_NoLegend | ImPlotFlags_NoTitle | ImPlotFlags_NoMenus, ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_NoTickMarks, ImPlotAxisFlags_NoDecorations))
             {
                 // TODO:
-                //ImPlot::PlotRects("label", label_getter, (void*)mLabelPairs.data(), mLabelPairs.size() * 2);
-                for (const auto& pair : mLabelPairs)
+                //ImPlot::PlotRects("label", label_getter, (void*)&ctx, mLabelPairs.size() * 2);
+                double mouseT = ImPlot::GetPlotMousePos().x;
+                for (auto session : sessions)
                 {
-                    float start = (pair.start - firstFrameTimestamp) * 1e-3;
-                    float end = (pair.end - firstFrameTimestamp) * 1e-3;
+                    for (const auto& pair : session->mLabelPairs)
+                    {
+                        float start = (pair.start - session->firstFrameTimestamp) * 1e-3;
+                        float end = (pair.end - session->firstFrameTimestamp) * 1e-3;
+
+                        ImPlot::PlotText(itemName(session, pair.name).c_str(), (start + end) * 0.5, height / 2, false);
 
-                    ImPlot::PlotText(pair.name.c_str(), (start + end) * 0.5, height / 2, false);
+                        // a click picks the segment for the Selection window
+                        if (ImPlot::IsPlotHovered() && mouseT >= start && mouseT <= end
+                            && ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !ImGui::GetIO().KeyShift)
+                        {
+                            auto& selection = mSelectionView;
+                            selection.start = start;
+                            selection.end = end;
+                            selection.visible = true;
+                            selection.dirty = true;
+                        }
+
+                        const auto& frameTimes = pair.frameTimes;
+                        if (SHOW_TOOL_TIP && ImPlot::IsPlotHovered() && mouseT >= start && mouseT <= end && frameTimes.Count > 0)
+                        {
+                            ImGui::BeginTooltip();
+                            ImGui::Text("%s: %d frames, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, 1%% low %.1f fps",
+                                itemName(session, pair.name).c_str(), frameTimes.Count, frameTimes.getQuantile(0.5),
+                                frameTimes.getQuantile(0.9), frameTimes.getQuantile(0.99), getOnePercentLowFps(frameTimes));
+                            const auto& jank = pair.jank;
+                            ImGui::Text("jank %d, big jank %d, stutter %.2f%%, %d missed vsyncs",
+                                jank.janks, jank.bigJanks, jank.getStutter() * 100, jank.missedVsyncs);
+                            int pacedFrames = jank.getPacedFrames();
+                            if (pacedFrames > 0)
+                            {
+                                ImGui::Text("pacing 1: %.0f%%, 2: %.0f%%, 3: %.0f%%, 4+: %.0f%% vsyncs",
+                                    jank.pacing[0] * 100.0f / pacedFrames, jank.pacing[1] * 100.0f / pacedFrames,
+                                    jank.pacing[2] * 100.0f / pacedFrames, jank.pacing[3] * 100.0f / pacedFrames);
+                            }
+                            ImGui::EndTooltip();
+                        }
+                    }
                 }
+
+                // frames that went by between two reads of the frame window
+                auto drawList = ImPlot::GetPlotDrawList();
+                ImPlot::PushPlotClipRect();
+                for (auto session : sessions)
+                {
+                    for (const auto& span : session->mMissingSpans)
+                    {
+                        float start = (span.start - session->firstFrameTimestamp) * 1e-3;
+                        float end = (span.end - session->firstFrameTimestamp) * 1e-3;
+                        auto topLeft = ImPlot::PlotToPixels(start, height);
+                        auto bottomRight = ImPlot::PlotToPixels(end, 0);
+                        bottomRight.x = max(bottomRight.x, topLeft.x + 2); // keep short gaps visible
+                        drawList->AddRectFilled(topLeft, bottomRight, IM_COL32(220, 50, 50, 160));
+
+                        if (ImPlot::IsPlotHovered())
+                        {
+                            auto mouse = ImGui::GetMousePos();
+                            if (mouse.x >= topLeft.x && mouse.x <= bottomRight.x)
+                                ImGui::SetTooltip("%s: ~%d frames missing", session->mDeviceName.c_str(), span.frames);
+                        }
+                    }
+                }
+                ImPlot::PopPlotClipRect();
+                drawSelection();
                 ImPlot::EndPlot();
             }
 
             ImPlot::PopStyleColor();
         }
 
+        if ((series_name == "core_usage" || series_name == "core_freq") && sessions.size() == 1 && first.mCpuClusters.size() > 1)
+        {
+            // a plot per cluster, a dozen cores in one plot can't be told apart
+            for (const auto& cluster : first.mCpuClusters)
+            {
+                ImPlot::SetNextAxisLimits(ImAxis_X1, global_min_t, global_max_t, ImGuiCond_Always);
+                ImPlot::SetNextAxisLimits(ImAxis_Y1, series.min_x, series.max_x, ImGuiCond_Always);
+                string title = series_name + " " + cluster.name + "##" + series_name + toString(cluster.cpus[0]);
+                if (ImPlot::BeginPlot(title.c_str(), NULL, NULL, ImVec2(-1, PANEL_HEIGHT),
+                    ImPlotFlags_NoChild | ImPlotFlags_NoMenus, ImPlotAxisFlags_NoDecorations))
+                {
+                    ImPlot::SetupLegend(ImPlotLocation_North | ImPlotLocation_West);
+                    plotCores(&first, series_name, cluster.cpus);
+                    drawSelection();
+                    ImPlot::EndPlot();
+                }
+            }
+            continue;
+        }
+
         //ImPlot::SetNextPlotTicksX(global_min_t, global_max_t, PANEL_TICK_T);
         ImPlot::SetNextAxisLimits(ImAxis_X1, global_min_t, global_max_t, ImGuiCond_Always);
         //ImPlot::SetNextPlotTicksY(series.min_x, series.max_x, PANEL_TICK_X);
@@ -447,88 +629,169 @@ void PerfDoctorApp::drawPerfPanel()
         string title = series_name;
         char text[256];
 
-        if (series_name == "fps" && !mFpsArray.empty())
-        {
-            sprintf(text, "fps [%.1f, %.1f] avg: %.1f", mFpsSummary.Min, mFpsSummary.Max, mFpsSummary.Avg);
-            title = text;
-        }
-        if (series_name == "memory_usage" && !mMemoryStats.empty())
-        {
-            sprintf(text, "memory_usage [%.0f, %.0f] avg: %.0f", mMemorySummary.Min, mMemorySummary.Max, mMemorySummary.Avg);
-            title = text;
-        }
-        if (series_name == "temperature" && !mTemperatureStats.empty())
+        if (series_name == "frame_time")
         {
-            sprintf(text, "temperature [%.0f, %.0f] avg: %.0f", mCpuTempSummary.Min, mCpuTempSummary.Max, mCpuTempSummary.Avg);
-            title = text;
+            // the sketches merge, so this is over the frames of every session shown
+            MetricSummary frameTimes;
+            for (auto session : sessions)
+                frameTimes.merge(session->mFrameTimeSummary);
+            if (frameTimes.Count > 0)
+            {
+                sprintf(text, "frame_time p50: %.1f p90: %.1f p99: %.1f ms", frameTimes.getQuantile(0.5),
+                    frameTimes.getQuantile(0.9), frameTimes.getQuantile(0.99));
+                title = text;
+                if (sessions.size() == 1)
+                {
+                    const auto& jank = first.mJankStats;
+                    sprintf(text, ", jank: %d big jank: %d stutter: %.2f%%", jank.janks, jank.bigJanks, jank.getStutter() * 100);
+                    title += text;
+                }
+            }
         }
-        if (series_name == "cpu_usage" && !mAppCpuStats.empty())
+        if (sessions.size() == 1)
         {
-            sprintf(text, "cpu_usage [%.0f, %.0f] avg: %.1f", mAppCpuSummary.Min, mAppCpuSummary.Max, mAppCpuSummary.Avg);
-            //title = text;
-            // TODO: fix bug
+            if (series_name == "fps" && !first.mFpsArray.empty())
+            {
+                sprintf(text, "fps [%.1f, %.1f] avg: %.1f 1%% low: %.1f", first.mFpsSummary.Min, first.mFpsSummary.Max, first.mFpsSummary.Avg,
+                    getOnePercentLowFps(first.mFrameTimeSummary));
+                title = text;
+                if (!first.mRefreshRate.empty())
+                {
+                    // the same fps is smooth on one display and half the frames on another
+                    sprintf(text, ", refresh: %.0f Hz, avg %.0f%% of it", first.mRefreshRate.get(first.mRefreshRate.size() - 1),
+                        first.mFpsOfRefreshSummary.Avg);
+                    title += text;
+                }
+            }
+            if (series_name == "memory_usage" && !first.mMemoryStats.empty())
+            {
+                sprintf(text, "memory_usage [%.0f, %.0f] avg: %.0f", first.mMemorySummary.Min, first.mMemorySummary.Max, first.mMemorySummary.Avg);
+                title = text;
+            }
+            if (series_name == "temperature" && !first.mTemperatureStats.empty())
+            {
+                sprintf(text, "temperature [%.0f, %.0f] avg: %.0f", first.mCpuTempSummary.Min, first.mCpuTempSummary.Max, first.mCpuTempSummary.Avg);
+                title = text;
+            }
+            if (series_name == "frame_phases" && !first.mFramePhases.empty())
+            {
+                sprintf(text, "frame_phases avg: ui thread %.1f ms, render thread %.1f ms", first.mUiThreadSummary.Avg, first.mRenderThreadSummary.Avg);
+                title = text;
+            }
+            if (series_name == "cpu_usage" && !first.mAppCpuUsage.empty())
+            {
+                sprintf(text, "cpu_usage [%.0f, %.0f] avg: %.1f", first.mAppCpuSummary.Min, first.mAppCpuSummary.Max, first.mAppCpuSummary.Avg);
+                title = text;
+            }
         }
-        if (ImPlot::BeginPlot(title.c_str(), NULL, NULL, ImVec2(-1, PANEL_HEIGHT),
+        if (ImPlot::BeginPlot((title + "##" + series_name).c_str(), NULL, NULL, ImVec2(-1, PANEL_HEIGHT),
             ImPlotFlags_NoChild | ImPlotFlags_NoMenus, ImPlotAxisFlags_NoDecorations))
         {
             ImPlot::SetupLegend(ImPlotLocation_North | ImPlotLocation_West);
 
-            //ImPlot::PushStyleColor(ImPlotCol_Line, items[i].Col);
-            if (series_name == "frame_time")
+            for (auto session : sessions)
             {
-                ImPlot::PlotLineG(series_name.c_str(), frameTime_getter, (void*)&mFrameTimes, mFrameTimes.size());
-            }
-            else if (series_name == "fps")
-            {
-                ImPlot::PlotLineG(series_name.c_str(), fps_getter, (void*)&mFpsArray, mFpsArray.size());
-            }
-            else if (series_name == "cpu_usage")
-            {
-                if (!mCpuStats.empty())
+                // plots field of the series of this session
+                auto plotField = [&](const Series& data, int field, const string& name) {
+                    auto ctx = getPlotContext(session, data, field);
+                    ImPlot::PlotLineG(itemName(session, name).c_str(), series_getter, (void*)&ctx, ctx.view.count);
+                };
+
+                //ImPlot::PushStyleColor(ImPlotCol_Line, items[i].Col);
+                if (series_name == "frame_time")
                 {
-                    ImPlot::PlotLineG("sys", cpuUsage_getter, (void*)&mCpuStats, mCpuStats.size() - 1);
-                    ImPlot::PlotLineG("app", app_cpuUsage_getter, (void*)&mAppCpuStats, mAppCpuStats.size() - 1);
+                    plotField(session->mFrameTimes, 0, series_name);
+
+                    // the jank frames on top of their frame times
+                    auto plotJanks = [&](const Series& janks, const char* name, ImPlotMarker marker, const ImVec4& color) {
+                        auto ctx = getPlotContext(session, janks, 0);
+                        ImPlot::SetNextMarkerStyle(marker, 4, color, IMPLOT_AUTO, color);
+                        ImPlot::PlotScatterG(itemName(session, name).c_str(), series_getter, (void*)&ctx, ctx.view.count);
+                    };
+                    plotJanks(session->mJanks, "jank", ImPlotMarker_Circle, ImVec4(1, 0.7f, 0, 1));
+                    plotJanks(session->mBigJanks, "big_jank", ImPlotMarker_Diamond, ImVec4(1, 0.2f, 0.2f, 1));
                 }
-            }
-            else if (series_name == "core_usage")
-            {
-                char label[] = "cpu_0";
-                for (int i = 0; i < mCpuConfigs.size(); i++)
+                else if (series_name == "fps")
                 {
-                    label[4] = '0' + i;
-                    ImPlot::PlotLineG(label, cpuUsage_getter, (void*)&mChildCpuStats[i], mChildCpuStats[i].size() - 1);
+                    plotField(session->mFpsArray, 0, series_name);
+                    if (!session->mRefreshRate.empty())
+                        plotField(session->mRefreshRate, 0, "refresh_rate");
                 }
-            }
-            else if (series_name == "core_freq")
-            {
-                char label[] = "cpu_0";
-                for (int i = 0; i < mCpuConfigs.size(); i++)
+                else if (series_name == "cpu_usage")
                 {
-                    label[4] = '0' + i;
-                    ImPlot::PlotLineG(label, cpuFreq_getter, (void*)&mChildCpuStats[i], mChildCpuStats[i].size());
+                    plotField(session->mCpuUsage, 0, "sys");
+                    if (!session->mAppCpuUsage.empty())
+                        plotField(session->mAppCpuUsage, 0, "app");
                 }
+                else if (series_name == "core_usage" || series_name == "core_freq")
+                {
+                    vector<int> cpus;
+                    for (int i = 0; i < session->mCoreUsage.size(); i++)
+                        cpus.push_back(i);
+                    plotCores(session, series_name, cpus);
+                }
+                else if (series_name == "memory_usage")
+                {
+                    const auto& memory = session->mMemoryStats;
+                    plotField(memory, Memory_Total, "total");
+                    plotField(memory, Memory_NativeHeap, "native_heap");
+                    plotField(memory, Memory_Graphics, "graphics");
+                    plotField(memory, Memory_Unknown, "unknown");
+                    //plotField(memory, Memory_PrivateClean, "private_clean");
+                    //plotField(memory, Memory_PrivateDirty, "private_dirty");
+                }
+                else if (series_name == "temperature")
+                {
+                    const auto& temperature = session->mTemperatureStats;
+                    if (!session->mTemparatureStatSlot.cpu.empty())
+                        plotField(temperature, 0, "cpu");
+                    if (!session->mTemparatureStatSlot.gpu.empty())
+                        plotField(temperature, 1, "gpu");
+                    if (!session->mTemparatureStatSlot.battery.empty())
+                        plotField(temperature, 2, "battery");
+                }
+                else if (series_name == "frame_phases")
+                {
+                    // stacked, the top phase first so every phase below covers its part of the area
+                    const auto& frames = session->mFramePhases;
+                    int count = frames.size();
+                    for (int phase = GfxPhase_Count - 1; phase >= 0; phase--)
+                    {
+                        auto top = getPlotContext(session, session->mFramePhaseStack, phase);
+                        ImPlot::PlotShadedG(itemName(session, kGfxPhaseNames[phase]).c_str(),
+                            series_getter, (void*)&top, base_getter, (void*)&top, top.view.count);
+                    }
+
+                    if (SHOW_TOOL_TIP && ImPlot::IsPlotHovered() && count > 0)
+                    {
+                        // the frame completed closest after the mouse
+                        double t = ImPlot::GetPlotMousePos().x;
+                        uint64_t ts = session->firstFrameTimestamp + max(0.0, t) * 1e3;
+                        auto idx = frames.lowerBound(ts);
+                        if (idx < frames.size())
+                        {
+                            GfxFramePhases phases;
+                            for (int phase = 0; phase < GfxPhase_Count; phase++)
+                                phases.ms[phase] = frames.get(idx, phase);
+                            ImGui::BeginTooltip();
+                            ImGui::Text("%s%.1f ms, ui thread %.1f ms, render thread %.1f ms",
+                                sessions.size() > 1 ? (session->mDeviceName + ": ").c_str() : "",
+                                phases.getTotalMs(), phases.getUiThreadMs(), phases.getRenderThreadMs());
+                            for (int phase = 0; phase < GfxPhase_Count; phase++)
+                                ImGui::Text("  %s: %.1f ms", kGfxPhaseNames[phase], phases.ms[phase]);
+                            ImGui::EndTooltip();
+                        }
+                    }
+                }
+                else if (auto* data = session->mSeries.find(series_name))
+                {
+                    // registered by a metric without a chart of its own
+                    for (int field = 0; field < data->fields.size(); field++)
+                        plotField(*data, field, data->fields.size() > 1 ? data->fields[field] : series_name);
+                }
+                //ImPlot::PopStyleColor();
             }
-            else if (series_name == "memory_usage")
-            {
-                ImPlot::PlotLineG("total", memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-                ImPlot::PlotLineG("native_heap", nativeheap_memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-                ImPlot::PlotLineG("graphics", gl_memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-                ImPlot::PlotLineG("unknown", unknown_memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-                //ImPlot::PlotLineG("private_clean", privateClean_memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-                //ImPlot::PlotLineG("private_dirty", privateDirty_memoryUsage_getter, (void*)&mMemoryStats, mMemoryStats.size());
-            }
-            else if (series_name == "temperature")
-            {
-                if (!mTemparatureStatSlot.cpu.empty())
-                    ImPlot::PlotLineG("cpu", temp_cpu_getter, (void*)&mTemperatureStats, mTemperatureStats.size());
-                if (!mTemparatureStatSlot.gpu.empty())
-                    ImPlot::PlotLineG("gpu", temp_gpu_getter, (void*)&mTemperatureStats, mTemperatureStats.size());
-                if (!mTemparatureStatSlot.battery.empty())
-                    ImPlot::PlotLineG("battery", temp_battery_getter, (void*)&mTemperatureStats, mTemperatureStats.size());
-            }
-            else
-                ImPlot::PlotLineG(series_name.c_str(), MetricSeries::getter, (void*)&series, series.t_array.size());
-            //ImPlot::PopStyleColor();
+            drawSelection();
             ImPlot::EndPlot();
         }
     }
@@ -556,3 +819,345 @@ void PerfDoctorApp::drawLabel()
         ImPlot::EndPlot();
     }
 }
+
+void PerfDoctorApp::drawSelection()
+{
+    auto& view = mSelectionView;
+    if (ImPlot::IsPlotHovered() && ImGui::GetIO().KeyShift && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+    {
+        view.start = view.end = ImPlot::GetPlotMousePos().x;
+        view.dragging = true;
+        view.visible = true;
+    }
+    if (view.dragging)
+    {
+        // the charts share the time axis, whichever one the mouse is over moves the end
+        if (!ImGui::IsMouseDown(ImGuiMouseButton_Left))
+            view.dragging = false;
+        else if (ImPlot::IsPlotHovered())
+            view.end = ImPlot::GetPlotMousePos().x;
+        view.dirty = true;
+    }
+    if (view.start == view.end)
+        return;
+
+    // the full height of the plot, only the edges in time can be dragged
+    auto limits = ImPlot::GetPlotLimits();
+    double x0 = min(view.start, view.end), x1 = max(view.start, view.end);
+    double y0 = limits.Y.Min, y1 = limits.Y.Max;
+    if (ImPlot::DragRect(0, &x0, &y0, &x1, &y1, ImVec4(0.3f, 0.8f, 1, 1), ImPlotDragToolFlags_NoFit) && !view.dragging)
+    {
+        view.start = min(x0, x1);
+        view.end = max(x0, x1);
+        view.dirty = true;
+    }
+}
+
+void PerfDoctorApp::drawSelectionWindow()
+{
+    auto& view = mSelectionView;
+    if (!view.visible) return;
+
+    if (!ImGui::Begin("Selection", &view.visible))
+    {
+        ImGui::End();
+        return;
+    }
+
+    double start = min(view.start, view.end), end = max(view.start, view.end);
+    bool live = false;
+    for (const auto& session : mSessions)
+        live = live || session->mIsProfiling;
+    // not while an edge is being dragged, a query per series and frame would make the drag stutter
+    bool stale = view.dirty || (live && getElapsedSeconds() - view.updatedAt > REFRESH_SECONDS);
+    if (stale && !ImGui::IsMouseDown(ImGuiMouseButton_Left))
+    {
+        view.rows.clear();
+        for (const auto& session : mSessions)
+        {
+            if (!session->mVisible || !session->hasData() || start == end) continue;
+            for (const auto& kv : session->mSeries.getSeries())
+            {
+                // the series of the visible charts, the phase stack only exists to be drawn
+                const auto& name = kv.first;
+                const auto& series = *kv.second;
+                auto metric = storage.metric_storage.find(name.substr(0, name.find('.')));
+                if (series.fields.empty() || name == "frame_phases.stack"
+                    || (metric != storage.metric_storage.end() && !metric->second.visible))
+                    continue;
+
+                auto from = session->getSeriesTime(series, start);
+                auto to = session->getSeriesTime(series, end);
+                for (int field = 0; field < series.fields.size(); field++)
+                {
+                    auto summary = series.getSummary(from, to, field);
+                    if (summary.Count == 0) continue;
+                    string rowName = mSessions.size() > 1 ? session->mDeviceName + "/" + name : name;
+                    if (series.fields.size() > 1)
+                        rowName += "." + series.fields[field];
+                    view.rows.push_back({ rowName, move(summary) });
+                }
+            }
+        }
+        view.dirty = false;
+        view.updatedAt = getElapsedSeconds();
+    }
+
+    if (start == end)
+    {
+        ImGui::TextDisabled("shift + drag over a chart or click a label");
+        ImGui::End();
+        return;
+    }
+    ImGui::Text("%.1f s - %.1f s, %.1f s", start, end, end - start);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+    {
+        view.start = view.end = 0;
+        view.rows.clear();
+    }
+
+    auto flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV | ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("rows", 8, flags))
+    {
+        ImGui::TableSetupScrollFreeze(1, 1);
+        ImGui::TableSetupColumn("series", ImGuiTableColumnFlags_WidthStretch);
+        for (auto column : { "count", "avg", "min", "max", "p50", "p90", "p99" })
+            ImGui::TableSetupColumn(column, ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+
+        for (const auto& row : view.rows)
+        {
+            const auto& summary = row.summary;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(row.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", summary.Count);
+            for (float value : { summary.Avg, summary.Min, summary.Max,
+                summary.getQuantile(0.5), summary.getQuantile(0.9), summary.getQuantile(0.99) })
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+static bool containsNoCase(const string& text, const string& pattern)
+{
+    auto it = search(text.begin(), text.end(), pattern.begin(), pattern.end(),
+        [](char a, char b) { return tolower((unsigned char)a) == tolower((unsigned char)b); });
+    return it != text.end();
+}
+
+void PerfDoctorApp::drawMemReportWindow()
+{
+    auto& view = mMemReportView;
+    if (!view.visible) return;
+
+    if (!ImGui::Begin("MemReport", &view.visible))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Open..."))
+    {
+        auto path = getOpenFilePath(getAppPath(), { "memreport" });
+        if (!path.empty())
+            openMemReport(path.string());
+    }
+    if (mMemReports.empty())
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("or run memreport -full on the Unreal tab");
+        ImGui::End();
+        return;
+    }
+
+    auto reportCombo = [&](const char* label, int* id, bool allowNone) {
+        const char* preview = *id >= 0 ? mMemReports[*id].name.c_str() : "none";
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(250);
+        if (ImGui::BeginCombo(label, preview))
+        {
+            if (allowNone && ImGui::Selectable("none", *id < 0))
+            {
+                *id = -1;
+                view.dirty = true;
+            }
+            for (int i = 0; i < mMemReports.size(); i++)
+            {
+                ImGui::PushID(i);
+                if (ImGui::Selectable(mMemReports[i].name.c_str(), *id == i))
+                {
+                    *id = i;
+                    view.dirty = true;
+                }
+                ImGui::PopID();
+            }
+            ImGui::EndCombo();
+        }
+    };
+    reportCombo("report", &view.report, false);
+    reportCombo("diff against", &view.baseline, true);
+    const auto& report = mMemReports[view.report];
+    ImGui::SameLine();
+    if (ImGui::Button("Show file"))
+        launchWebBrowser(Url(report.path, true));
+
+    auto table = report.findTable(view.table);
+    if (!table)
+    {
+        // the class list answers most questions
+        table = &report.tables[0];
+        for (const auto& item : report.tables)
+        {
+            if (item.name.find("obj list") != string::npos)
+            {
+                table = &item;
+                break;
+            }
+        }
+        view.table = table->name;
+        view.dirty = true;
+    }
+    ImGui::SetNextItemWidth(250);
+    if (ImGui::BeginCombo("table", view.table.c_str()))
+    {
+        for (const auto& item : report.tables)
+        {
+            if (ImGui::Selectable(item.name.c_str(), &item == table))
+            {
+                view.table = item.name;
+                view.dirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    table = report.findTable(view.table);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(250);
+    bool filterChanged = ImGui::InputText("filter", &view.filter);
+
+    const MemReportTable* baseline = nullptr;
+    if (view.baseline >= 0 && view.baseline != view.report)
+        baseline = mMemReports[view.baseline].findTable(view.table);
+    bool otherColumns = baseline && baseline->columns != table->columns;
+    if (otherColumns)
+    {
+        // a build with other columns, every delta would be the whole value
+        baseline = nullptr;
+    }
+    bool resort = false;
+    if (view.dirty)
+    {
+        view.rows = diffMemReportTables(baseline, *table);
+        view.dirty = false;
+        resort = true;
+    }
+
+    int columnCount = table->columns.size();
+    const auto& sizeName = table->columns[table->sizeColumn];
+    if (baseline)
+    {
+        ImGui::Text("%d rows, %s %.1f, %+.1f since %s", (int)table->rows.size(), sizeName.c_str(),
+            table->getTotal(table->sizeColumn), table->getTotal(table->sizeColumn) - baseline->getTotal(table->sizeColumn),
+            mMemReports[view.baseline].name.c_str());
+    }
+    else
+    {
+        ImGui::Text("%d rows, %s %.1f", (int)table->rows.size(), sizeName.c_str(), table->getTotal(table->sizeColumn));
+    }
+    if (otherColumns)
+    {
+        ImGui::TextDisabled("not diffed, %s has other columns in %s", mMemReports[view.baseline].name.c_str(), view.table.c_str());
+    }
+
+    // name, detail, the values and with a baseline their deltas
+    int tableColumns = 2 + columnCount * (baseline ? 2 : 1);
+    auto flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg
+        | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV | ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("rows", tableColumns, flags))
+    {
+        ImGui::TableSetupScrollFreeze(1, 1);
+        ImGui::TableSetupColumn("name", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("detail", ImGuiTableColumnFlags_WidthFixed);
+        // biggest first, or with a baseline the top growers
+        int defaultSort = 2 + table->sizeColumn + (baseline ? columnCount : 0);
+        for (int i = 0; i < columnCount * (baseline ? 2 : 1); i++)
+        {
+            auto name = i < columnCount ? table->columns[i] : "+" + table->columns[i - columnCount];
+            auto columnFlags = ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending;
+            if (2 + i == defaultSort)
+                columnFlags |= ImGuiTableColumnFlags_DefaultSort;
+            ImGui::TableSetupColumn(name.c_str(), columnFlags);
+        }
+        ImGui::TableHeadersRow();
+
+        auto specs = ImGui::TableGetSortSpecs();
+        if (specs && specs->SpecsCount > 0 && (specs->SpecsDirty || resort))
+        {
+            int column = specs->Specs[0].ColumnIndex;
+            bool ascending = specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+            auto key = [&](const MemReportDelta& row) {
+                return column < 2 + columnCount ? row.values[column - 2] : row.deltas[column - 2 - columnCount];
+            };
+            stable_sort(view.rows.begin(), view.rows.end(), [&](const MemReportDelta& a, const MemReportDelta& b) {
+                if (column == 0) return ascending ? a.name < b.name : a.name > b.name;
+                if (column == 1) return ascending ? a.detail < b.detail : a.detail > b.detail;
+                return ascending ? key(a) < key(b) : key(a) > key(b);
+            });
+            specs->SpecsDirty = false;
+            filterChanged = true;
+        }
+        if (filterChanged || resort)
+        {
+            view.shown.clear();
+            for (int i = 0; i < view.rows.size(); i++)
+            {
+                const auto& row = view.rows[i];
+                if (view.filter.empty() || containsNoCase(row.name, view.filter) || containsNoCase(row.detail, view.filter))
+                    view.shown.push_back(i);
+            }
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(view.shown.size());
+        while (clipper.Step())
+        {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+            {
+                const auto& row = view.rows[view.shown[i]];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(row.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(row.detail.c_str());
+                for (float value : row.values)
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", value);
+                }
+                if (!baseline) continue;
+                for (float delta : row.deltas)
+                {
+                    ImGui::TableNextColumn();
+                    if (delta > 0)
+                        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%+.2f", delta);
+                    else if (delta < 0)
+                        ImGui::TextColored(ImVec4(0.4f, 1, 0.4f, 1), "%+.2f", delta);
+                    else
+                        ImGui::TextDisabled("0");
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
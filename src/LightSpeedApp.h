@@ -7,9 +7,30 @@
 #include "cinder/ConcurrentCircularBuffer.h"
 
 #include "AssetManager.h"
+#include "AdbShell.h"
+#include "Process.h"
+#include "SampleScript.h"
+#include "SampleScheduler.h"
+#include "AgentReceiver.h"
+#include "SpscQueue.h"
+#include "ClockSync.h"
+#include "Capture.h"
+#include "TextParse.h"
+#include "GfxFrameStats.h"
+#include "ProbeParse.h"
+#include "JankDetector.h"
+#include "MemReport.h"
+#include "QuantileSketch.h"
+#include "SeriesStore.h"
 #include "implot/implot.h"
 #include "implot/implot_internal.h"
 
+#include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -22,24 +43,44 @@ struct Span
     float end = 0;
 };
 
+// "1% low" fps, the frame rate of the slowest 1% of the frames
+inline float getOnePercentLowFps(const MetricSummary& frameTimes)
+{
+    float p99 = frameTimes.getQuantile(0.99);
+    return p99 > 0 ? 1000 / p99 : 0;
+}
+
 struct LabelPair
 {
     string name;
     uint64_t start = 0;
     uint64_t end = 0;
+    MetricSummary frameTimes; // of the frames in the label, ms
+    JankStats jank;
+};
+
+// Frames that went by between two reads of the frame window
+struct MissingSpan
+{
+    uint64_t start = 0; // last frame before the gap, ms
+    uint64_t end = 0; // first frame after the gap, ms
+    int frames = 0; // estimated from the frame rate around the gap
 };
 
-struct MemoryStat
+// Fields of the memory series of a session, MB
+enum MemoryField
 {
-    float pssTotal;
-    float pssGL;
-    float pssEGL;
-    float pssGfx;
-    float pssUnknown;
-    float pssNativeHeap;
-
-    float privateClean;
-    float privateDirty;
+    Memory_Total,
+    Memory_NativeHeap,
+    Memory_GL,
+    Memory_EGL,
+    Memory_Gfx,
+    Memory_Unknown,
+    Memory_PrivateClean,
+    Memory_PrivateDirty,
+    Memory_Fast,
+    Memory_Graphics, // GL + EGL + Gfx, derived at ingest
+    Memory_Count,
 };
 
 struct TemperatureStatSlot
@@ -56,7 +97,7 @@ struct TemperatureStat
 
 struct CpuConfig
 {
-    int id;
+    int id = 0;
     int cpuinfo_min_freq = 0, cpuinfo_max_freq = 0;
     string features;
     string implementer;
@@ -66,6 +107,13 @@ struct CpuConfig
     string revision;
 };
 
+// Cores of the same kind at the same max frequency, e.g. the little cores
+struct CpuCluster
+{
+    string name;
+    vector<int> cpus;
+};
+
 struct DeviceStat
 {
     int width = 0, height = 0;
@@ -78,48 +126,6 @@ struct DeviceStat
     string gpu_name;
 };
 
-struct CpuStat
-{
-    int cpu_id;
-    long int user, nice, sys, idle, iowait, irq, softirq;
-    int freq = -1;
-
-    CpuStat(const string& line)
-    {
-        char cpu[5]; // TODO: remove
-        sscanf(line.c_str(), "%s%d%d%d%d%d%d%d", cpu, &user, &nice, &sys, &idle, &iowait, &irq, &softirq);
-        cpu_id = cpu[3] - '0';
-    }
-
-    long int getAll() const
-    {
-        return user + nice + sys + idle + iowait + irq + softirq;
-    }
-
-    long int getIdle() const
-    {
-        return idle;
-    }
-};
-
-float calcCpuUsage(const CpuStat& lhs, const CpuStat& rhs);
-
-struct AppCpuStat
-{
-    // https://www.chenwenguan.com/android-performance-monitor-cpu/
-    long int utime, stime;
-    long int cutime, cstime;
-
-    AppCpuStat(const string& line);
-
-    long int getActiveTime() const
-    {
-        return utime + stime + cutime + cstime;
-    }
-};
-
-float calcAppCpuUsage(const CpuStat& lhs, const CpuStat& rhs, const AppCpuStat& appLhs, const AppCpuStat& appRhs);
-
 struct SpanSeries
 {
     string name;
@@ -148,6 +154,7 @@ struct SpanSeries
     }
 };
 
+// Settings of a chart, the data is in the SeriesStore of each session
 struct MetricSeries
 {
     bool visible = true;
@@ -156,18 +163,10 @@ struct MetricSeries
 
     }
 
-    static ImPlotPoint getter(void* data, int idx)
-    {
-        auto* self = (MetricSeries*)data;
-        return ImPlotPoint(self->t_array[idx], self->x_array[idx]);
-    }
-
     float min_x = 0;
     float max_x = 60;
 
     string name;
-    vector<float> t_array;
-    vector<float> x_array;
 };
 
 struct DataStorage
@@ -176,31 +175,41 @@ struct DataStorage
     unordered_map<string, MetricSeries> metric_storage;
 };
 
-// TODO: so ugly
 extern float global_min_t;
 extern float global_max_t;
-extern uint64_t firstFrameTimestamp;
-extern uint64_t deltaTimestamp;
-extern uint64_t firstCpuStatTimestamp;
-extern int pid;
-extern vector<pair<uint64_t, CpuStat>> mCpuStats;
-extern vector<CpuConfig> mCpuConfigs;
 
 int runCmd(const string& cmd, std::string& outOutput, bool waitForCompletion = true);
+const string& getAdbExe();
+
+// `adb -s <serial> <cmd>` split into lines, an empty serial lets adb pick the device
+vector<string> runAdb(const string& serial, const string& cmd);
+// the same unsplit, as the device sent it
+string runAdbOutput(const string& serial, const string& cmd);
+// the lines of adb output, empty ones dropped
+vector<string> splitAdbOutput(const string& output);
 
 struct AdbResults
 {
     bool success = true;
     vector<string> SurfaceFlinger_latency;
-    vector<string> dumpsys_gfxinfo;
-    vector<string> EPOCHREALTIME;
+    string dumpsys_gfxinfo;
+    double realtime = 0; // device $EPOCHREALTIME in seconds when the first probe of the batch started
+    double frames_realtime = 0; // $EPOCHREALTIME after the frame window was read, 0 without frames
     vector<string> proc_stat;
     vector<string> proc_pid_stat;
     vector<string> dumpsys_meminfo;
+    vector<string> proc_pid_smaps_rollup;
     vector<string> scaling_cur_freq;
     TemperatureStat temperature;
+    float display_fps = 0; // active refresh rate from display_refresh, 0 without it
+
+    bool agent_mode = false; // decoded records of perf-agent instead of text
+    AgentSamples agent;
 };
 
+// Fills the results from the framed output of the sample script, the probe timings go to scheduler
+bool parseAdbResults(const string& blob, AdbResults& results, SampleScheduler* scheduler = nullptr);
+
 struct TickFunction
 {
     string actor;
@@ -213,80 +222,244 @@ struct TickFunction
     //vector<string> prerequesities;
 };
 
+// Everything about one connected device: its details, its sampler thread and the recorded series.
+// Series are only touched by the UI thread, the sampler hands over AdbResults through mAdbResults.
+struct DeviceSession
+{
+    DeviceSession(const string& serial, const string& deviceName, bool isIOS, DataStorage& storage);
+    ~DeviceSession();
+
+    string mSerial;
+    string mDeviceName;
+    bool mIsIOS = false;
+    bool mVisible = true; // drawn in the perf panel
+    DataStorage& storage; // chart settings shared by all sessions
+
+    // details, filled by refreshDeviceDetails()
+    bool mHasDetails = false;
+    DeviceStat mDeviceStat;
+    vector<CpuConfig> mCpuConfigs; // indexed by cpu id, offline cores included
+    vector<CpuCluster> mCpuClusters; // slowest first
+    TemperatureStatSlot mTemparatureStatSlot;
+    vector<string> mAppNames;
+    int mAppId = -1;
+
+    // profiling target
+    string mPackageName = "";
+    string mSurfaceViewName = "";
+    string mSurfaceResolution = "";
+    int pid = 0;
+    atomic<bool> mIsProfiling{ false };
+
+    // what mSamplerThread samples, the UI thread keeps changing the fields above
+    struct SamplerTarget
+    {
+        string serial;
+        string packageName;
+        string surfaceViewName;
+        int pid = 0;
+        TemperatureStatSlot thermal;
+    };
+    mutable mutex mSamplerTargetMutex;
+    SamplerTarget mSamplerTarget; // copied by startProfiler()
+    SamplerTarget getSamplerTarget() const;
+    // a chart is read without inserting it, storage is shared with the UI thread
+    bool isChartVisible(const string& name) const;
+
+    // recorded series, timestamps in ms
+    // frames are in device CLOCK_MONOTONIC, the other series in CLOCK_REALTIME until mClockSync maps them
+    uint64_t firstFrameTimestamp = 0;
+    uint64_t firstCpuStatTimestamp = 0; // time axis of the samples while there are no frames to sync with
+    ClockSync mClockSync;
+    SeriesStore mSeries;
+    // the series every session has, registered in the constructor
+    Series& mTimestamps; // frame ready times, no fields
+    Series& mFrameTimes; // ms since the previous frame
+    Series& mFpsArray; // fps, % of the refresh rate
+    Series& mRefreshRate; // Hz of the display, on every change and once a second otherwise
+    Series& mCpuUsage; // all cores, %
+    Series& mAppCpuUsage; // %, 100 per busy core
+    Series& mMemoryStats; // MemoryField, MB
+    Series& mTemperatureStats; // cpu, gpu, battery
+    Series& mFramePhases; // GfxPhase, gfxinfo framestats only
+    Series& mFramePhaseStack; // the top of every phase stacked on the ones before it
+    Series& mJanks; // frame times of the jank frames, big janks included
+    Series& mBigJanks;
+    // "core_usage.N" and "core_freq.N" (MHz, % of the max) per cpu id, registered once mCpuConfigs is known
+    vector<Series*> mCoreUsage, mCoreFreq;
+    int mLastMeminfoIdx = -1; // last full dumpsys meminfo sample in mMemoryStats
+    GfxFrameStatsParser mGfxParser;
+    // the previous counters, the series keep the usage between two samples
+    CpuStat mLastCpuStat;
+    vector<CpuStat> mLastCoreStats;
+    AppCpuStat mLastAppCpuStat;
+    CpuStat mCpuStatAtLastApp; // mLastCpuStat when mLastAppCpuStat was read
+    vector<LabelPair> mLabelPairs;
+    JankDetector mJankDetector;
+    JankStats mJankStats;
+    vector<MissingSpan> mMissingSpans;
+    int mMissingFrames = 0;
+    uint64_t mLastSnapshotTs = 0;
+    uint64_t mLastSnapshotIdx = 0;
+
+    MetricSummary mFpsSummary, mMemorySummary, mAppCpuSummary, mCpuTempSummary, mFrameTimeSummary;
+    MetricSummary mRefreshRateSummary, mFpsOfRefreshSummary; // Hz, fps in % of the refresh rate
+    MetricSummary mFramePhaseSummary, mUiThreadSummary, mRenderThreadSummary;
+
+    // sampler
+    SpscQueue<AdbResults> mAdbResults{ 64 }; // mSamplerThread -> UI thread
+    unique_ptr<thread> mSamplerThread;
+    atomic<bool> mIsRunning{ true };
+    double mLastSampleTime = 0; // agent mode only
+    atomic<float> mFramePollSeconds{ 0 }; // period of the frame probe, 0 = REFRESH_SECONDS
+    SampleScheduler mScheduler; // only touched by mSamplerThread
+    unique_ptr<AdbShell> mAdbShell; // only touched by mSamplerThread
+    vector<SampleProbe> mInstalledProbes; // probe functions defined in mAdbShell
+    unique_ptr<AgentReceiver> mAgentReceiver; // only touched by mSamplerThread
+    int mAgentLocalPort = 0; // host side of the forward, unique per session
+
+    unique_ptr<Process> mIdbProcess;
+
+    // record / replay
+    map<string, string> mAdbResponses; // last output per command, written at the start of a capture
+    shared_ptr<CaptureWriter> mCapture; // swapped with atomic_store, the sampler writes to it
+    bool mIsReplay = false;
+    map<string, deque<string>> mReplayResponses; // outputs per command in capture order
+    vector<CaptureRecord> mReplaySamples;
+    size_t mReplayPos = 0; // only touched by mSamplerThread
+    double mReplayStartTime = 0;
+
+    // parse cost, text -> AdbResults on mSamplerThread and AdbResults -> series on the UI thread
+    atomic<uint64_t> mParseUs{ 0 }, mParseCount{ 0 };
+    double mIngestUs = 0;
+    int mIngestCount = 0;
+
+    // Loads a capture written with RECORD_CAPTURE, the session then replays it instead of talking to a device
+    bool loadReplay(const vector<CaptureRecord>& records);
+    bool startCapture();
+    void replaySample();
+    // Parses and ingests the recorded samples rounds times into a scratch session and logs the cost per sample
+    void benchmarkReplay(int rounds);
+
+    vector<string> executeAdb(const string& cmd);
+    vector<string> executeIdb(const string& cmd, bool async = false);
+
+    bool refreshDeviceDetails();
+    bool refreshDeviceDetails_ios();
+    // Groups mCpuConfigs by part and max frequency
+    void updateCpuClusters();
+
+    bool startProfiler(const string& pacakgeName);
+    bool startProfiler_ios(const string& pacakgeName);
+    bool stopProfiler();
+    void resetPerfData();
+
+    // Drains the results of the sampler, called by the UI thread
+    bool update();
+    bool updateProfiler(const AdbResults& results);
+    bool updateProfiler_agent(const AgentSamples& samples);
+
+    // ts is the frame ready time in ms, returns false for a frame seen already
+    // afterGap starts the frame time and fps series over instead of bridging missing frames
+    bool addFrame(uint64_t ts, bool afterGap = false);
+    // full: a dumpsys meminfo sample, fast: a smaps_rollup / statm sample, either may be null
+    void addMemoryStat(uint64_t ts, const MemoryStat* full, const MemoryStat* fast);
+    // Adds the frames of one SurfaceFlinger / gfxinfo read, records a MissingSpan when it doesn't overlap the last one
+    void addFrameWindow(vector<uint64_t> frames);
+
+    bool hasData() const { return !mTimestamps.empty() || firstCpuStatTimestamp != 0; }
+    // Seconds on the shared time axis of a timestamp of a series, and back
+    float getSeriesSeconds(const Series& series, uint64_t ts) const;
+    uint64_t getSeriesTime(const Series& series, float seconds) const;
+    MemoryStat getMemoryStat(size_t idx) const;
+    void setMemoryStat(size_t idx, const MemoryStat& stat);
+    void addCpuStat(uint64_t ts, const CpuStat& stat);
+    void addAppCpuStat(uint64_t ts, const AppCpuStat& stat);
+    void addCoreFreq(uint64_t ts, int cpu_id, int freqKHz);
+    void addFramePhases(uint64_t ts, const GfxFramePhases& phases);
+    // Seconds on the shared time axis of a cpu / memory / thermal sample
+    float getSampleSeconds(uint64_t ts) const;
+    // Seconds covered by the recorded series
+    float getDuration() const;
+
+    int getPid(const string& pacakgeName);
+    vector<SampleProbe> getSampleProbes(const SamplerTarget& target);
+    bool startAgent(const SamplerTarget& target);
+    void sample();
+
+    bool exportCsv();
+};
+
+// What the MemReport window shows, rows are rebuilt once dirty
+struct MemReportView
+{
+    bool visible = false;
+    int report = -1; // in PerfDoctorApp::mMemReports
+    int baseline = -1; // the report diffed against, -1 for none
+    string table;
+    string filter;
+    vector<MemReportDelta> rows;
+    vector<int> shown; // rows matching the filter in the order of the sort specs
+    bool dirty = true;
+};
+
+// A time range of the charts, picked by shift + dragging over a chart or by clicking a label.
+// The rows summarize every series of the visible charts in it, rebuilt once dirty.
+struct SelectionView
+{
+    struct Row
+    {
+        string name; // [device/]series[.field]
+        MetricSummary summary;
+    };
+
+    bool visible = false;
+    double start = 0, end = 0; // seconds of the plots, end < start while dragging to the left
+    bool dragging = false;
+    vector<Row> rows;
+    bool dirty = true;
+    double updatedAt = 0; // getElapsedSeconds(), live sessions keep adding samples to the range
+};
+
 struct PerfDoctorApp : public App
 {
     DataStorage storage;
     ImPlotContext* implotCtx = nullptr;
 
-    ConcurrentCircularBuffer<AdbResults> mAdbResults{ 2 };
     ConcurrentCircularBuffer<string> mAsyncCommands{ 2 };
-    unique_ptr<thread> mAdbThread;
+    unique_ptr<thread> mAdbThread; // runs mAsyncCommands
     bool mIsRunning = true;
     bool mAutoStart = false;
 
-    FILE* fp_idb;
     vector<string> executeIdb(string cmd, bool async = false, bool oneDeviceOnly = true);
 
     vector<string> executeAdb(string cmd, bool oneDeviceOnly = true);
     void executeUnrealCmd(const string& cmd);
 
-    int mAppId = -1;
     vector<string> mSerialNames;
     vector<string> mDeviceNames;
     vector<bool> mIsIOSDevices;
-    vector<string> mAppNames;
-    string mSurfaceViewName = "";
-    string mSurfaceResolution = "";
-    string mPackageName = "";
-    bool mIsProfiling = false;
-    float mLastUpdateTime = 0;
-    vector<pair<uint64_t, uint64_t>> mFrameTimes;
-    vector<uint64_t> mTimestamps; //ms
-    vector<pair<uint64_t, float>> mFpsArray;
-    vector<pair<uint64_t, AppCpuStat>> mAppCpuStats;
-    vector<pair<uint64_t, CpuStat>> mChildCpuStats[8];
-    vector<pair<uint64_t, MemoryStat>> mMemoryStats;
-    vector<LabelPair> mLabelPairs;
 
-    TemperatureStatSlot mTemparatureStatSlot;
-    vector<pair<uint64_t, TemperatureStat>> mTemperatureStats;
+    // one per entry of mSerialNames, DEVICE_ID picks the one the device tab works on
+    vector<unique_ptr<DeviceSession>> mSessions;
+    DeviceSession* getSession();
 
     vector<string> mUnrealCmds;
 
-    vector<TickFunction> mTickFunctions;
-    
-    uint64_t mLastSnapshotTs = 0;
-    uint64_t mLastSnapshotIdx = 0;
-    DeviceStat mDeviceStat;
-
-    struct MetricSummary
-    {
-        float Min, Max, Avg;
-        void reset()
-        {
-            Min = 0;
-            Max = 0;
-            Avg = 0;
-        }
+    vector<MemReport> mMemReports; // in the order they were taken
+    MemReportView mMemReportView;
+    SelectionView mSelectionView;
+    // Adds a memreport file to the MemReport window, diffed against the one taken before it
+    bool openMemReport(const string& path);
 
-        void update(float new_value, int count)
-        {
-            if (new_value > Max) Max = new_value;
-            if (new_value < Min) Min = new_value;
-            Avg = (Avg * count + new_value) / (count + 1);
-        }
-    };
+    future<void> mLogTask; // pulls and scans the UE log for getDumpTicks()
+    bool mIsScanningLog = false; // cleared on the UI thread once the task posts its result
 
-    MetricSummary mFpsSummary, mMemorySummary, mAppCpuSummary, mCpuTempSummary, mFrameTimeSummary;
     int mDeviceId = -1;
 
     bool refreshDeviceNames();
 
-    bool refreshDeviceDetails_ios();
-
     bool refreshDeviceDetails();
-    
-    bool startProfiler_ios(const string& pacakgeName);
 
     bool capturePerfetto();
 
@@ -296,27 +469,15 @@ struct PerfDoctorApp : public App
 
     void exportGpuTrace();
 
-    bool exportCsv();
-
     void trimMemory(const char* level);
 
     bool startProfiler(const string& pacakgeName);
 
-    void resetPerfData();
+    // Starts APP_NAME on every device that has it installed
+    void startProfilerOnAllDevices();
 
     bool stopProfiler();
 
-    struct TripleTimestamp
-    {
-        string started_to_draw;
-        string vsync;
-        string frame_submitted;
-    };
-
-    bool updateProfiler(const AdbResults& results);
-
-    int getPid(const string& pacakgeName);
-
     bool startApp_ios(const string& pacakgeName);
 
     bool startApp(const string& pacakgeName);
@@ -329,8 +490,17 @@ struct PerfDoctorApp : public App
 
     void drawLeftSidePanel();
     void drawDeviceTab();
+    void drawSessionList();
+    // Adds a replay session for a capture file
+    bool openCapture(const fs::path& path);
     void drawPerfPanel();
+    // Charts of the given sessions, overlaid when there are several
+    void drawSessionPlots(const vector<DeviceSession*>& sessions);
     void drawLabel();
+    // The selection in the plot being drawn, between BeginPlot and EndPlot
+    void drawSelection();
+    void drawSelectionWindow();
+    void drawMemReportWindow();
 
     void getUnrealLog(bool openLogFile = false);
     void getMemReport();
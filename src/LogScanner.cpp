@@ -0,0 +1,123 @@
+#include "LogScanner.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    mFile = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+        return false;
+    }
+    if (size.QuadPart == 0)
+        return true; // nothing to map, CreateFileMapping fails on empty files
+
+    mMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mMapping)
+    {
+        close();
+        return false;
+    }
+    mData = (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mData)
+    {
+        close();
+        return false;
+    }
+    mSize = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData) UnmapViewOfFile(mData);
+    if (mMapping) CloseHandle(mMapping);
+    if (mFile) CloseHandle(mFile);
+    mData = nullptr;
+    mSize = 0;
+    mMapping = nullptr;
+    mFile = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0)
+    {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = data != MAP_FAILED;
+        if (ok)
+        {
+            mData = (const char*)data;
+            mSize = st.st_size;
+        }
+    }
+    // the mapping keeps the file alive
+    ::close(fd);
+    return ok;
+}
+
+void MappedFile::close()
+{
+    if (mData) munmap((void*)mData, mSize);
+    mData = nullptr;
+    mSize = 0;
+}
+
+#endif
+
+size_t LogScanner::findLastLine(string_view needle, size_t end) const
+{
+    auto text = getText();
+    if (end != npos && end < text.size())
+        text = text.substr(0, end);
+
+    auto pos = text.rfind(needle);
+    if (pos == npos)
+        return npos;
+    auto lineBreak = text.rfind('\n', pos);
+    return lineBreak == npos ? 0 : lineBreak + 1;
+}
+
+size_t LogScanner::nextLine(size_t offset) const
+{
+    auto text = getText();
+    auto end = text.find('\n', offset);
+    if (end == npos || end + 1 >= text.size())
+        return npos;
+    return end + 1;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A whole file mapped read-only, pages are only read as the text is touched.
+// Windows: CreateFileMapping, elsewhere mmap.
+struct MappedFile
+{
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // Empty for an empty file or after a failed open
+    std::string_view getText() const { return { mData, mSize }; }
+
+private:
+    const char* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#endif
+};
+
+// Line oriented search over a mapped log, nothing is copied. Lines are returned without the line break.
+struct LogScanner
+{
+    static const size_t npos = std::string_view::npos;
+
+    bool open(const std::string& path) { return mFile.open(path); }
+    std::string_view getText() const { return mFile.getText(); }
+
+    // Start of the last line before end that contains needle, npos if there is none.
+    // Scans backwards, so the latest block of a long log is found without reading what comes before it.
+    size_t findLastLine(std::string_view needle, size_t end = npos) const;
+
+    // Start of the line after the one at offset, npos at the end of the text
+    size_t nextLine(size_t offset) const;
+
+    // Calls onLine(line) for the lines from offset on until it returns false,
+    // returns the start of the line it stopped at or npos at the end of the text
+    template <typename Fn>
+    size_t forEachLine(size_t offset, Fn onLine) const
+    {
+        auto text = getText();
+        while (offset < text.size())
+        {
+            auto end = text.find('\n', offset);
+            auto line = text.substr(offset, end == npos ? npos : end - offset);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            if (!onLine(line))
+                return offset;
+            if (end == npos)
+                break;
+            offset = end + 1;
+        }
+        return npos;
+    }
+
+private:
+    MappedFile mFile;
+};
@@ -0,0 +1,369 @@
+#include "MemReport.h"
+#include "LogScanner.h"
+#include "TextParse.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace
+{
+    const string_view kBeginCommand = "MemReport: Begin command \"";
+    const string_view kEndCommand = "MemReport: End command";
+    const size_t kMaxTokens = 64;
+
+    string_view trimView(string_view text)
+    {
+        auto start = text.find_first_not_of(" \t");
+        if (start == string_view::npos) return {};
+        auto end = text.find_last_not_of(" \t");
+        return text.substr(start, end - start + 1);
+    }
+
+    bool startsWith(string_view text, string_view prefix)
+    {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    bool isNumber(string_view token)
+    {
+        float value;
+        return parseNumber(token, value);
+    }
+
+    // "2048x2048 (5461 KB" -> 5461
+    float parseKB(string_view field)
+    {
+        auto open = field.find('(');
+        float kb = 0;
+        if (open != string_view::npos)
+            parseNumber(trimView(field.substr(open + 1)), kb);
+        return kb;
+    }
+
+    enum TableKind
+    {
+        Table_None,
+        Table_Columns,  // obj list, "Class Count NumKB ..." with a row per class or object
+        Table_Textures, // ListTextures, comma separated
+        Table_Rhi,      // rhi.DumpMemory, "12.345 MB - Texture 2D Memory - STAT_TextureMemory2D"
+        Table_Pool,     // r.DumpRenderTargetPoolMemory, "8.000MB 1920x1080 1mip(s) SceneColor ..."
+    };
+
+    struct ReportParser
+    {
+        MemReport& report;
+        string command = "report"; // text before the first section
+        TableKind kind = Table_None;
+
+        // Table_Columns
+        size_t numericColumns = 0;
+        size_t numKBColumn = 0, resExcKBColumn = 0; // numericColumns if missing
+
+        // Table_Textures
+        size_t textureFields = 0;
+        int nameField = -1, formatField = -1, groupField = -1, inMemField = -1;
+
+        explicit ReportParser(MemReport& report) : report(report) {}
+
+        MemReportTable& startTable(TableKind newKind, vector<string> columns, int sizeColumn)
+        {
+            kind = newKind;
+            MemReportTable table;
+            table.name = command;
+            int count = 1;
+            while (report.findTable(table.name))
+                table.name = command + " (" + to_string(++count) + ")";
+            table.columns = move(columns);
+            table.sizeColumn = sizeColumn;
+            report.tables.push_back(move(table));
+            return report.tables.back();
+        }
+
+        void addLine(string_view line)
+        {
+            if (startsWith(line, kBeginCommand))
+            {
+                auto cmd = line.substr(kBeginCommand.size());
+                command = string(cmd.substr(0, cmd.find('"')));
+                kind = Table_None;
+                return;
+            }
+            if (startsWith(line, kEndCommand))
+            {
+                kind = Table_None;
+                return;
+            }
+
+            switch (kind)
+            {
+            case Table_Columns: if (addColumnsRow(line)) return; break;
+            case Table_Textures: if (addTextureRow(line)) return; break;
+            case Table_Rhi: if (addRhiRow(line)) return; break;
+            case Table_Pool: if (addPoolRow(line)) return; break;
+            default: break;
+            }
+            kind = Table_None; // the table ended, maybe another one starts
+            findHeader(line);
+        }
+
+        void findHeader(string_view line)
+        {
+            string_view tokens[kMaxTokens];
+            auto count = splitTokens(line, " \t", tokens, kMaxTokens);
+            if (count == 0) return;
+
+            if (count >= 2 && (tokens[0] == "Class" || tokens[0] == "Object")
+                && none_of(tokens + 1, tokens + count, isNumber))
+            {
+                vector<string> columns(tokens + 1, tokens + count);
+                numericColumns = columns.size();
+                numKBColumn = find(columns.begin(), columns.end(), "NumKB") - columns.begin();
+                resExcKBColumn = find(columns.begin(), columns.end(), "ResExcKB") - columns.begin();
+                int sizeColumn = 0;
+                if (numKBColumn < numericColumns && resExcKBColumn < numericColumns)
+                {
+                    // objects and the resources they own exclusively, textures are all in ResExcKB
+                    columns.push_back("TotalKB");
+                    sizeColumn = int(columns.size() - 1);
+                }
+                else if (numKBColumn < numericColumns)
+                {
+                    sizeColumn = int(numKBColumn);
+                }
+                startTable(Table_Columns, move(columns), sizeColumn);
+                return;
+            }
+
+            auto trimmed = trimView(line);
+            if (startsWith(trimmed, "Cooked/OnDisk:") || startsWith(trimmed, "MaxAllowedSize:"))
+            {
+                // the header has the same commas as the rows, "(Size in KB, Authored Bias)" included
+                string_view fields[kMaxTokens];
+                textureFields = splitFields(trimmed, ',', fields, kMaxTokens);
+                nameField = formatField = groupField = inMemField = -1;
+                for (int i = 0; i < int(textureFields); i++)
+                {
+                    auto field = trimView(fields[i]);
+                    if (field == "Name") nameField = i;
+                    else if (field == "Format") formatField = i;
+                    else if (field == "LODGroup") groupField = i;
+                    else if (startsWith(field, "Current/InMem")) inMemField = i;
+                }
+                if (nameField >= 0 && inMemField >= 0)
+                    startTable(Table_Textures, { "InMemKB", "OnDiskKB" }, 0);
+                return;
+            }
+
+            // these two have no header, a row starts the table
+            if (startsWith(command, "rhi.") && addRhiRow(line))
+                return;
+            if (command.find("RenderTargetPool") != string::npos && addPoolRow(line))
+                return;
+        }
+
+        bool addColumnsRow(string_view line)
+        {
+            string_view tokens[kMaxTokens];
+            auto count = splitTokens(line, " \t", tokens, kMaxTokens);
+            if (count < numericColumns + 1)
+                return false;
+
+            MemReportRow row;
+            auto first = count - numericColumns;
+            for (size_t i = first; i < count; i++)
+            {
+                float value = 0;
+                if (!parseNumber(tokens[i], value))
+                    return false; // "130853 Objects (Total: ...)"
+                row.values.push_back(value);
+            }
+            if (row.values.size() < report.tables.back().columns.size())
+                row.values.push_back(row.values[numKBColumn] + row.values[resExcKBColumn]);
+
+            // object names can have spaces, "SkeletalMesh /Game/Hero.Hero"
+            auto lastName = tokens[first - 1];
+            row.name = string(tokens[0].data(), lastName.data() + lastName.size() - tokens[0].data());
+            report.tables.back().rows.push_back(move(row));
+            return true;
+        }
+
+        bool addTextureRow(string_view line)
+        {
+            string_view fields[kMaxTokens];
+            if (splitFields(trimView(line), ',', fields, kMaxTokens) < textureFields)
+                return false; // "Total size: InMem= ..."
+
+            MemReportRow row;
+            row.name = string(trimView(fields[nameField]));
+            if (formatField >= 0) row.detail = string(trimView(fields[formatField]));
+            if (groupField >= 0) row.detail += " " + string(trimView(fields[groupField]));
+            row.values = { parseKB(fields[inMemField]), parseKB(fields[0]) };
+            report.tables.back().rows.push_back(move(row));
+            return true;
+        }
+
+        bool addRhiRow(string_view line)
+        {
+            string_view tokens[3];
+            if (splitTokens(line, " \t", tokens, 3) < 3 || tokens[1] != "MB")
+                return false;
+            float mb = 0;
+            if (!parseNumber(tokens[0], mb))
+                return false;
+            auto dash = line.find(" - ");
+            if (dash == string_view::npos)
+                return false;
+
+            // "Texture 2D Memory - STAT_TextureMemory2D" keeps the readable part
+            auto name = line.substr(dash + 3);
+            auto statName = name.find(" - ");
+            if (statName != string_view::npos)
+                name = name.substr(0, statName);
+
+            if (kind != Table_Rhi)
+                startTable(Table_Rhi, { "MB" }, 0);
+            MemReportRow row;
+            row.name = string(trimView(name));
+            row.values = { mb };
+            report.tables.back().rows.push_back(move(row));
+            return true;
+        }
+
+        bool addPoolRow(string_view line)
+        {
+            string_view tokens[kMaxTokens];
+            auto count = splitTokens(line, " \t", tokens, kMaxTokens);
+            if (count < 2 || tokens[1] == "total" || tokens[0].size() < 3 || tokens[0].substr(tokens[0].size() - 2) != "MB")
+                return false;
+            float mb = 0;
+            if (!parseNumber(tokens[0], mb))
+                return false;
+
+            // the debug name follows the mip count, older versions print it last
+            string_view name = tokens[count - 1];
+            for (size_t i = 1; i + 1 < count; i++)
+            {
+                if (tokens[i].find("mip(s)") != string_view::npos)
+                {
+                    name = tokens[i + 1];
+                    break;
+                }
+            }
+
+            if (kind != Table_Pool)
+                startTable(Table_Pool, { "MB" }, 0);
+            MemReportRow row;
+            row.name = string(name);
+            row.detail = string(tokens[1]);
+            row.values = { mb };
+            report.tables.back().rows.push_back(move(row));
+            return true;
+        }
+    };
+}
+
+float MemReportTable::getTotal(int column) const
+{
+    float total = 0;
+    for (const auto& row : rows)
+        total += row.values[column];
+    return total;
+}
+
+const MemReportTable* MemReport::findTable(const string& name) const
+{
+    for (const auto& table : tables)
+    {
+        if (table.name == name)
+            return &table;
+    }
+    return nullptr;
+}
+
+bool parseMemReport(string_view text, MemReport& report)
+{
+    report.tables.clear();
+    ReportParser parser(report);
+
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        auto end = text.find('\n', pos);
+        auto line = text.substr(pos, end == string_view::npos ? string_view::npos : end - pos);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        parser.addLine(line);
+        if (end == string_view::npos)
+            break;
+        pos = end + 1;
+    }
+
+    return !report.tables.empty();
+}
+
+bool loadMemReport(const string& path, MemReport& report)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    report.path = path;
+    report.name = path.substr(path.find_last_of("/\\") + 1);
+
+    auto text = file.getText();
+    if (text.size() >= 2 && text[0] == '\xFF' && text[1] == '\xFE')
+    {
+        // UTF-16LE, the tables are plain ASCII
+        string narrow;
+        narrow.reserve(text.size() / 2);
+        for (size_t i = 2; i + 1 < text.size(); i += 2)
+            narrow += text[i + 1] == 0 ? text[i] : '?';
+        return parseMemReport(narrow, report);
+    }
+    if (startsWith(text, "\xEF\xBB\xBF"))
+        text.remove_prefix(3);
+    return parseMemReport(text, report);
+}
+
+vector<MemReportDelta> diffMemReportTables(const MemReportTable* before, const MemReportTable& after)
+{
+    vector<MemReportDelta> deltas;
+    deltas.reserve(after.rows.size());
+
+    unordered_map<string_view, const MemReportRow*> beforeRows;
+    if (before && before->columns == after.columns)
+    {
+        for (const auto& row : before->rows)
+            beforeRows[row.name] = &row;
+    }
+
+    for (const auto& row : after.rows)
+    {
+        MemReportDelta delta = { row.name, row.detail, row.values, row.values };
+        auto it = beforeRows.find(row.name);
+        if (it != beforeRows.end())
+        {
+            for (size_t i = 0; i < row.values.size(); i++)
+                delta.deltas[i] -= it->second->values[i];
+            beforeRows.erase(it);
+        }
+        deltas.push_back(move(delta));
+    }
+    for (const auto& kv : beforeRows)
+    {
+        // gone since the older report
+        const auto& row = *kv.second;
+        MemReportDelta delta = { row.name, row.detail, vector<float>(row.values.size()), row.values };
+        for (auto& value : delta.deltas)
+            value = -value;
+        deltas.push_back(move(delta));
+    }
+
+    int column = after.sizeColumn;
+    sort(deltas.begin(), deltas.end(), [column](const MemReportDelta& a, const MemReportDelta& b) {
+        return a.deltas[column] > b.deltas[column];
+    });
+    return deltas;
+}
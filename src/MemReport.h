@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The tables of an Unreal `memreport -full` file. Every command of the report is a section, the ones
+// with a table we know become a MemReportTable named after the command:
+// obj list (per class or per object), rhi.DumpMemory, ListTextures and r.DumpRenderTargetPoolMemory.
+
+struct MemReportRow
+{
+    std::string name; // class, object, texture, resource
+    std::string detail; // format and LOD group of textures
+    std::vector<float> values; // one per MemReportTable::columns
+};
+
+struct MemReportTable
+{
+    std::string name; // the command, e.g. "obj list -alphasort"
+    std::vector<std::string> columns;
+    int sizeColumn = 0; // the memory column, totals and diffs rank by it
+    std::vector<MemReportRow> rows;
+
+    float getTotal(int column) const;
+};
+
+struct MemReport
+{
+    std::string name; // file name
+    std::string path;
+    std::vector<MemReportTable> tables;
+
+    const MemReportTable* findTable(const std::string& name) const;
+};
+
+bool parseMemReport(std::string_view text, MemReport& report);
+bool loadMemReport(const std::string& path, MemReport& report);
+
+// A row of the newer report with what changed since the older one
+struct MemReportDelta
+{
+    std::string name;
+    std::string detail;
+    std::vector<float> values;
+    std::vector<float> deltas;
+};
+
+// Matches the rows by name, rows gone from after show up with values of 0.
+// before may be null, the deltas are the values then. Biggest growth of the size column first.
+std::vector<MemReportDelta> diffMemReportTables(const MemReportTable* before, const MemReportTable& after);
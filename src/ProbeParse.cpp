@@ -0,0 +1,202 @@
+#include "ProbeParse.h"
+#include "TextParse.h"
+
+#include <cctype>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+CpuStat::CpuStat(string_view line)
+{
+    // cpu0 1303 66 1406 73744 56 0 27 0 0 0
+    Tokenizer tokenizer(line);
+    string_view token;
+    if (!tokenizer.next(token)) return;
+    if (token.size() > 3)
+        parseNumber(token.substr(3), cpu_id);
+
+    long int* fields[] = { &user, &nice, &sys, &idle, &iowait, &irq, &softirq };
+    for (auto field : fields)
+    {
+        if (!tokenizer.next(token) || !parseNumber(token, *field)) break;
+    }
+}
+
+AppCpuStat::AppCpuStat(string_view line)
+{
+    // pid (comm) state ppid ..., comm may have spaces so count from the closing bracket
+    auto bracket = line.rfind(')');
+    if (bracket == string_view::npos) return;
+
+    // utime is field 14 of proc(5), the state after the bracket is field 3
+    Tokenizer tokenizer(line.substr(bracket + 1));
+    string_view token;
+    if (!tokenizer.skip(14 - 3)) return;
+
+    long int* fields[] = { &utime, &stime, &cutime, &cstime };
+    for (auto field : fields)
+    {
+        if (!tokenizer.next(token) || !parseNumber(token, *field)) break;
+    }
+}
+
+float calcCpuUsage(const CpuStat& lhs, const CpuStat& rhs)
+{
+    auto totalTime = rhs.getAll() - lhs.getAll();
+    auto idleTime = rhs.getIdle() - lhs.getIdle();
+    auto usage = (totalTime - idleTime) * 100.0f / totalTime;
+    return usage;
+}
+
+float calcAppCpuUsage(const CpuStat& lhs, const CpuStat& rhs, const AppCpuStat& appLhs, const AppCpuStat& appRhs, int cpuCount)
+{
+    auto totalTime = rhs.getAll() - lhs.getAll();
+    auto appActiveTime = appRhs.getActiveTime() - appLhs.getActiveTime();
+    auto usage = appActiveTime * cpuCount * 100.0f / totalTime;
+    return usage;
+}
+
+// "/sys/devices/system/cpu/cpu10/cpufreq/scaling_cur_freq:1800000" as `grep -H .` prints it,
+// the cpu* glob sorts cpu10 before cpu2 so the order of the lines can't tell the core
+bool parseCpuFileLine(string_view line, int& cpu_id, int& value)
+{
+    const string_view kCpuDir = "/cpu/cpu";
+    auto dir = line.find(kCpuDir);
+    auto colon = line.rfind(':');
+    if (dir == string_view::npos || colon == string_view::npos)
+        return false;
+    return parseNumber(line.substr(dir + kCpuDir.size()), cpu_id) && parseNumber(line.substr(colon + 1), value);
+}
+
+// the active refresh rate in the "cur: 90" of `dumpsys SurfaceFlinger | grep cur:`
+bool parseDisplayFps(string_view line, float& fps)
+{
+    const string_view kCur = "cur:";
+    auto cur = line.find(kCur);
+    if (cur == string_view::npos)
+        return false;
+    auto value = line.substr(cur + kCur.size());
+    auto first = value.find_first_not_of(' ');
+    return first != string_view::npos && parseNumber(value.substr(first), fps) && fps > 0;
+}
+
+uint64_t parseLatency(const vector<string>& lines, vector<uint64_t>& frames)
+{
+    uint64_t refreshPeriod = 0;
+    if (lines.empty() || !parseNumber(lines[0], refreshPeriod))
+        refreshPeriod = 0;
+    for (size_t i = 1; i < lines.size(); i++)
+    {
+        Tokenizer tokenizer(lines[i], "\t");
+        string_view started, vsync, submitted;
+        uint64_t startedNs = 0, vsyncNs = 0, submittedNs = 0;
+        if (!tokenizer.next(started) || !tokenizer.next(vsync) || !tokenizer.next(submitted)
+            || !parseNumber(started, startedNs)
+            || !parseNumber(vsync, vsyncNs)
+            || !parseNumber(submitted, submittedNs))
+            continue; // it happens sometimes
+        if (startedNs == 0) continue; // an empty slot of the ring
+        // If a fence associated with a frame is still pending when we query the
+        // latency data, SurfaceFlinger gives the frame a timestamp of INT64_MAX.
+        // Since we only care about completed frames, we will ignore any timestamps
+        // with this value.
+        if (submittedNs == INT64_MAX) continue;
+        frames.push_back(submittedNs / 1000000); // ns -> ms
+    }
+    return refreshPeriod;
+}
+
+namespace
+{
+    // "  Native Heap    10856    10796  ..." -> "Native Heap" and the first numbers after it
+    int splitMeminfoRow(string_view line, string_view& label, float* values, int maxValues)
+    {
+        label = {};
+        int count = 0;
+        Tokenizer tokenizer(line);
+        string_view token;
+        while (count < maxValues && tokenizer.next(token))
+        {
+            if (isdigit(token[0]))
+            {
+                parseNumber(token, values[count++]);
+            }
+            else if (count == 0)
+            {
+                // the label spans from its first word to the end of its last one
+                auto start = label.empty() ? token.data() : label.data();
+                label = string_view(start, token.data() + token.size() - start);
+            }
+        }
+        return count;
+    }
+}
+
+bool parseMeminfo(const vector<string>& lines, MemoryStat& stat)
+{
+    // rows of the "App Memory" table, columns are Pss Total, Private Dirty, Private Clean, ...
+    static const pair<string_view, float MemoryStat::*> kRows[] = {
+        { "Native Heap", &MemoryStat::pssNativeHeap },
+        { "EGL mtrack", &MemoryStat::pssEGL },
+        { "Gfx dev", &MemoryStat::pssGfx },
+        { "GL mtrack", &MemoryStat::pssGL },
+        { "Unknown", &MemoryStat::pssUnknown },
+    };
+
+    string_view label;
+    float values[3];
+    for (const auto& line : lines)
+    {
+        int count = splitMeminfoRow(line, label, values, 3);
+        if (count == 0) continue;
+
+        if (label == "TOTAL")
+        {
+            if (count < 3) return false;
+            stat.pssTotal = values[0] / 1024; // KB -> MB
+            stat.privateDirty = values[1] / 1024;
+            stat.privateClean = values[2] / 1024;
+            return true; // the summary below repeats the same numbers
+        }
+
+        for (const auto& row : kRows)
+        {
+            if (label == row.first)
+            {
+                stat.*(row.second) = values[0] / 1024;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+bool parseFastMemory(const vector<string>& lines, MemoryStat& stat)
+{
+    if (lines.empty()) return false;
+
+    // smaps_rollup: "Pss:    123 kB" per line, the app must be debuggable to read it from the shell
+    bool found = false;
+    for (const auto& line : lines)
+    {
+        Tokenizer tokenizer(line);
+        string_view key, value;
+        float kb = 0;
+        if (!tokenizer.next(key) || key.back() != ':' || !tokenizer.next(value) || !parseNumber(value, kb))
+            continue;
+
+        float mb = kb / 1024; // KB -> MB
+        if (key == "Pss:") stat.pssFast = mb, found = true;
+        else if (key == "Private_Clean:") stat.privateClean = mb;
+        else if (key == "Private_Dirty:") stat.privateDirty = mb;
+    }
+    if (found) return true;
+
+    // statm: "size resident shared text lib data dt" in 4 KB pages, world readable
+    long int pages = 0;
+    if (!parseToken(lines[0], 1, pages)) return false;
+    stat.pssFast = pages * 4 / 1024.0f;
+    stat.privateClean = stat.privateDirty = -1; // unknown
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parsers of what the probes print on the device, free of the app so they can be tested and timed alone.
+// The lines come split on \r\n with empty ones dropped, see splitAdbOutput().
+
+struct MemoryStat
+{
+    float pssTotal = 0;
+    float pssGL = 0;
+    float pssEGL = 0;
+    float pssGfx = 0;
+    float pssUnknown = 0;
+    float pssNativeHeap = 0;
+
+    float privateClean = 0;
+    float privateDirty = 0;
+
+    float pssFast = -1; // Pss of smaps_rollup or Rss of statm read with this sample, -1 if none
+};
+
+// Fills the breakdown from `dumpsys meminfo <pkg>`
+bool parseMeminfo(const std::vector<std::string>& lines, MemoryStat& stat);
+// Fills pssFast (and the private sizes if known) from /proc/<pid>/smaps_rollup or /proc/<pid>/statm
+bool parseFastMemory(const std::vector<std::string>& lines, MemoryStat& stat);
+
+struct CpuStat
+{
+    int cpu_id = -1;
+    long int user = 0, nice = 0, sys = 0, idle = 0, iowait = 0, irq = 0, softirq = 0;
+    int freq = -1;
+
+    CpuStat() = default;
+
+    // a "cpu" or "cpuN" line of /proc/stat, cpu_id is -1 for the total
+    CpuStat(std::string_view line);
+
+    long int getAll() const
+    {
+        return user + nice + sys + idle + iowait + irq + softirq;
+    }
+
+    long int getIdle() const
+    {
+        return idle;
+    }
+};
+
+float calcCpuUsage(const CpuStat& lhs, const CpuStat& rhs);
+
+struct AppCpuStat
+{
+    // https://www.chenwenguan.com/android-performance-monitor-cpu/
+    long int utime = 0, stime = 0;
+    long int cutime = 0, cstime = 0;
+
+    AppCpuStat() = default;
+    // the line of /proc/<pid>/stat
+    AppCpuStat(std::string_view line);
+
+    long int getActiveTime() const
+    {
+        return utime + stime + cutime + cstime;
+    }
+};
+
+float calcAppCpuUsage(const CpuStat& lhs, const CpuStat& rhs, const AppCpuStat& appLhs, const AppCpuStat& appRhs, int cpuCount);
+
+// "/sys/devices/system/cpu/cpu10/cpufreq/scaling_cur_freq:1800000" of `grep -H .`, false for other lines
+bool parseCpuFileLine(std::string_view line, int& cpu_id, int& value);
+// the active refresh rate in the "cur: 90" of `dumpsys SurfaceFlinger | grep cur:`
+bool parseDisplayFps(std::string_view line, float& fps);
+
+// `dumpsys SurfaceFlinger --latency <layer>`: the refresh period in ns on the first line, then the
+// desired present, actual present and frame ready time of up to 128 frames.
+// Appends the ready time in ms of every finished frame, returns the refresh period, 0 if missing.
+uint64_t parseLatency(const std::vector<std::string>& lines, std::vector<uint64_t>& frames);
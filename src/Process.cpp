@@ -0,0 +1,451 @@
+#include "Process.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+extern char** environ;
+#endif
+
+using namespace std;
+
+namespace
+{
+    const size_t kReadChunk = 64 * 1024;
+    const size_t kInitialCapacity = 64 * 1024;
+    const int kCancelCheckMs = 50;
+
+    // Grows dst geometrically and lets the OS write straight into it, no intermediate buffers
+    char* reserveTail(string& dst, size_t len)
+    {
+        size_t size = dst.size();
+        if (dst.capacity() < size + len)
+            dst.reserve(max(dst.capacity() * 2, size + len));
+        dst.resize(size + len);
+        return &dst[size];
+    }
+}
+
+Process::~Process()
+{
+    closePipes();
+    if (isStarted())
+    {
+        int exitCode;
+        if (!wait(0, exitCode))
+        {
+            kill();
+            wait(-1, exitCode);
+        }
+    }
+}
+
+#ifdef _WIN32
+
+bool Process::isStarted() const
+{
+    return mProcess != nullptr;
+}
+
+bool Process::start(const string& cmdLine, bool withStdin)
+{
+    HANDLE stdinRd = NULL, stdinWr = NULL, stdoutRd = NULL, stdoutWr = NULL, stderrRd = NULL, stderrWr = NULL;
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+    if (!CreatePipe(&stdoutRd, &stdoutWr, &sa, 0)) return false;
+    if (!CreatePipe(&stderrRd, &stderrWr, &sa, 0))
+    {
+        CloseHandle(stdoutRd);
+        CloseHandle(stdoutWr);
+        return false;
+    }
+    if (withStdin && !CreatePipe(&stdinRd, &stdinWr, &sa, 0))
+    {
+        CloseHandle(stdoutRd);
+        CloseHandle(stdoutWr);
+        CloseHandle(stderrRd);
+        CloseHandle(stderrWr);
+        return false;
+    }
+    // our ends must not be inherited, otherwise the child keeps its own pipes open
+    SetHandleInformation(stdoutRd, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(stderrRd, HANDLE_FLAG_INHERIT, 0);
+    if (stdinWr) SetHandleInformation(stdinWr, HANDLE_FLAG_INHERIT, 0);
+
+    PROCESS_INFORMATION piProcInfo;
+    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+    STARTUPINFOA siStartInfo;
+    ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
+    siStartInfo.cb = sizeof(STARTUPINFOA);
+    siStartInfo.hStdInput = stdinRd;
+    siStartInfo.hStdOutput = stdoutWr;
+    siStartInfo.hStdError = stderrWr;
+    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+    string cmd = cmdLine; // CreateProcessA may modify the buffer
+    BOOL success = CreateProcessA(NULL, &cmd[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &siStartInfo, &piProcInfo);
+
+    CloseHandle(stdoutWr);
+    CloseHandle(stderrWr);
+    if (stdinRd) CloseHandle(stdinRd);
+
+    if (!success)
+    {
+        CloseHandle(stdoutRd);
+        CloseHandle(stderrRd);
+        if (stdinWr) CloseHandle(stdinWr);
+        return false;
+    }
+    CloseHandle(piProcInfo.hThread);
+
+    mProcess = piProcInfo.hProcess;
+    mStdinWr = stdinWr;
+    mStdoutRd = stdoutRd;
+    mStderrRd = stderrRd;
+    mExitCode = -1;
+    return true;
+}
+
+bool Process::writeStdin(const string& data)
+{
+    if (!mStdinWr) return false;
+
+    DWORD offset = 0;
+    while (offset < data.size())
+    {
+        DWORD written = 0;
+        if (!WriteFile(mStdinWr, data.c_str() + offset, (DWORD)(data.size() - offset), &written, NULL))
+            return false;
+        offset += written;
+    }
+    return true;
+}
+
+void Process::closeStdin()
+{
+    if (mStdinWr)
+    {
+        CloseHandle(mStdinWr);
+        mStdinWr = nullptr;
+    }
+}
+
+void Process::closePipes()
+{
+    closeStdin();
+    if (mStdoutRd)
+    {
+        CloseHandle(mStdoutRd);
+        mStdoutRd = nullptr;
+    }
+    if (mStderrRd)
+    {
+        CloseHandle(mStderrRd);
+        mStderrRd = nullptr;
+    }
+}
+
+// Reads what is available without blocking, closes the pipe on EOF
+static int drainPipe(void*& pipe, string& dst)
+{
+    if (!pipe) return 0;
+
+    DWORD available = 0;
+    if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL))
+    {
+        CloseHandle(pipe); // broken pipe, every writer is gone
+        pipe = nullptr;
+        return 0;
+    }
+    if (available == 0)
+        return 0;
+
+    DWORD len = min<DWORD>(available, kReadChunk);
+    char* tail = reserveTail(dst, len);
+    DWORD dwRead = 0;
+    if (!ReadFile(pipe, tail, len, &dwRead, NULL))
+        dwRead = 0;
+    dst.resize(dst.size() - len + dwRead);
+    return (int)dwRead;
+}
+
+int Process::read(string& output, string* errors, int timeoutMs)
+{
+    // anonymous pipes don't support overlapped io, poll both of them for the available bytes instead
+    auto start = chrono::steady_clock::now();
+    while (mStdoutRd || mStderrRd)
+    {
+        int total = drainPipe(mStdoutRd, output);
+        total += drainPipe(mStderrRd, errors ? *errors : output);
+        if (total > 0)
+            return total;
+        if (chrono::steady_clock::now() - start >= chrono::milliseconds(timeoutMs))
+            return 0;
+        Sleep(1);
+    }
+    return -1;
+}
+
+bool Process::wait(int timeoutMs, int& exitCode)
+{
+    if (!mProcess)
+    {
+        exitCode = mExitCode;
+        return true;
+    }
+    if (WaitForSingleObject(mProcess, timeoutMs < 0 ? INFINITE : timeoutMs) != WAIT_OBJECT_0)
+        return false;
+
+    DWORD code = 0;
+    GetExitCodeProcess(mProcess, &code);
+    CloseHandle(mProcess);
+    mProcess = nullptr;
+    mExitCode = exitCode = (int)code;
+    return true;
+}
+
+void Process::kill()
+{
+    if (mProcess)
+        TerminateProcess(mProcess, 1);
+}
+
+#else
+
+bool Process::isStarted() const
+{
+    return mPid > 0;
+}
+
+bool Process::start(const string& cmdLine, bool withStdin)
+{
+    int stdinPipe[2] = { -1, -1 }, stdoutPipe[2] = { -1, -1 }, stderrPipe[2] = { -1, -1 };
+    auto closeAll = [&] {
+        for (auto fd : { stdinPipe[0], stdinPipe[1], stdoutPipe[0], stdoutPipe[1], stderrPipe[0], stderrPipe[1] })
+            if (fd != -1) close(fd);
+    };
+    if (pipe(stdoutPipe) != 0 || pipe(stderrPipe) != 0 || (withStdin && pipe(stdinPipe) != 0))
+    {
+        closeAll();
+        return false;
+    }
+    // our ends must not leak into this or any later child
+    for (auto fd : { stdoutPipe[0], stderrPipe[0], stdinPipe[1] })
+        if (fd != -1) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (withStdin)
+        posix_spawn_file_actions_adddup2(&actions, stdinPipe[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, stdoutPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stderrPipe[1], STDERR_FILENO);
+
+    vector<char*> argv = { (char*)"/bin/sh", (char*)"-c", (char*)cmdLine.c_str(), nullptr };
+    int ret = posix_spawn(&mPid, "/bin/sh", &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (ret != 0)
+    {
+        mPid = -1;
+        closeAll();
+        return false;
+    }
+
+    // a child that exits early must not kill us with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    close(stdoutPipe[1]);
+    close(stderrPipe[1]);
+    if (stdinPipe[0] != -1) close(stdinPipe[0]);
+
+    mStdinWr = stdinPipe[1];
+    mStdoutRd = stdoutPipe[0];
+    mStderrRd = stderrPipe[0];
+    mExitCode = -1;
+    return true;
+}
+
+bool Process::writeStdin(const string& data)
+{
+    if (mStdinWr == -1) return false;
+
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        auto written = write(mStdinWr, data.c_str() + offset, data.size() - offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        offset += written;
+    }
+    return true;
+}
+
+void Process::closeStdin()
+{
+    if (mStdinWr != -1)
+    {
+        close(mStdinWr);
+        mStdinWr = -1;
+    }
+}
+
+void Process::closePipes()
+{
+    closeStdin();
+    if (mStdoutRd != -1)
+    {
+        close(mStdoutRd);
+        mStdoutRd = -1;
+    }
+    if (mStderrRd != -1)
+    {
+        close(mStderrRd);
+        mStderrRd = -1;
+    }
+}
+
+int Process::read(string& output, string* errors, int timeoutMs)
+{
+    pollfd pfds[2];
+    string* dsts[2];
+    int* fds[2];
+    int count = 0;
+    if (mStdoutRd != -1)
+    {
+        pfds[count] = { mStdoutRd, POLLIN, 0 };
+        dsts[count] = &output;
+        fds[count++] = &mStdoutRd;
+    }
+    if (mStderrRd != -1)
+    {
+        pfds[count] = { mStderrRd, POLLIN, 0 };
+        dsts[count] = errors ? errors : &output;
+        fds[count++] = &mStderrRd;
+    }
+    if (count == 0)
+        return -1;
+
+    int ret = poll(pfds, count, timeoutMs);
+    if (ret < 0)
+        return errno == EINTR ? 0 : -1;
+    if (ret == 0)
+        return 0;
+
+    int total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (pfds[i].revents == 0)
+            continue;
+        auto& dst = *dsts[i];
+        char* tail = reserveTail(dst, kReadChunk);
+        auto n = ::read(pfds[i].fd, tail, kReadChunk);
+        dst.resize(dst.size() - kReadChunk + max<ssize_t>(n, 0));
+        if (n > 0)
+            total += (int)n;
+        else if (n == 0 || errno != EINTR)
+        {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+    if (total == 0 && mStdoutRd == -1 && mStderrRd == -1)
+        return -1;
+    return total;
+}
+
+bool Process::wait(int timeoutMs, int& exitCode)
+{
+    if (mPid <= 0)
+    {
+        exitCode = mExitCode;
+        return true;
+    }
+
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    int status = 0;
+    while (true)
+    {
+        auto ret = waitpid(mPid, &status, timeoutMs < 0 ? 0 : WNOHANG);
+        if (ret == mPid)
+            break;
+        if (ret < 0 && errno != EINTR)
+        {
+            mPid = -1;
+            exitCode = mExitCode = -1;
+            return true;
+        }
+        if (timeoutMs >= 0 && chrono::steady_clock::now() >= deadline)
+            return false;
+        if (ret == 0)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    mPid = -1;
+    mExitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    exitCode = mExitCode;
+    return true;
+}
+
+void Process::kill()
+{
+    if (mPid > 0)
+        ::kill(mPid, SIGKILL);
+}
+
+#endif
+
+ProcessResult runProcess(const string& cmdLine, int timeoutMs, const atomic<bool>* cancel)
+{
+    ProcessResult result;
+    Process process;
+    if (!process.start(cmdLine))
+        return result;
+
+    result.output.reserve(kInitialCapacity);
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        if (cancel && *cancel)
+        {
+            result.cancelled = true;
+            process.kill();
+            break;
+        }
+        if (timeoutMs >= 0 && chrono::steady_clock::now() >= deadline)
+        {
+            result.timedOut = true;
+            process.kill();
+            break;
+        }
+        int n = process.read(result.output, &result.errors, kCancelCheckMs);
+        if (n < 0)
+            break;
+        if (n == 0 && process.wait(0, result.exitCode))
+        {
+            // a grandchild such as a freshly started adb server may hold the pipes open forever,
+            // take what the child itself printed and stop at its exit
+            while (process.read(result.output, &result.errors, 0) > 0);
+            return result;
+        }
+    }
+    process.wait(-1, result.exitCode);
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// A child process with its stdout and stderr drained together, so a chatty stderr can't block the child.
+// Windows: CreateProcess with anonymous pipes, elsewhere posix_spawn of `/bin/sh -c` plus poll.
+struct Process
+{
+    Process() = default;
+    ~Process();
+
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+
+    // cmdLine is passed to CreateProcess as is, or to the shell elsewhere
+    bool start(const std::string& cmdLine, bool withStdin = false);
+    bool isStarted() const;
+
+    bool writeStdin(const std::string& data);
+    void closeStdin();
+
+    // Appends whatever is readable to output and errors, waits at most timeoutMs for the first bytes.
+    // errors may be null to merge stderr into output.
+    // Returns the number of bytes read, 0 on timeout and -1 once both pipes are closed.
+    int read(std::string& output, std::string* errors, int timeoutMs);
+
+    // Returns false if the child is still running after timeoutMs, exitCode is set otherwise
+    bool wait(int timeoutMs, int& exitCode);
+    void kill();
+
+private:
+    void closePipes();
+
+#ifdef _WIN32
+    void* mProcess = nullptr;
+    void* mStdinWr = nullptr;
+    void* mStdoutRd = nullptr;
+    void* mStderrRd = nullptr;
+#else
+    int mPid = -1;
+    int mStdinWr = -1;
+    int mStdoutRd = -1;
+    int mStderrRd = -1;
+#endif
+    int mExitCode = -1;
+};
+
+struct ProcessResult
+{
+    int exitCode = -1;
+    bool timedOut = false;
+    bool cancelled = false;
+    std::string output;
+    std::string errors;
+};
+
+// Runs cmdLine to completion, the child is killed once timeoutMs (-1 = no limit) passes or cancel becomes true
+ProcessResult runProcess(const std::string& cmdLine, int timeoutMs = -1, const std::atomic<bool>* cancel = nullptr);
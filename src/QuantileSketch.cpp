@@ -0,0 +1,137 @@
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace
+{
+    const size_t kBufferSize = QuantileSketch::kCompression * 5;
+    const double kPi = 3.14159265358979323846;
+
+    // the k1 scale function, a centroid spans at most 1 in k
+    double getScale(double q)
+    {
+        return QuantileSketch::kCompression / (2 * kPi) * asin(2 * min(max(q, 0.0), 1.0) - 1);
+    }
+}
+
+void QuantileSketch::add(float value, float weight)
+{
+    if (weight <= 0 || std::isnan(value))
+        return;
+    if (empty())
+    {
+        mMin = mMax = value;
+    }
+    else
+    {
+        mMin = min(mMin, value);
+        mMax = max(mMax, value);
+    }
+    mBuffer.push_back({ value, weight });
+    mBufferWeight += weight;
+    if (mBuffer.size() >= kBufferSize)
+        flush();
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    if (other.empty())
+        return;
+    other.flush();
+    if (empty())
+    {
+        mMin = other.mMin;
+        mMax = other.mMax;
+    }
+    else
+    {
+        mMin = min(mMin, other.mMin);
+        mMax = max(mMax, other.mMax);
+    }
+    mBuffer.insert(mBuffer.end(), other.mCentroids.begin(), other.mCentroids.end());
+    mBufferWeight += other.mTotalWeight;
+    flush();
+}
+
+void QuantileSketch::reset()
+{
+    mCentroids.clear();
+    mBuffer.clear();
+    mTotalWeight = mBufferWeight = 0;
+    mMin = mMax = 0;
+}
+
+void QuantileSketch::flush() const
+{
+    if (mBuffer.empty())
+        return;
+
+    mBuffer.insert(mBuffer.end(), mCentroids.begin(), mCentroids.end());
+    sort(mBuffer.begin(), mBuffer.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+    double total = mTotalWeight + mBufferWeight;
+
+    // one pass from the left, a centroid takes its neighbour while both fit into one unit of k
+    mCentroids.clear();
+    auto current = mBuffer[0];
+    double before = 0; // weight left of current
+    double limit = getScale(0) + 1;
+    for (size_t i = 1; i < mBuffer.size(); i++)
+    {
+        const auto& next = mBuffer[i];
+        double q = (before + current.weight + next.weight) / total;
+        if (getScale(q) <= limit)
+        {
+            current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+            current.weight += next.weight;
+        }
+        else
+        {
+            before += current.weight;
+            mCentroids.push_back(current);
+            current = next;
+            limit = getScale(before / total) + 1;
+        }
+    }
+    mCentroids.push_back(current);
+
+    mBuffer.clear();
+    mTotalWeight = total;
+    mBufferWeight = 0;
+}
+
+float QuantileSketch::getQuantile(double q) const
+{
+    if (empty())
+        return 0;
+    flush();
+    if (q <= 0) return mMin;
+    if (q >= 1) return mMax;
+    if (mCentroids.size() == 1) return mCentroids[0].mean;
+
+    // the centroids are at the middle of their weight, interpolate between those points
+    double target = q * mTotalWeight;
+    double first = mCentroids.front().weight / 2;
+    if (target < first)
+        return mMin + (mCentroids.front().mean - mMin) * target / first;
+
+    double cumulative = first;
+    for (size_t i = 0; i + 1 < mCentroids.size(); i++)
+    {
+        const auto& left = mCentroids[i];
+        const auto& right = mCentroids[i + 1];
+        double span = (left.weight + right.weight) / 2;
+        if (target < cumulative + span)
+        {
+            double t = (target - cumulative) / span;
+            return float(left.mean + (right.mean - left.mean) * t);
+        }
+        cumulative += span;
+    }
+
+    double last = mCentroids.back().weight / 2;
+    double t = min(1.0, (target - cumulative) / last);
+    return float(mCentroids.back().mean + (mMax - mCentroids.back().mean) * t);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Streaming quantiles of a metric, a merging t-digest (Dunning & Ertl).
+// Values are buffered and merged into at most about kCompression centroids, small near both ends
+// so p1 and p99 stay accurate. The memory is the same after a minute or a day, and two sketches
+// merge into the sketch of both streams.
+struct QuantileSketch
+{
+    static const int kCompression = 100;
+
+    void add(float value, float weight = 1);
+    void merge(const QuantileSketch& other);
+    void reset();
+
+    // q in [0, 1], 0 when empty
+    float getQuantile(double q) const;
+    double getCount() const { return mTotalWeight + mBufferWeight; }
+    bool empty() const { return getCount() == 0; }
+    size_t getMemoryBytes() const { return (mCentroids.capacity() + mBuffer.capacity()) * sizeof(Centroid); }
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    void flush() const;
+
+    // merged lazily, getQuantile() is const
+    mutable std::vector<Centroid> mCentroids; // sorted by mean
+    mutable std::vector<Centroid> mBuffer;
+    mutable double mTotalWeight = 0; // of mCentroids
+    mutable double mBufferWeight = 0;
+    float mMin = 0, mMax = 0;
+};
+
+// Min, max, average and quantiles of a metric as its values arrive
+struct MetricSummary
+{
+    float Min = 0, Max = 0, Avg = 0; // 0 until the first value
+    int Count = 0;
+    double Sum = 0; // Avg without the drift of a running average
+    QuantileSketch Quantiles;
+
+    void reset()
+    {
+        *this = MetricSummary();
+    }
+
+    void update(float new_value)
+    {
+        if (Count == 0 || new_value > Max) Max = new_value;
+        if (Count == 0 || new_value < Min) Min = new_value;
+        Count++;
+        Sum += new_value;
+        Avg = Sum / Count;
+        Quantiles.add(new_value);
+    }
+
+    void merge(const MetricSummary& other)
+    {
+        if (other.Count == 0) return;
+        if (Count == 0 || other.Max > Max) Max = other.Max;
+        if (Count == 0 || other.Min < Min) Min = other.Min;
+        Count += other.Count;
+        Sum += other.Sum;
+        Avg = Sum / Count;
+        Quantiles.merge(other.Quantiles);
+    }
+
+    // q in [0, 1]
+    float getQuantile(double q) const { return Quantiles.getQuantile(q); }
+};
@@ -0,0 +1,103 @@
+#include "RangeIndex.h"
+#include "SeriesStore.h"
+
+using namespace std;
+
+void RangeIndex::add(float value)
+{
+    mOpen.update(value);
+    if (++mSize % kBlockSize != 0)
+        return;
+
+    // full, a right child carries the merge of it and its sibling a level up
+    if (mLevels.empty())
+        mLevels.emplace_back();
+    mLevels[0].push_back(mOpen);
+    mOpen.reset();
+    for (size_t level = 0; mLevels[level].size() % 2 == 0; level++)
+    {
+        const auto& nodes = mLevels[level];
+        MetricSummary parent = nodes[nodes.size() - 2];
+        parent.merge(nodes.back());
+        if (level + 1 == mLevels.size())
+            mLevels.emplace_back();
+        mLevels[level + 1].push_back(parent);
+    }
+}
+
+void RangeIndex::update(const ChunkedColumn<float>& column, size_t i)
+{
+    if (i >= mSize)
+        return;
+
+    size_t block = i / kBlockSize;
+    MetricSummary summary;
+    for (size_t j = block * kBlockSize; j < min(mSize, (block + 1) * kBlockSize); j++)
+        summary.update(column.get(j));
+    if (mLevels.empty() || block >= mLevels[0].size())
+    {
+        mOpen = summary;
+        return;
+    }
+
+    // the merges above the block, up to where its ancestor has no sibling yet
+    mLevels[0][block] = summary;
+    for (size_t level = 0; level + 1 < mLevels.size(); level++)
+    {
+        size_t parent = block / 2;
+        if (parent >= mLevels[level + 1].size())
+            break;
+        MetricSummary node = mLevels[level][parent * 2];
+        node.merge(mLevels[level][parent * 2 + 1]);
+        mLevels[level + 1][parent] = node;
+        block = parent;
+    }
+}
+
+MetricSummary RangeIndex::query(const ChunkedColumn<float>& column, size_t first, size_t last) const
+{
+    MetricSummary summary;
+    last = min(last, mSize);
+    if (first >= last)
+        return summary;
+
+    // the full blocks in the range, the samples around them are read
+    size_t firstBlock = (first + kBlockSize - 1) / kBlockSize;
+    size_t lastBlock = last / kBlockSize;
+    if (firstBlock >= lastBlock)
+    {
+        for (size_t i = first; i < last; i++)
+            summary.update(column.get(i));
+        return summary;
+    }
+    for (size_t i = first; i < firstBlock * kBlockSize; i++)
+        summary.update(column.get(i));
+    for (size_t i = lastBlock * kBlockSize; i < last; i++)
+        summary.update(column.get(i));
+
+    // bottom up, a node at either end that its parent would take only half of is merged on its own.
+    // lastBlock never passes the blocks of level 0, so a level always has the nodes asked for.
+    size_t lo = firstBlock, hi = lastBlock;
+    for (size_t level = 0; lo < hi; level++)
+    {
+        const auto& nodes = mLevels[level];
+        if (lo % 2 == 1)
+            summary.merge(nodes[lo++]);
+        if (hi % 2 == 1)
+            summary.merge(nodes[--hi]);
+        lo /= 2;
+        hi /= 2;
+    }
+    return summary;
+}
+
+size_t RangeIndex::getMemoryBytes() const
+{
+    size_t bytes = sizeof(*this) + mOpen.Quantiles.getMemoryBytes();
+    for (const auto& nodes : mLevels)
+    {
+        for (const auto& node : nodes)
+            bytes += sizeof(node) + node.Quantiles.getMemoryBytes();
+    }
+    return bytes;
+}
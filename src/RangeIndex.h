@@ -0,0 +1,37 @@
+#pragma once
+
+#include "QuantileSketch.h"
+
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+struct ChunkedColumn;
+
+// Summaries of a column over any range of its samples.
+// The samples are summarized in blocks of kBlockSize, and a block that fills up is merged
+// pairwise up a segment tree. A range is then the merge of at most two nodes per level plus
+// the samples of the two blocks it ends in, O(log n) whatever its length.
+// A plain segment tree rather than prefix sums and a sparse table: every node is a MetricSummary
+// that merges, so count, sum, min, max and quantiles come from one structure, and it grows by
+// appending instead of rebuilding rows.
+struct RangeIndex
+{
+    static const size_t kBlockSize = 4096; // the chunk size of the column, the ends decode a chunk each
+
+    // the next sample of the column
+    void add(float value);
+    // sample i of column changed, its block and the nodes above it are summarized again
+    void update(const ChunkedColumn<float>& column, size_t i);
+
+    // samples [first, last) of column, add() has seen all of them
+    MetricSummary query(const ChunkedColumn<float>& column, size_t first, size_t last) const;
+
+    size_t size() const { return mSize; }
+    size_t getMemoryBytes() const;
+
+private:
+    std::vector<std::vector<MetricSummary>> mLevels; // 0: the full blocks, k: merges of 2^k of them
+    MetricSummary mOpen; // the block being filled
+    size_t mSize = 0;
+};
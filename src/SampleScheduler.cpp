@@ -0,0 +1,115 @@
+#include "SampleScheduler.h"
+#include "cinder/Log.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    // a probe due within this fraction of the fastest period joins the current batch
+    const float kCoalesceRatio = 0.25f;
+    // the probe speeds up again once it is well under budget
+    const float kRecoverRatio = 0.5f;
+    const float kLatencySmoothing = 0.3f;
+}
+
+void SampleScheduler::setProbes(const vector<SampleProbe>& probes)
+{
+    vector<Entry> entries;
+    for (const auto& probe : probes)
+    {
+        Entry entry;
+        auto it = find_if(mEntries.begin(), mEntries.end(), [&](const Entry& e) { return e.probe == probe; });
+        if (it != mEntries.end())
+            entry = *it;
+        entry.probe = probe; // the hints may change
+        entries.push_back(entry);
+    }
+
+    // cheap probes first, so frame and cpu data of a batch are read as close together as possible
+    stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.probe.budgetMs < rhs.probe.budgetMs;
+    });
+    mEntries = move(entries);
+}
+
+vector<SampleProbe> SampleScheduler::takeDue(double now)
+{
+    vector<SampleProbe> due;
+    bool anyDue = false;
+    float fastestPeriod = 0;
+    for (const auto& entry : mEntries)
+    {
+        float period = entry.getPeriod();
+        if (period <= 0) continue;
+        if (entry.nextDue <= now)
+            anyDue = true;
+        if (fastestPeriod == 0 || period < fastestPeriod)
+            fastestPeriod = period;
+    }
+    if (!anyDue) return due;
+
+    // the fastest probe starts a batch soon anyway, so only pull in what would need its own round trip
+    double coalesceUntil = now + fastestPeriod * kCoalesceRatio;
+    for (auto& entry : mEntries)
+    {
+        float period = entry.getPeriod();
+        if (period > 0 && entry.nextDue > coalesceUntil)
+            continue;
+
+        due.push_back(entry.probe);
+        // keep the cadence, but don't try to catch up after a stall
+        entry.nextDue = max(entry.nextDue + period, now);
+    }
+    return due;
+}
+
+void SampleScheduler::reportLatency(const string& name, float elapsedMs)
+{
+    for (auto& entry : mEntries)
+    {
+        if (entry.probe.name != name) continue;
+
+        if (entry.avgLatencyMs < 0)
+            entry.avgLatencyMs = elapsedMs;
+        else
+            entry.avgLatencyMs += (elapsedMs - entry.avgLatencyMs) * kLatencySmoothing;
+
+        const auto& probe = entry.probe;
+        if (probe.period <= 0) break;
+
+        float maxBackoff = max(1.0f, probe.maxPeriod / probe.period);
+        float backoff = entry.backoff;
+        if (entry.avgLatencyMs > probe.budgetMs)
+            backoff = min(backoff * 2, maxBackoff);
+        else if (entry.avgLatencyMs < probe.budgetMs * kRecoverRatio)
+            backoff = max(backoff / 2, 1.0f);
+
+        if (backoff != entry.backoff)
+        {
+            CI_LOG_I(name << " takes " << entry.avgLatencyMs << " ms (budget " << probe.budgetMs
+                << " ms), sampling every " << probe.period * backoff << " s");
+            // the next run moves with the new period
+            entry.nextDue += probe.period * (backoff - entry.backoff);
+            entry.backoff = backoff;
+        }
+        break;
+    }
+}
+
+double SampleScheduler::getWaitTime(double now) const
+{
+    double wait = 1;
+    for (const auto& entry : mEntries)
+    {
+        if (entry.probe.period > 0)
+            wait = min(wait, entry.nextDue - now);
+    }
+    return max(wait, 0.0);
+}
+
+void SampleScheduler::reset()
+{
+    mEntries.clear();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "SampleScript.h"
+
+#include <string>
+#include <vector>
+
+// Decides which probes run in the next round trip.
+// Each probe runs at its own period, probes that are almost due ride along with the ones that are due,
+// and a probe whose measured on-device time exceeds its budget backs off until it fits again.
+struct SampleScheduler
+{
+    // Replaces the probe set, probes that keep their name and command keep their timing
+    void setProbes(const std::vector<SampleProbe>& probes);
+
+    // Probes to run at now, cheapest first, empty if nothing is due
+    std::vector<SampleProbe> takeDue(double now);
+
+    // Feeds back the time a probe took on the device
+    void reportLatency(const std::string& name, float elapsedMs);
+
+    // Seconds until the next probe is due
+    double getWaitTime(double now) const;
+
+    void reset();
+
+private:
+    struct Entry
+    {
+        SampleProbe probe;
+        double nextDue = 0;
+        float backoff = 1; // multiplier of probe.period
+        float avgLatencyMs = -1;
+
+        float getPeriod() const { return probe.period * backoff; }
+    };
+    std::vector<Entry> mEntries;
+};
@@ -0,0 +1,98 @@
+#include "SampleScript.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+static const char kSectionHeader[] = "==pd== ";
+
+string buildSampleScript(const vector<SampleProbe>& probes, const string& functionPrefix)
+{
+    // s=$EPOCHREALTIME; o=$(cmd 2>&1); echo "==pd== name ${#o} $s $EPOCHREALTIME"; echo "$o"
+    // ${#o} is a byte count as long as the shell is not in utf8 mode, which is the default of mksh on Android.
+    string script;
+    for (const auto& probe : probes)
+    {
+        script += functionPrefix + "_" + probe.name + "() { ";
+        script += "s=$EPOCHREALTIME; o=$(" + probe.cmd + " 2>&1); ";
+        script += "echo \"" + string(kSectionHeader) + probe.name + " ${#o} $s $EPOCHREALTIME\"; ";
+        script += "echo \"$o\"; }\n";
+    }
+    return script;
+}
+
+string buildSampleCall(const vector<SampleProbe>& probes, const string& functionPrefix)
+{
+    string call;
+    for (const auto& probe : probes)
+    {
+        if (!call.empty()) call += "; ";
+        call += functionPrefix + "_" + probe.name;
+    }
+    return call;
+}
+
+bool parseSampleOutput(const string& blob, vector<SampleSection>& sections)
+{
+    sections.clear();
+
+    const size_t headerLen = sizeof(kSectionHeader) - 1;
+    size_t pos = blob.find(kSectionHeader);
+    while (pos != string::npos)
+    {
+        auto lineEnd = blob.find('\n', pos);
+        if (lineEnd == string::npos)
+            return false; // truncated header
+
+        // "==pd== name length start end"
+        auto nameStart = pos + headerLen;
+        auto nameEnd = blob.find(' ', nameStart);
+        if (nameEnd == string::npos || nameEnd > lineEnd)
+            return false;
+        char* fields = nullptr;
+        size_t length = strtoul(blob.c_str() + nameEnd + 1, &fields, 10);
+
+        SampleSection section;
+        section.name = blob.substr(nameStart, nameEnd - nameStart);
+
+        // optional start and end time, both empty when $EPOCHREALTIME is not supported
+        char* endField = nullptr;
+        double start = strtod(fields, &endField);
+        if (endField != fields && endField < blob.c_str() + lineEnd)
+        {
+            char* afterEnd = nullptr;
+            double end = strtod(endField, &afterEnd);
+            if (afterEnd != endField && afterEnd <= blob.c_str() + lineEnd && start > 0 && end >= start)
+            {
+                section.start = start;
+                section.end = end;
+                section.elapsedMs = (end - start) * 1e3;
+            }
+        }
+
+        auto payloadStart = lineEnd + 1;
+        auto payloadEnd = payloadStart + length;
+        auto next = string::npos;
+        if (payloadEnd <= blob.size()
+            && (payloadEnd == blob.size() || blob[payloadEnd] == '\n' || blob[payloadEnd] == '\r'))
+        {
+            next = blob.find(kSectionHeader, payloadEnd);
+        }
+        else
+        {
+            // length mismatch (multi-byte characters or \r\n from a pty), fall back to the next header
+            next = blob.find(string("\n") + kSectionHeader, payloadStart);
+            payloadEnd = next == string::npos ? blob.size() : next;
+            if (next != string::npos) next++;
+        }
+        if (payloadEnd > blob.size())
+            payloadEnd = blob.size();
+
+        section.payload = blob.substr(payloadStart, payloadEnd - payloadStart);
+        sections.push_back(move(section));
+
+        pos = next;
+    }
+
+    return !sections.empty();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One probe of the on-device sample script, e.g. { "proc_stat", "cat /proc/stat" }
+struct SampleProbe
+{
+    std::string name;
+    std::string cmd;
+
+    // scheduling hints, see SampleScheduler
+    float period = 0; // seconds between two runs, 0 = rides along every batch
+    float budgetMs = 50; // on-device time a run may take before the probe backs off
+    float maxPeriod = 10; // upper bound of the backoff
+
+    bool operator==(const SampleProbe& rhs) const { return name == rhs.name && cmd == rhs.cmd; }
+};
+
+struct SampleSection
+{
+    std::string name;
+    std::string payload;
+    double start = 0, end = 0; // $EPOCHREALTIME around the probe in seconds, 0 if the shell doesn't have it
+    float elapsedMs = -1; // time the probe took on the device, -1 if the shell has no $EPOCHREALTIME
+};
+
+// Defines one shell function per probe that runs it and prints its output behind a framed header:
+//
+// ==pd== proc_stat 1234 1700000000.000100 1700000000.002300
+// <1234 bytes of payload>
+//
+// The trailing fields are $EPOCHREALTIME before and after the probe.
+// The functions are installed once per session, each tick then only sends the names of the due probes.
+std::string buildSampleScript(const std::vector<SampleProbe>& probes, const std::string& functionPrefix);
+
+// "prefix_a; prefix_b", runs the given probes in one round trip
+std::string buildSampleCall(const std::vector<SampleProbe>& probes, const std::string& functionPrefix);
+
+// Splits the output of the sample functions back into sections.
+// The byte length is trusted first, if it doesn't line up the parser resyncs on the next header.
+bool parseSampleOutput(const std::string& blob, std::vector<SampleSection>& sections);
@@ -0,0 +1,219 @@
+#include "SeriesCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+    int countLeadingZeros(uint32_t value)
+    {
+        int count = 0;
+        for (uint32_t bit = 1u << 31; bit && !(value & bit); bit >>= 1)
+            count++;
+        return count;
+    }
+
+    int countTrailingZeros(uint32_t value)
+    {
+        if (value == 0) return 32;
+        int count = 0;
+        while (!(value & 1))
+        {
+            value >>= 1;
+            count++;
+        }
+        return count;
+    }
+
+    uint64_t lowBits(int count)
+    {
+        return count >= 64 ? ~0ull : (1ull << count) - 1;
+    }
+
+    int64_t signExtend(uint64_t value, int count)
+    {
+        uint64_t sign = 1ull << (count - 1);
+        return int64_t((value ^ sign) - sign);
+    }
+
+    uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float bitsFloat(uint32_t bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // the delta-of-delta buckets, a prefix of ones closed by a zero then the signed value
+    struct Bucket
+    {
+        int prefixBits;
+        uint64_t prefix;
+        int valueBits;
+    };
+    const Bucket kBuckets[] = {
+        { 2, 0b10, 7 },
+        { 3, 0b110, 9 },
+        { 4, 0b1110, 12 },
+        { 4, 0b1111, 64 },
+    };
+}
+
+void BitWriter::write(uint64_t value, int count)
+{
+    value &= lowBits(count);
+    while (count > 0)
+    {
+        if (mUsed == 64)
+        {
+            mWords.push_back(0);
+            mUsed = 0;
+        }
+        int n = min(count, 64 - mUsed);
+        uint64_t part = (value >> (count - n)) & lowBits(n);
+        mWords.back() |= part << (64 - mUsed - n);
+        mUsed += n;
+        count -= n;
+    }
+}
+
+uint64_t BitReader::read(int count)
+{
+    uint64_t value = 0;
+    while (count > 0)
+    {
+        size_t word = mPos / 64;
+        int used = mPos % 64;
+        int n = min(count, 64 - used);
+        uint64_t bits = word < mWords.size() ? mWords[word] : 0;
+        uint64_t part = (bits >> (64 - used - n)) & lowBits(n);
+        value = n == 64 ? part : (value << n) | part;
+        mPos += n;
+        count -= n;
+    }
+    return value;
+}
+
+void encodeChunk(const uint64_t* values, size_t count, vector<uint64_t>& words)
+{
+    BitWriter writer(words);
+    if (count == 0) return;
+    writer.write(values[0], 64);
+
+    int64_t prevDelta = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        int64_t delta = int64_t(values[i] - values[i - 1]);
+        int64_t dod = delta - prevDelta;
+        prevDelta = delta;
+        if (dod == 0)
+        {
+            writer.write(0, 1);
+            continue;
+        }
+        for (const auto& bucket : kBuckets)
+        {
+            int64_t limit = bucket.valueBits >= 64 ? INT64_MAX : 1ll << (bucket.valueBits - 1);
+            if (bucket.valueBits >= 64 || (dod >= -limit && dod < limit))
+            {
+                writer.write(bucket.prefix, bucket.prefixBits);
+                writer.write(uint64_t(dod), bucket.valueBits);
+                break;
+            }
+        }
+    }
+}
+
+void decodeChunk(const vector<uint64_t>& words, size_t count, uint64_t* values)
+{
+    BitReader reader(words);
+    if (count == 0) return;
+    values[0] = reader.read(64);
+
+    int64_t delta = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        int ones = 0;
+        while (ones < 4 && reader.readBit())
+            ones++;
+        if (ones > 0)
+        {
+            int valueBits = kBuckets[ones - 1].valueBits;
+            delta += signExtend(reader.read(valueBits), valueBits);
+        }
+        values[i] = values[i - 1] + delta;
+    }
+}
+
+void encodeChunk(const float* values, size_t count, vector<uint64_t>& words)
+{
+    BitWriter writer(words);
+    if (count == 0) return;
+    uint32_t prev = floatBits(values[0]);
+    writer.write(prev, 32);
+
+    // the meaningful bits of the previous XOR, reused while the new one fits into them
+    int prevLeading = -1, prevTrailing = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        uint32_t bits = floatBits(values[i]);
+        uint32_t xorBits = bits ^ prev;
+        prev = bits;
+        if (xorBits == 0)
+        {
+            writer.write(0, 1);
+            continue;
+        }
+        writer.write(1, 1);
+
+        int leading = min(countLeadingZeros(xorBits), 31);
+        int trailing = countTrailingZeros(xorBits);
+        if (prevLeading >= 0 && leading >= prevLeading && trailing >= prevTrailing)
+        {
+            writer.write(0, 1);
+            writer.write(xorBits >> prevTrailing, 32 - prevLeading - prevTrailing);
+        }
+        else
+        {
+            int length = 32 - leading - trailing;
+            writer.write(1, 1);
+            writer.write(leading, 5);
+            writer.write(length - 1, 5);
+            writer.write(xorBits >> trailing, length);
+            prevLeading = leading;
+            prevTrailing = trailing;
+        }
+    }
+}
+
+void decodeChunk(const vector<uint64_t>& words, size_t count, float* values)
+{
+    BitReader reader(words);
+    if (count == 0) return;
+    uint32_t prev = uint32_t(reader.read(32));
+    values[0] = bitsFloat(prev);
+
+    int leading = 0, trailing = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (reader.readBit())
+        {
+            if (reader.readBit())
+            {
+                leading = int(reader.read(5));
+                int length = int(reader.read(5)) + 1;
+                trailing = 32 - leading - length;
+            }
+            prev ^= uint32_t(reader.read(32 - leading - trailing)) << trailing;
+        }
+        values[i] = bitsFloat(prev);
+    }
+}
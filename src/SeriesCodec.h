@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression of the sealed chunks of a series, after Gorilla (Facebook's in-memory TSDB):
+// timestamps as delta-of-delta, values as the XOR with the previous value.
+// Timestamps of a steady clock and values that hardly change take a bit or two each.
+
+// Appends bits to a buffer of words, the first bit is the highest of the first word
+struct BitWriter
+{
+    explicit BitWriter(std::vector<uint64_t>& words) : mWords(words) {}
+
+    // the low count bits of value, count is at most 64
+    void write(uint64_t value, int count);
+
+private:
+    std::vector<uint64_t>& mWords;
+    int mUsed = 64; // bits of the last word in use
+};
+
+struct BitReader
+{
+    explicit BitReader(const std::vector<uint64_t>& words) : mWords(words) {}
+
+    uint64_t read(int count);
+    bool readBit() { return read(1) != 0; }
+
+private:
+    const std::vector<uint64_t>& mWords;
+    size_t mPos = 0; // in bits
+};
+
+void encodeChunk(const uint64_t* values, size_t count, std::vector<uint64_t>& words);
+void decodeChunk(const std::vector<uint64_t>& words, size_t count, uint64_t* values);
+
+void encodeChunk(const float* values, size_t count, std::vector<uint64_t>& words);
+void decodeChunk(const std::vector<uint64_t>& words, size_t count, float* values);
+
+// What SeriesStore::measureCodec() found
+struct SeriesCodecStats
+{
+    size_t values = 0;
+    size_t rawBytes = 0;
+    size_t packedBytes = 0;
+    double encodeSeconds = 0;
+    double decodeSeconds = 0;
+
+    float getRatio() const { return packedBytes > 0 ? float(rawBytes) / packedBytes : 0; }
+};
@@ -0,0 +1,273 @@
+#include "SeriesStore.h"
+
+#include <cfloat>
+
+using namespace std;
+
+uint64_t SeriesView::getTime(size_t point) const
+{
+    if (level < 0)
+        return series->getTime(first + point * stride);
+    return series->mLevels[level].getBucketTime(first + point / 2);
+}
+
+float SeriesView::get(size_t point, int field) const
+{
+    if (level < 0)
+        return series->get(first + point * stride, field);
+    // a vertical stroke per bucket, from its min to its max
+    const auto& lod = series->mLevels[level];
+    size_t bucket = first + point / 2;
+    return point % 2 == 0 ? lod.getMin(bucket, field) : lod.getMax(bucket, field);
+}
+
+void Series::init(const vector<string>& fieldNames)
+{
+    fields = fieldNames;
+    mValues.resize(fields.size());
+    mIndexes.resize(fields.size());
+    if (fields.empty())
+        return; // only timestamps, nothing to plot at a lower detail
+
+    mLevels.resize(kLodLevels);
+    size_t bucketSize = kLodBase;
+    for (auto& level : mLevels)
+    {
+        level.bucketSize = bucketSize;
+        level.min.resize(fields.size());
+        level.max.resize(fields.size());
+        level.openMin.resize(fields.size());
+        level.openMax.resize(fields.size());
+        bucketSize *= kLodFactor;
+    }
+}
+
+void Series::append(uint64_t ts, const float* row)
+{
+    mTime.push_back(ts);
+    for (size_t field = 0; field < mValues.size(); field++)
+    {
+        mValues[field].push_back(row[field]);
+        if (mIndexes[field])
+            mIndexes[field]->add(row[field]);
+    }
+    addToLevels(ts, row);
+}
+
+void Series::addToLevels(uint64_t ts, const float* row)
+{
+    // every level takes the sample right away, so the open buckets reach the newest one
+    for (auto& lod : mLevels)
+    {
+        if (lod.openCount == 0)
+        {
+            lod.openTime = ts;
+            copy(row, row + fields.size(), lod.openMin.begin());
+            copy(row, row + fields.size(), lod.openMax.begin());
+        }
+        else
+        {
+            for (size_t field = 0; field < fields.size(); field++)
+            {
+                lod.openMin[field] = min(lod.openMin[field], row[field]);
+                lod.openMax[field] = max(lod.openMax[field], row[field]);
+            }
+        }
+        if (++lod.openCount < lod.bucketSize)
+            continue;
+
+        // full, the time goes last as readers count the buckets by it
+        for (size_t field = 0; field < fields.size(); field++)
+        {
+            lod.min[field].push_back(lod.openMin[field]);
+            lod.max[field].push_back(lod.openMax[field]);
+        }
+        lod.time.push_back(lod.openTime);
+        lod.openCount = 0;
+    }
+}
+
+void Series::set(size_t i, int field, float value)
+{
+    mValues[field].set(i, value);
+    for (size_t level = 0; level < mLevels.size(); level++)
+        updateBucket(level, i / mLevels[level].bucketSize, field);
+    if (mIndexes[field])
+        mIndexes[field]->update(mValues[field], i);
+}
+
+void Series::updateBucket(size_t level, size_t bucket, int field)
+{
+    auto& lod = mLevels[level];
+    if (bucket >= lod.getBucketCount())
+        return;
+
+    // again from what the bucket covers, a changed value may have been its min or max
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    if (level == 0)
+    {
+        size_t end = min(size(), (bucket + 1) * kLodBase);
+        for (size_t i = bucket * kLodBase; i < end; i++)
+        {
+            float value = get(i, field);
+            lo = min(lo, value);
+            hi = max(hi, value);
+        }
+    }
+    else
+    {
+        const auto& below = mLevels[level - 1];
+        size_t end = min(below.getBucketCount(), (bucket + 1) * kLodFactor);
+        for (size_t child = bucket * kLodFactor; child < end; child++)
+        {
+            lo = min(lo, below.getMin(child, field));
+            hi = max(hi, below.getMax(child, field));
+        }
+    }
+
+    if (bucket < lod.time.size())
+    {
+        lod.min[field].set(bucket, lo);
+        lod.max[field].set(bucket, hi);
+    }
+    else
+    {
+        lod.openMin[field] = lo;
+        lod.openMax[field] = hi;
+    }
+}
+
+size_t Series::lowerBound(uint64_t ts) const
+{
+    // the last chunk starting at or before ts
+    size_t first = 0, last = mTime.getChunkCount();
+    while (last - first > 1)
+    {
+        size_t mid = (first + last) / 2;
+        if (mTime.getChunkFirst(mid) <= ts) first = mid;
+        else last = mid;
+    }
+    size_t lo = first * ChunkedColumn<uint64_t>::kChunkSize;
+    size_t hi = min(size(), lo + ChunkedColumn<uint64_t>::kChunkSize);
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (mTime.get(mid) < ts) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+SeriesView Series::getView(uint64_t start, uint64_t end, size_t maxPoints) const
+{
+    SeriesView view;
+    view.series = this;
+    if (empty() || maxPoints < 2)
+        return view;
+
+    // one sample beyond each end, so the line leaves the plot instead of stopping short of its edge
+    size_t lo = lowerBound(start), hi = lowerBound(end);
+    lo = lo > 0 ? lo - 1 : 0;
+    hi = min(hi + 1, size());
+    if (lo >= hi)
+        return view;
+
+    size_t count = hi - lo;
+    if (count <= maxPoints)
+    {
+        view.first = lo;
+        view.count = count;
+        return view;
+    }
+    if (mLevels.empty())
+    {
+        // timestamps only, thinned out
+        view.stride = (count + maxPoints - 1) / maxPoints;
+        view.first = lo;
+        view.count = (count + view.stride - 1) / view.stride;
+        return view;
+    }
+
+    // the finest level with at most maxPoints / 2 buckets in the range
+    for (size_t level = 0; level < mLevels.size(); level++)
+    {
+        const auto& levelLod = mLevels[level];
+        size_t bucketCount = levelLod.getBucketCount();
+        size_t firstBucket = lo / levelLod.bucketSize;
+        if (firstBucket >= bucketCount)
+            break; // appended right now, the level below will do this time
+        size_t lastBucket = min((hi - 1) / levelLod.bucketSize, bucketCount - 1);
+        view.level = level;
+        view.first = firstBucket;
+        view.count = (lastBucket - firstBucket + 1) * 2;
+        if (view.count <= maxPoints)
+            break;
+    }
+    if (view.level < 0)
+    {
+        view.first = lo;
+        view.count = count;
+    }
+    return view;
+}
+
+MetricSummary Series::getSummary(uint64_t start, uint64_t end, int field) const
+{
+    if (empty() || start >= end)
+        return {};
+
+    auto& index = mIndexes[field];
+    if (!index)
+    {
+        index.reset(new RangeIndex);
+        for (size_t i = 0; i < size(); i++)
+            index->add(get(i, field));
+    }
+    return index->query(mValues[field], lowerBound(start), lowerBound(end));
+}
+
+void Series::clear()
+{
+    mTime.clear();
+    for (auto& column : mValues)
+        column.clear();
+    for (auto& lod : mLevels)
+    {
+        lod.time.clear();
+        for (auto& column : lod.min)
+            column.clear();
+        for (auto& column : lod.max)
+            column.clear();
+        lod.openCount = 0;
+    }
+    for (auto& index : mIndexes)
+        index.reset();
+}
+
+size_t Series::getMemoryBytes() const
+{
+    size_t bytes = mTime.getMemoryBytes();
+    for (const auto& column : mValues)
+        bytes += column.getMemoryBytes();
+    for (const auto& lod : mLevels)
+    {
+        bytes += lod.time.getMemoryBytes();
+        for (const auto& column : lod.min)
+            bytes += column.getMemoryBytes();
+        for (const auto& column : lod.max)
+            bytes += column.getMemoryBytes();
+    }
+    for (const auto& index : mIndexes)
+    {
+        if (index)
+            bytes += index->getMemoryBytes();
+    }
+    return bytes;
+}
+
+void Series::measureCodec(SeriesCodecStats& timeStats, SeriesCodecStats& valueStats) const
+{
+    mTime.measureCodec(timeStats);
+    for (const auto& column : mValues)
+        column.measureCodec(valueStats);
+}
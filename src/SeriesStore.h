@@ -0,0 +1,327 @@
+#pragma once
+
+#include "RangeIndex.h"
+#include "SeriesCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Values appended in chunks of a fixed size. Appending never moves what is stored already,
+// so a series of a soak test grows by one chunk at a time instead of reallocating everything.
+// A full chunk is sealed: compressed by SeriesCodec and decoded again only when it is read,
+// a few decoded chunks are cached for the charts and the export that read them in order.
+template <typename T>
+struct ChunkedColumn
+{
+    static const size_t kChunkSize = 4096;
+    static const int kCachedChunks = 4;
+
+    void push_back(const T& value)
+    {
+        if (mSize == mChunks.size() * kChunkSize)
+        {
+            if (!mChunks.empty())
+                seal(mChunks.back());
+            mChunks.emplace_back();
+            mChunks.back().raw.reset(new T[kChunkSize]);
+            mChunks.back().first = value;
+        }
+        mChunks.back().raw[mSize % kChunkSize] = value;
+        mSize++;
+    }
+
+    T get(size_t i) const
+    {
+        const auto& chunk = mChunks[i / kChunkSize];
+        if (chunk.raw)
+            return chunk.raw[i % kChunkSize];
+        return getSealed(i / kChunkSize, i % kChunkSize);
+    }
+
+    void set(size_t i, const T& value)
+    {
+        auto& chunk = mChunks[i / kChunkSize];
+        bool sealed = !chunk.raw;
+        if (sealed)
+            unseal(i / kChunkSize); // rare, memory samples are interpolated after the fact
+        chunk.raw[i % kChunkSize] = value;
+        if (i % kChunkSize == 0)
+            chunk.first = value;
+        if (sealed)
+            seal(chunk);
+    }
+
+    T back() const { return get(mSize - 1); }
+
+    // First value of a chunk without decoding it
+    T getChunkFirst(size_t chunk) const { return mChunks[chunk].first; }
+    size_t getChunkCount() const { return mChunks.size(); }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    size_t getMemoryBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& chunk : mChunks)
+            bytes += chunk.raw ? kChunkSize * sizeof(T) : chunk.packed.capacity() * sizeof(uint64_t);
+        if (mCache)
+            bytes += kCachedChunks * kChunkSize * sizeof(T);
+        return bytes;
+    }
+
+    void clear()
+    {
+        mChunks.clear();
+        mSize = 0;
+        mCache.reset();
+    }
+
+    // Encodes and decodes every chunk, the open one included
+    void measureCodec(SeriesCodecStats& stats) const
+    {
+        std::unique_ptr<T[]> decoded(new T[kChunkSize]);
+        for (size_t c = 0; c < mChunks.size(); c++)
+        {
+            const auto& chunk = mChunks[c];
+            size_t count = getChunkSize(c);
+            std::vector<uint64_t> words;
+            const std::vector<uint64_t>* packed = &chunk.packed;
+            if (chunk.raw)
+            {
+                double start = getSeconds();
+                encodeChunk(chunk.raw.get(), count, words);
+                stats.encodeSeconds += getSeconds() - start;
+                packed = &words;
+            }
+            double start = getSeconds();
+            decodeChunk(*packed, count, decoded.get());
+            stats.decodeSeconds += getSeconds() - start;
+            stats.values += count;
+            stats.rawBytes += count * sizeof(T);
+            stats.packedBytes += packed->size() * sizeof(uint64_t);
+        }
+    }
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<T[]> raw; // null once sealed
+        std::vector<uint64_t> packed;
+        T first = {};
+    };
+
+    struct Cache
+    {
+        size_t chunks[kCachedChunks];
+        std::unique_ptr<T[]> values[kCachedChunks];
+        int next = 0;
+    };
+
+    size_t getChunkSize(size_t chunk) const
+    {
+        size_t left = mSize - chunk * kChunkSize;
+        return left < kChunkSize ? left : kChunkSize;
+    }
+
+    static double getSeconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void seal(Chunk& chunk)
+    {
+        if (!mCache)
+        {
+            mCache.reset(new Cache);
+            for (int slot = 0; slot < kCachedChunks; slot++)
+            {
+                mCache->chunks[slot] = SIZE_MAX;
+                mCache->values[slot].reset(new T[kChunkSize]);
+            }
+        }
+        chunk.packed.clear();
+        encodeChunk(chunk.raw.get(), kChunkSize, chunk.packed);
+        chunk.packed.shrink_to_fit();
+        chunk.raw.reset();
+    }
+
+    void unseal(size_t c)
+    {
+        auto& chunk = mChunks[c];
+        chunk.raw.reset(new T[kChunkSize]);
+        decodeChunk(chunk.packed, kChunkSize, chunk.raw.get());
+        for (int slot = 0; slot < kCachedChunks; slot++)
+        {
+            if (mCache->chunks[slot] == c)
+                mCache->chunks[slot] = SIZE_MAX;
+        }
+    }
+
+    T getSealed(size_t c, size_t offset) const
+    {
+        auto& cache = *mCache;
+        for (int slot = 0; slot < kCachedChunks; slot++)
+        {
+            if (cache.chunks[slot] == c)
+                return cache.values[slot][offset];
+        }
+        int slot = cache.next;
+        cache.next = (cache.next + 1) % kCachedChunks;
+        decodeChunk(mChunks[c].packed, kChunkSize, cache.values[slot].get());
+        cache.chunks[slot] = c;
+        return cache.values[slot][offset];
+    }
+
+    std::vector<Chunk> mChunks;
+    size_t mSize = 0;
+    std::unique_ptr<Cache> mCache; // created with the first sealed chunk, series are read by the UI thread only
+};
+
+struct Series;
+
+// What to plot of a series in a time range: its samples, or the min and max of each bucket of
+// a level of detail when there are more samples than points to plot
+struct SeriesView
+{
+    const Series* series = nullptr;
+    int level = -1; // -1: the samples
+    size_t first = 0; // first sample or bucket
+    size_t stride = 1; // samples per point of a series without levels
+    size_t count = 0; // points
+
+    uint64_t getTime(size_t point) const;
+    float get(size_t point, int field = 0) const;
+};
+
+// A named time series, a timestamp column in ms and a float column per field.
+// Min and max of every field are kept for buckets of samples as they are appended, level 0 buckets
+// hold kLodBase samples and every level above merges kLodFactor buckets of the one below.
+struct Series
+{
+    static const size_t kLodBase = 32;
+    static const size_t kLodFactor = 4;
+    static const int kLodLevels = 8;
+
+    std::string name;
+    std::vector<std::string> fields;
+    bool frameClock = false; // timestamps of frames (CLOCK_MONOTONIC), otherwise of samples (CLOCK_REALTIME)
+
+    size_t size() const { return mTime.size(); }
+    bool empty() const { return mTime.empty(); }
+
+    uint64_t getTime(size_t i) const { return mTime.get(i); }
+    uint64_t getLastTime() const { return mTime.back(); }
+    float get(size_t i, int field = 0) const { return mValues[field].get(i); }
+    void set(size_t i, int field, float value);
+
+    // row holds a value per field
+    void append(uint64_t ts, const float* row);
+    void append(uint64_t ts, float value) { append(ts, &value); }
+
+    // First sample at or after ts, only the chunk it is in gets decoded
+    size_t lowerBound(uint64_t ts) const;
+
+    // The samples from start to end in at most about maxPoints points, the min and max of buckets
+    // when there are more samples. Derived values, like sums of fields, need a series of their own.
+    SeriesView getView(uint64_t start, uint64_t end, size_t maxPoints) const;
+
+    // Count, sum, min, max and quantiles of a field over the samples from start to end, in O(log n).
+    // The range index of a field is built by its first query, append() and set() keep it up to date from then on.
+    MetricSummary getSummary(uint64_t start, uint64_t end, int field = 0) const;
+
+    void clear();
+    size_t getMemoryBytes() const;
+    void measureCodec(SeriesCodecStats& timeStats, SeriesCodecStats& valueStats) const;
+
+private:
+    friend struct SeriesStore;
+    friend struct SeriesView;
+
+    struct Level
+    {
+        size_t bucketSize = 0; // samples
+        ChunkedColumn<uint64_t> time; // of the first sample of each full bucket
+        std::vector<ChunkedColumn<float>> min, max;
+        // the bucket being filled, up to the newest sample
+        uint64_t openTime = 0;
+        size_t openCount = 0; // samples
+        std::vector<float> openMin, openMax;
+
+        size_t getBucketCount() const { return time.size() + (openCount > 0 ? 1 : 0); }
+        uint64_t getBucketTime(size_t bucket) const { return bucket < time.size() ? time.get(bucket) : openTime; }
+        float getMin(size_t bucket, int field) const { return bucket < time.size() ? min[field].get(bucket) : openMin[field]; }
+        float getMax(size_t bucket, int field) const { return bucket < time.size() ? max[field].get(bucket) : openMax[field]; }
+    };
+
+    void init(const std::vector<std::string>& fieldNames);
+    void addToLevels(uint64_t ts, const float* row);
+    void updateBucket(size_t level, size_t bucket, int field);
+
+    ChunkedColumn<uint64_t> mTime;
+    std::vector<ChunkedColumn<float>> mValues;
+    std::vector<Level> mLevels;
+    mutable std::vector<std::unique_ptr<RangeIndex>> mIndexes; // per field, null until queried
+};
+
+// The series of a session by name. A new metric registers its series here, series are never
+// removed, so the references add() returns stay valid.
+struct SeriesStore
+{
+    // Registers a series, or returns the one with that name
+    Series& add(const std::string& name, const std::vector<std::string>& fields, bool frameClock = false)
+    {
+        auto& series = mSeries[name];
+        if (!series)
+        {
+            series.reset(new Series);
+            series->name = name;
+            series->frameClock = frameClock;
+            series->init(fields);
+        }
+        return *series;
+    }
+
+    Series* find(const std::string& name)
+    {
+        auto it = mSeries.find(name);
+        return it == mSeries.end() ? nullptr : it->second.get();
+    }
+    const Series* find(const std::string& name) const
+    {
+        auto it = mSeries.find(name);
+        return it == mSeries.end() ? nullptr : it->second.get();
+    }
+
+    // Drops every sample, the series stay registered
+    void clear()
+    {
+        for (auto& kv : mSeries)
+            kv.second->clear();
+    }
+
+    size_t getMemoryBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& kv : mSeries)
+            bytes += kv.second->getMemoryBytes();
+        return bytes;
+    }
+
+    // Compression of the timestamps and the values of every series
+    void measureCodec(SeriesCodecStats& timeStats, SeriesCodecStats& valueStats) const
+    {
+        for (const auto& kv : mSeries)
+            kv.second->measureCodec(timeStats, valueStats);
+    }
+
+    const std::map<std::string, std::unique_ptr<Series>>& getSeries() const { return mSeries; }
+
+private:
+    std::map<std::string, std::unique_ptr<Series>> mSeries;
+};
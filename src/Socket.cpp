@@ -0,0 +1,185 @@
+#include "Socket.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#define poll WSAPoll
+#define closesocket_ closesocket
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#define closesocket_ ::close
+#endif
+
+using namespace std;
+
+static bool initSockets()
+{
+#ifdef _WIN32
+    static bool init = [] {
+        WSADATA wsaData;
+        return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    }();
+    return init;
+#else
+    // a peer going away must not kill us with SIGPIPE
+    static bool init = [] {
+        signal(SIGPIPE, SIG_IGN);
+        return true;
+    }();
+    return init;
+#endif
+}
+
+static void setNonBlocking(intptr_t fd, bool enabled)
+{
+#ifdef _WIN32
+    u_long mode = enabled ? 1 : 0;
+    ioctlsocket((SOCKET)fd, FIONBIO, &mode);
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+#endif
+}
+
+TcpSocket& TcpSocket::operator=(TcpSocket&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        close();
+        mFd = rhs.mFd;
+        rhs.mFd = -1;
+    }
+    return *this;
+}
+
+bool TcpSocket::connect(const string& host, int port, int timeoutMs)
+{
+    close();
+    if (!initSockets()) return false;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &result) != 0 || !result)
+        return false;
+
+    auto fd = (intptr_t)socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd == -1)
+    {
+        freeaddrinfo(result);
+        return false;
+    }
+
+    // non-blocking connect so that a dead peer can't stall us for the OS timeout
+    setNonBlocking(fd, true);
+    int ret = ::connect(fd, result->ai_addr, (socklen_t)result->ai_addrlen);
+    freeaddrinfo(result);
+    if (ret != 0)
+    {
+        pollfd pfd = {};
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (poll(&pfd, 1, timeoutMs) != 1
+            || getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*)&error, &len) != 0
+            || error != 0)
+        {
+            closesocket_(fd);
+            return false;
+        }
+    }
+    setNonBlocking(fd, false);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+    mFd = fd;
+    return true;
+}
+
+void TcpSocket::close()
+{
+    if (mFd != -1)
+    {
+        closesocket_(mFd);
+        mFd = -1;
+    }
+}
+
+bool TcpSocket::sendAll(const void* data, size_t len)
+{
+    if (mFd == -1) return false;
+
+    auto ptr = (const char*)data;
+    while (len > 0)
+    {
+#ifdef _WIN32
+        int n = ::send((SOCKET)mFd, ptr, (int)len, 0);
+#else
+        auto n = ::send(mFd, ptr, len, MSG_NOSIGNAL);
+#endif
+        if (n <= 0)
+        {
+            close();
+            return false;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+int TcpSocket::recvSome(void* buf, size_t len, int timeoutMs)
+{
+    if (mFd == -1) return -1;
+
+    pollfd pfd = {};
+    pfd.fd = mFd;
+    pfd.events = POLLIN;
+    int ret = poll(&pfd, 1, timeoutMs);
+    if (ret == 0)
+        return 0;
+    if (ret < 0)
+    {
+        close();
+        return -1;
+    }
+
+    int n = (int)::recv(mFd, (char*)buf, (int)len, 0);
+    if (n <= 0)
+    {
+        close();
+        return -1;
+    }
+    return n;
+}
+
+bool TcpSocket::recvAll(void* buf, size_t len, int timeoutMs)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    auto ptr = (char*)buf;
+    while (len > 0)
+    {
+        auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+            return false;
+        int n = recvSome(ptr, len, (int)remaining);
+        if (n < 0)
+            return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
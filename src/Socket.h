@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Minimal blocking TCP client with timeouts, Winsock on Windows and BSD sockets elsewhere
+struct TcpSocket
+{
+    TcpSocket() = default;
+    ~TcpSocket() { close(); }
+
+    TcpSocket(const TcpSocket&) = delete;
+    TcpSocket& operator=(const TcpSocket&) = delete;
+    TcpSocket(TcpSocket&& rhs) noexcept : mFd(rhs.mFd) { rhs.mFd = -1; }
+    TcpSocket& operator=(TcpSocket&& rhs) noexcept;
+
+    bool connect(const std::string& host, int port, int timeoutMs = 2000);
+    bool isOpen() const { return mFd != -1; }
+    void close();
+
+    bool sendAll(const void* data, size_t len);
+    bool sendAll(const std::string& data) { return sendAll(data.c_str(), data.size()); }
+
+    // Returns the number of bytes read, 0 on timeout and -1 once the peer closed or the socket failed
+    int recvSome(void* buf, size_t len, int timeoutMs);
+    bool recvAll(void* buf, size_t len, int timeoutMs);
+
+private:
+    intptr_t mFd = -1;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The producer waits for a slot instead of overwriting, and only drops an item once the consumer
+// has been stuck for longer than the given wait. Depth, drops and stall time are kept for the UI.
+template <typename T>
+struct SpscQueue
+{
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        mSlots.resize(size);
+        mMask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only, item is moved from on success
+    bool tryPush(T& item)
+    {
+        auto tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) > mMask)
+            return false; // full
+        mSlots[tail & mMask] = std::move(item);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer only, waits up to maxWaitMs for a free slot and drops the item after that
+    bool push(T&& item, int maxWaitMs)
+    {
+        if (tryPush(item))
+            return true;
+
+        auto start = std::chrono::steady_clock::now();
+        bool pushed = false;
+        while (!(pushed = tryPush(item)))
+        {
+            if (std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(maxWaitMs))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto stalled = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        mStallUs.fetch_add(stalled.count(), std::memory_order_relaxed);
+        if (!pushed)
+            mDrops.fetch_add(1, std::memory_order_relaxed);
+        return pushed;
+    }
+
+    // Consumer only
+    bool tryPop(T& item)
+    {
+        auto head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+            return false; // empty
+        item = std::move(mSlots[head & mMask]);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    void clear()
+    {
+        T item;
+        while (tryPop(item))
+        {
+        }
+    }
+
+    size_t size() const { return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire); }
+    size_t capacity() const { return mSlots.size(); }
+    uint64_t getDrops() const { return mDrops.load(std::memory_order_relaxed); }
+    uint64_t getStallUs() const { return mStallUs.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> mSlots;
+    size_t mMask = 0;
+
+    // on separate cache lines so producer and consumer don't bounce one line between cores
+    alignas(64) std::atomic<size_t> mHead{ 0 };
+    alignas(64) std::atomic<size_t> mTail{ 0 };
+    alignas(64) std::atomic<uint64_t> mDrops{ 0 };
+    std::atomic<uint64_t> mStallUs{ 0 };
+};
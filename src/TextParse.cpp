@@ -0,0 +1,56 @@
+#include "TextParse.h"
+
+using namespace std;
+
+bool Tokenizer::next(string_view& token)
+{
+    auto start = mText.find_first_not_of(mSeparators, mPos);
+    if (start == string_view::npos)
+    {
+        mPos = mText.size();
+        return false;
+    }
+    auto end = mText.find_first_of(mSeparators, start);
+    if (end == string_view::npos)
+        end = mText.size();
+    token = mText.substr(start, end - start);
+    mPos = end;
+    return true;
+}
+
+bool Tokenizer::skip(int count)
+{
+    string_view token;
+    for (int i = 0; i < count; i++)
+    {
+        if (!next(token)) return false;
+    }
+    return true;
+}
+
+size_t splitFields(string_view text, char separator, string_view* fields, size_t maxFields)
+{
+    size_t count = 0;
+    size_t pos = 0;
+    while (count < maxFields)
+    {
+        auto end = count + 1 == maxFields ? string_view::npos : text.find(separator, pos);
+        if (end == string_view::npos)
+        {
+            fields[count++] = text.substr(pos);
+            break;
+        }
+        fields[count++] = text.substr(pos, end - pos);
+        pos = end + 1;
+    }
+    return count;
+}
+
+size_t splitTokens(string_view text, string_view separators, string_view* tokens, size_t maxTokens)
+{
+    Tokenizer tokenizer(text, separators);
+    size_t count = 0;
+    while (count < maxTokens && tokenizer.next(tokens[count]))
+        count++;
+    return count;
+}
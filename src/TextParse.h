@@ -0,0 +1,52 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+
+// Helpers for the text the probes print, nothing here allocates.
+
+// Walks the tokens of a line separated by any of the separator characters, empty tokens are skipped
+struct Tokenizer
+{
+    Tokenizer(std::string_view text, std::string_view separators = " \t")
+        : mText(text), mSeparators(separators)
+    {
+    }
+
+    bool next(std::string_view& token);
+    // Skips count tokens, returns false if the line ends first
+    bool skip(int count);
+    // What is left after the current position
+    std::string_view rest() const { return mText.substr(mPos); }
+
+private:
+    std::string_view mText;
+    std::string_view mSeparators;
+    size_t mPos = 0;
+};
+
+// Splits on a single separator keeping empty fields, the last field holds whatever is left.
+// Returns the number of fields written.
+size_t splitFields(std::string_view text, char separator, std::string_view* fields, size_t maxFields);
+
+// Splits on any of the separator characters skipping empty tokens like Tokenizer, stops after maxTokens.
+// Returns the number of tokens written.
+size_t splitTokens(std::string_view text, std::string_view separators, std::string_view* tokens, size_t maxTokens);
+
+// True if the token starts with a number, which is parsed into value
+template <typename T>
+bool parseNumber(std::string_view token, T& value)
+{
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return result.ec == std::errc();
+}
+
+// The n-th token (0 based) of line as a number, false if there is none
+template <typename T>
+bool parseToken(std::string_view line, int n, T& value, std::string_view separators = " \t")
+{
+    Tokenizer tokenizer(line, separators);
+    std::string_view token;
+    return tokenizer.skip(n) && tokenizer.next(token) && parseNumber(token, value);
+}
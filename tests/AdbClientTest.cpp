@@ -0,0 +1,395 @@
+// AdbClient against a stand-in adb server on a local port: host:*, host:transport:, shell: and
+// sync: RECV/SEND/DATA/DONE, with the FAIL replies and dropped connections of a real one
+#include "AdbClient.h"
+#include "TestUtil.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    const char* kSerial = "fake-serial";
+
+    void putU32(char* dst, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            dst[i] = (char)((value >> (i * 8)) & 0xff);
+    }
+
+    uint32_t getU32(const char* src)
+    {
+        auto p = (const uint8_t*)src;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    bool recvAll(int fd, void* buf, size_t len)
+    {
+        auto p = (char*)buf;
+        while (len > 0)
+        {
+            auto n = recv(fd, p, len, 0);
+            if (n <= 0) return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    bool sendAll(int fd, const string& data)
+    {
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            auto n = send(fd, data.c_str() + offset, data.size() - offset, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            offset += n;
+        }
+        return true;
+    }
+
+    string lengthPrefixed(const string& text)
+    {
+        char prefix[8];
+        snprintf(prefix, sizeof(prefix), "%04x", (unsigned)text.size());
+        return prefix + text;
+    }
+
+    string syncPacket(const char* id, uint32_t value, const string& data = "")
+    {
+        char header[8];
+        memcpy(header, id, 4);
+        putU32(header + 4, value);
+        return string(header, 8) + data;
+    }
+}
+
+struct FakeAdbServer
+{
+    // what the client sent, checked by the tests
+    mutex mMutex;
+    vector<string> requests; // the payloads of the length prefixed requests
+    map<string, string> files; // device path -> content, the pushed files land here too
+    vector<uint32_t> dataSizes; // of the DATA packets of the last SEND
+    string sendSpec;
+    int syncConnections = 0;
+
+    int port = 0;
+
+    bool start()
+    {
+        mListener = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(mListener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0; // any free port
+        socklen_t len = sizeof(addr);
+        if (::bind(mListener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(mListener, 16) != 0
+            || getsockname(mListener, (sockaddr*)&addr, &len) != 0)
+            return false;
+        port = ntohs(addr.sin_port);
+        mAcceptThread = thread([this] {
+            while (true)
+            {
+                int fd = accept(mListener, nullptr, nullptr);
+                if (fd < 0) break;
+                lock_guard<mutex> lock(mMutex);
+                mClients.push_back(fd);
+                mThreads.emplace_back([this, fd] { serve(fd); });
+            }
+        });
+        return true;
+    }
+
+    void stop()
+    {
+        mStopping = true;
+        shutdown(mListener, SHUT_RDWR);
+        close(mListener);
+        mAcceptThread.join();
+        {
+            lock_guard<mutex> lock(mMutex);
+            for (int fd : mClients)
+                shutdown(fd, SHUT_RDWR);
+        }
+        for (auto& t : mThreads)
+            t.join();
+    }
+
+private:
+    int mListener = -1;
+    atomic<bool> mStopping{ false };
+    thread mAcceptThread;
+    vector<thread> mThreads;
+    vector<int> mClients;
+
+    bool readRequest(int fd, string& request)
+    {
+        char prefix[5] = {};
+        if (!recvAll(fd, prefix, 4)) return false;
+        request.resize(strtoul(prefix, nullptr, 16));
+        if (!request.empty() && !recvAll(fd, &request[0], request.size())) return false;
+        lock_guard<mutex> lock(mMutex);
+        requests.push_back(request);
+        return true;
+    }
+
+    void serve(int fd)
+    {
+        string request;
+        if (!readRequest(fd, request))
+            return;
+
+        if (request == "host:version")
+        {
+            sendAll(fd, "OKAY" + lengthPrefixed("0029"));
+        }
+        else if (request.find(":forward:") != string::npos)
+        {
+            sendAll(fd, "OKAYOKAY");
+        }
+        else if (request == "host:junk")
+        {
+            sendAll(fd, "JUNK");
+        }
+        else if (request == "host:transport:" + string(kSerial) || request == "host:transport-any")
+        {
+            sendAll(fd, "OKAY");
+            if (readRequest(fd, request))
+                serveService(fd, request);
+        }
+        else if (request.compare(0, 15, "host:transport:") == 0)
+        {
+            sendAll(fd, "FAIL" + lengthPrefixed("device '" + request.substr(15) + "' not found"));
+        }
+        else
+        {
+            sendAll(fd, "FAIL" + lengthPrefixed("unknown host service"));
+        }
+        close(fd);
+    }
+
+    void serveService(int fd, const string& service)
+    {
+        if (service == "shell:hang")
+        {
+            // a hung device, nothing until the server goes down
+            sendAll(fd, "OKAY");
+            char c;
+            recv(fd, &c, 1, 0);
+        }
+        else if (service.compare(0, 6, "shell:") == 0)
+        {
+            sendAll(fd, "OKAY" + service.substr(6) + "\n");
+        }
+        else if (service == "sync:")
+        {
+            {
+                lock_guard<mutex> lock(mMutex);
+                syncConnections++;
+            }
+            sendAll(fd, "OKAY");
+            serveSync(fd);
+        }
+        else
+        {
+            sendAll(fd, "FAIL" + lengthPrefixed("closed"));
+        }
+    }
+
+    void serveSync(int fd)
+    {
+        char header[8];
+        while (recvAll(fd, header, 8))
+        {
+            string id(header, 4);
+            uint32_t len = getU32(header + 4);
+            string path(len, '\0');
+            if (len > 0 && !recvAll(fd, &path[0], len)) return;
+
+            if (id == "RECV")
+            {
+                if (path == "/short")
+                {
+                    // the connection drops in the middle of a DATA packet
+                    sendAll(fd, syncPacket("DATA", 100, "0123456789"));
+                    return;
+                }
+                string content;
+                bool found;
+                {
+                    lock_guard<mutex> lock(mMutex);
+                    found = files.count(path) > 0;
+                    if (found) content = files[path];
+                }
+                if (!found)
+                {
+                    sendAll(fd, syncPacket("FAIL", 25, "No such file or directory"));
+                    continue;
+                }
+                // at most 64 KB per DATA packet, the client has to join them
+                for (size_t offset = 0; offset < content.size(); offset += 64 * 1024)
+                {
+                    auto chunk = content.substr(offset, 64 * 1024);
+                    sendAll(fd, syncPacket("DATA", chunk.size(), chunk));
+                }
+                sendAll(fd, syncPacket("DONE", 0));
+            }
+            else if (id == "SEND")
+            {
+                string content;
+                vector<uint32_t> sizes;
+                while (true)
+                {
+                    if (!recvAll(fd, header, 8)) return;
+                    uint32_t value = getU32(header + 4);
+                    if (memcmp(header, "DONE", 4) == 0) break;
+                    if (memcmp(header, "DATA", 4) != 0) return;
+                    string chunk(value, '\0');
+                    if (!recvAll(fd, &chunk[0], value)) return;
+                    content += chunk;
+                    sizes.push_back(value);
+                }
+                auto remote = path.substr(0, path.rfind(','));
+                {
+                    lock_guard<mutex> lock(mMutex);
+                    sendSpec = path;
+                    dataSizes = sizes;
+                    if (remote.compare(0, 10, "/readonly/") != 0)
+                        files[remote] = content;
+                }
+                if (remote.compare(0, 10, "/readonly/") == 0)
+                    sendAll(fd, syncPacket("FAIL", 17, "Permission denied"));
+                else
+                    sendAll(fd, syncPacket("OKAY", 0));
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+};
+
+static string readFile(const string& path)
+{
+    ifstream in(path, ios::binary);
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static bool fileExists(const string& path)
+{
+    return ifstream(path).good();
+}
+
+static void testHost(FakeAdbServer& server, AdbClient& client)
+{
+    CHECK(client.isServerRunning());
+    CHECK(server.requests.back() == "host:version");
+
+    string response;
+    CHECK(!client.hostQuery("host:junk", response));
+    CHECK(client.getLastError() == "unknown reply from adb server");
+
+    CHECK(client.forward(kSerial, "tcp:1", "tcp:2"));
+    CHECK(server.requests.back() == "host-serial:" + string(kSerial) + ":forward:tcp:1;tcp:2");
+
+    AdbClient nobody("127.0.0.1", 1);
+    CHECK(!nobody.isServerRunning());
+    CHECK(nobody.getLastError() == "adb server is not running");
+}
+
+static void testShell(FakeAdbServer& server, AdbClient& client)
+{
+    string output;
+    CHECK(client.shell(kSerial, "echo hi", output));
+    CHECK(output == "echo hi\n");
+    auto count = server.requests.size();
+    CHECK(server.requests[count - 2] == "host:transport:" + string(kSerial));
+    CHECK(server.requests[count - 1] == "shell:echo hi");
+
+    CHECK(client.shell("", "any", output));
+    CHECK(server.requests[server.requests.size() - 2] == "host:transport-any");
+
+    CHECK(!client.shell("nosuch", "echo hi", output));
+    CHECK(client.getLastError() == "device 'nosuch' not found");
+
+    auto start = chrono::steady_clock::now();
+    CHECK(!client.shell(kSerial, "hang", output, 300));
+    CHECK(chrono::steady_clock::now() - start < chrono::seconds(2));
+    CHECK(client.getLastError() == "timeout: hang");
+}
+
+static void testSync(FakeAdbServer& server, AdbClient& client)
+{
+    // more than one DATA packet of 64 KB
+    string content;
+    for (int i = 0; i < 150 * 1024; i++)
+        content += char('a' + i % 26);
+    const string local = "AdbClientTest.push.tmp";
+    ofstream(local, ios::binary) << content;
+
+    CHECK(client.push(kSerial, local, "/data/local/tmp/file", 0755));
+    CHECK(server.sendSpec == "/data/local/tmp/file,33261"); // 0100755
+    CHECK(server.dataSizes == vector<uint32_t>({ 65536, 65536, 22528 }));
+    CHECK(server.files["/data/local/tmp/file"] == content);
+
+    const string pulled = "AdbClientTest.pull.tmp";
+    CHECK(client.pull(kSerial, "/data/local/tmp/file", pulled));
+    CHECK(readFile(pulled) == content);
+    // the sync connection of the push is reused
+    CHECK(server.syncConnections == 1);
+
+    CHECK(!client.pull(kSerial, "/missing", pulled));
+    CHECK(client.getLastError() == "/missing: No such file or directory");
+    CHECK(!fileExists(pulled));
+
+    // a failed transfer isn't reused
+    CHECK(client.pull(kSerial, "/data/local/tmp/file", pulled));
+    CHECK(server.syncConnections == 2);
+
+    CHECK(!client.pull(kSerial, "/short", pulled));
+    CHECK(client.getLastError() == "connection lost while pulling /short");
+    CHECK(!fileExists(pulled));
+
+    CHECK(!client.push(kSerial, local, "/readonly/file"));
+    CHECK(client.getLastError() == "/readonly/file: Permission denied");
+
+    CHECK(!client.push(kSerial, "no-such-local-file", "/data/local/tmp/x"));
+    CHECK(client.getLastError() == "failed to read no-such-local-file");
+
+    remove(local.c_str());
+    remove(pulled.c_str());
+}
+
+int main()
+{
+    FakeAdbServer server;
+    CHECK(server.start());
+    {
+        AdbClient client("127.0.0.1", server.port);
+        testHost(server, client);
+        testShell(server, client);
+        testSync(server, client);
+    }
+    server.stop();
+
+    printf("AdbClientTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
@@ -0,0 +1,91 @@
+// AdbShell against fake-adb.sh, a local sh standing in for the device shell
+#include "AdbShell.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+static void testDemux(AdbShell& shell)
+{
+    // outputs without a trailing newline, on stderr, empty, and a line that looks like a sentinel
+    vector<string> cmds = {
+        "echo a; echo b",
+        "printf 'no newline'",
+        "echo err >&2",
+        "true",
+        "echo __perf_doctor_00000000:1:0",
+        "cat", // stdin is /dev/null, the rest of the batch must not be swallowed
+        "echo last",
+    };
+    vector<vector<string>> outputs;
+    CHECK(shell.execute(cmds, outputs));
+    CHECK(outputs.size() == cmds.size());
+    CHECK(outputs[0] == vector<string>({ "a", "b" }));
+    CHECK(outputs[1] == vector<string>({ "no newline" }));
+    CHECK(outputs[2] == vector<string>({ "err" }));
+    CHECK(outputs[3].empty());
+    CHECK(outputs[4] == vector<string>({ "__perf_doctor_00000000:1:0" }));
+    CHECK(outputs[5].empty());
+    CHECK(outputs[6] == vector<string>({ "last" }));
+
+    // the next batch reads only its own output
+    CHECK(shell.execute("echo again") == vector<string>({ "again" }));
+
+    string raw;
+    CHECK(shell.executeRaw("printf 'x\\ny\\n'", raw));
+    CHECK(raw == "x\ny\n");
+
+    // 10 commands, the sentinel of 1 is a prefix of the one of 10
+    cmds.clear();
+    for (int i = 0; i < 11; i++)
+        cmds.push_back("echo " + to_string(i));
+    CHECK(shell.execute(cmds, outputs));
+    for (int i = 0; i < 11; i++)
+        CHECK(outputs[i] == vector<string>({ to_string(i) }));
+}
+
+static void testTimeout(AdbShell& shell)
+{
+    auto start = chrono::steady_clock::now();
+    vector<vector<string>> outputs;
+    CHECK(!shell.execute({ "sleep 5" }, outputs, 0.5f));
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    CHECK(seconds < 2);
+    CHECK(!shell.isAlive());
+
+    // a fresh shell, the late output of sleep can't show up in the next batch
+    CHECK(shell.start());
+    CHECK(shell.execute("echo fresh") == vector<string>({ "fresh" }));
+}
+
+static void testRespawn(AdbShell& shell)
+{
+    vector<vector<string>> outputs;
+    CHECK(!shell.execute({ "kill -9 $$" }, outputs));
+    CHECK(!shell.isAlive());
+    CHECK(!shell.execute({ "echo dead" }, outputs));
+
+    CHECK(shell.start());
+    CHECK(shell.isAlive());
+    CHECK(shell.execute("echo back") == vector<string>({ "back" }));
+}
+
+int main()
+{
+#ifndef _WIN32
+    // no adb server on this port, so AdbShell falls back to the adb executable
+    setenv("ANDROID_ADB_SERVER_PORT", "1", 1);
+#endif
+    AdbShell shell(FAKE_ADB, "fake-serial");
+    CHECK(shell.start());
+
+    testDemux(shell);
+    testTimeout(shell);
+    testRespawn(shell);
+
+    shell.stop();
+    printf("AdbShellTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
@@ -0,0 +1,144 @@
+// perf-agent built for the host, sampling this process and a fake thermal zone,
+// decoded by AgentReceiver the way a session does through `adb forward`
+#include "AgentReceiver.h"
+#include "Process.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <string>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace agent;
+
+// A port nobody listens on right now
+static int getFreePort()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int port = 0;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0 && getsockname(fd, (sockaddr*)&addr, &len) == 0)
+        port = ntohs(addr.sin_port);
+    close(fd);
+    return port;
+}
+
+// Keeps the cpu busy so utime of this process moves
+static void spin(int ms)
+{
+    auto end = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    volatile uint64_t x = 0;
+    while (chrono::steady_clock::now() < end)
+        x = x + 1;
+}
+
+int main()
+{
+    char thermalPath[] = "/tmp/perf-agent-thermal-XXXXXX";
+    int fd = mkstemp(thermalPath);
+    CHECK(fd >= 0);
+    const char kTemp[] = "45500\n";
+    CHECK(write(fd, kTemp, sizeof(kTemp) - 1) == sizeof(kTemp) - 1);
+    close(fd);
+
+    int port = getFreePort();
+    CHECK(port > 0);
+    Process agentProcess;
+    CHECK(agentProcess.start(string("exec ") + PERF_AGENT + " --port " + to_string(port) + " --pid " + to_string(getpid())
+        + " --thermal-cpu " + thermalPath + " --cpu-hz 20 --mem-hz 4 --thermal-hz 4"));
+
+    // listening once it says so
+    string output;
+    for (int i = 0; i < 20 && output.find("listening") == string::npos; i++)
+    {
+        if (agentProcess.read(output, nullptr, 100) < 0)
+            break;
+    }
+    CHECK(output.find("listening") != string::npos);
+
+    AgentReceiver receiver;
+    CHECK(receiver.connect(port));
+
+    AgentSamples all;
+    auto end = chrono::steady_clock::now() + chrono::seconds(1);
+    while (chrono::steady_clock::now() < end)
+    {
+        spin(50);
+        AgentSamples samples;
+        CHECK(receiver.receive(samples, 50));
+        if (samples.start_ns)
+        {
+            all.start_ns = samples.start_ns;
+            all.cpu_count = samples.cpu_count;
+        }
+        all.cpu.insert(all.cpu.end(), samples.cpu.begin(), samples.cpu.end());
+        all.app_cpu.insert(all.app_cpu.end(), samples.app_cpu.begin(), samples.app_cpu.end());
+        all.memory.insert(all.memory.end(), samples.memory.begin(), samples.memory.end());
+        all.thermal.insert(all.thermal.end(), samples.thermal.begin(), samples.thermal.end());
+        all.frames.insert(all.frames.end(), samples.frames.begin(), samples.frames.end());
+    }
+    receiver.close();
+
+    // the hello comes first, every record after it is stamped on the same clock
+    CHECK(all.start_ns > 0);
+    CHECK(all.cpu_count == (uint32_t)sysconf(_SC_NPROCESSORS_CONF));
+
+    // a total line and a line per core each round, about 20 rounds
+    size_t totals = 0;
+    for (const auto& record : all.cpu)
+    {
+        CHECK(record.header.type == RECORD_CPU && record.header.size == sizeof(CpuRecord));
+        CHECK(record.header.timestamp_ns >= all.start_ns);
+        CHECK(record.cpu_id >= -1 && record.cpu_id < (int)all.cpu_count);
+        if (record.cpu_id == -1)
+        {
+            totals++;
+            CHECK(record.user + record.sys + record.idle > 0);
+        }
+    }
+    CHECK(totals >= 10);
+    CHECK(all.cpu.size() >= totals * 2);
+
+    // utime and stime of this process, spinning for a second
+    CHECK(all.app_cpu.size() >= 10);
+    if (all.app_cpu.size() >= 2)
+    {
+        const auto& first = all.app_cpu.front();
+        const auto& last = all.app_cpu.back();
+        CHECK(last.utime + last.stime > first.utime + first.stime);
+        CHECK(last.header.timestamp_ns > first.header.timestamp_ns);
+    }
+
+    CHECK(all.memory.size() >= 2);
+    for (const auto& record : all.memory)
+        CHECK(record.pss_kb > 0 && record.private_dirty_kb > 0);
+
+    CHECK(all.thermal.size() >= 2);
+    for (const auto& record : all.thermal)
+    {
+        CHECK(record.cpu == 45500);
+        CHECK(record.gpu == INT32_MIN && record.battery == INT32_MIN);
+    }
+
+    CHECK(all.frames.empty()); // no --surface
+
+    // the agent exits when its client goes away
+    int exitCode = -1;
+    bool exited = agentProcess.wait(3000, exitCode);
+    CHECK(exited);
+    if (!exited)
+        agentProcess.kill();
+    unlink(thermalPath);
+
+    printf("AgentTest: %zu cpu, %zu app_cpu, %zu memory, %zu thermal records, %d failures\n",
+        all.cpu.size(), all.app_cpu.size(), all.memory.size(), all.thermal.size(), getTestFailures());
+    return getTestFailures();
+}
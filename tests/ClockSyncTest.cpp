@@ -0,0 +1,78 @@
+// ClockSync on a simulated device: frames every 16 ms read every 500 ms, then a pause,
+// and the realtime clock stepping forward and back
+#include "ClockSync.h"
+#include "TestUtil.h"
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+struct Device
+{
+    double monotonic = 1000000;
+    double offset = 1.7e12; // realtime - monotonic
+    double lastFrame = 0;
+    bool paused = false;
+    mt19937 rng{ 1 };
+
+    // one read of the frame window, 500 ms after the last one
+    void read(ClockSync& sync)
+    {
+        monotonic += 500;
+        if (!paused)
+        {
+            // the newest frame is up to a frame and a bit older than the read
+            lastFrame = monotonic - uniform_real_distribution<double>(0, 20)(rng);
+        }
+        sync.addObservation(monotonic + offset, lastFrame);
+    }
+
+    void run(ClockSync& sync, double seconds)
+    {
+        for (int i = 0; i < seconds * 2; i++)
+            read(sync);
+    }
+
+    // the mapped realtime of now against the monotonic clock
+    double getError(const ClockSync& sync) const
+    {
+        return fabs(sync.toMonotonic(monotonic + offset) - monotonic);
+    }
+};
+
+int main()
+{
+    Device device;
+    ClockSync sync;
+    device.run(sync, 60);
+    CHECK(sync.isSynced());
+    CHECK(device.getError(sync) < 25);
+
+    // no fresh frames for half a minute must not move the line
+    device.paused = true;
+    device.run(sync, 30);
+    device.paused = false;
+    CHECK(device.getError(sync) < 25);
+    device.run(sync, 10);
+    CHECK(device.getError(sync) < 25);
+
+    // NTP steps the clock forward, the mapping follows within a few windows
+    device.offset += 10000;
+    device.run(sync, 2);
+    CHECK(device.getError(sync) > 5000); // still on the old line
+    device.run(sync, 20);
+    CHECK(device.getError(sync) < 25);
+    device.run(sync, 60);
+    CHECK(device.getError(sync) < 25);
+
+    // and back
+    device.offset -= 4000;
+    device.run(sync, 10);
+    CHECK(device.getError(sync) < 25);
+    device.run(sync, 60);
+    CHECK(device.getError(sync) < 25);
+
+    printf("ClockSyncTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
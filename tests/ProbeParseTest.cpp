@@ -0,0 +1,453 @@
+// The probe parsers on outputs in probes/, and what a sample costs to parse now and with the code
+// before TextParse, which split every line into strings and converted them with stringstream
+#include "GfxFrameStats.h"
+#include "ProbeParse.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace
+{
+    struct Sample
+    {
+        vector<string> latency, proc_stat, proc_pid_stat, meminfo, smaps_rollup;
+        string gfxinfo;
+    };
+
+    string readProbe(const char* name)
+    {
+        ifstream file(string(PROBE_DIR "/") + name + ".txt", ios::binary);
+        CHECK(file);
+        stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    }
+
+    // as splitAdbOutput() hands them to the parsers, empty lines dropped
+    vector<string> splitLines(const string& text)
+    {
+        vector<string> lines;
+        stringstream ss(text);
+        string line;
+        while (getline(ss, line))
+        {
+            if (!line.empty()) lines.push_back(line);
+        }
+        return lines;
+    }
+
+    Sample loadSample()
+    {
+        Sample sample;
+        sample.latency = splitLines(readProbe("SurfaceFlinger_latency"));
+        sample.gfxinfo = readProbe("dumpsys_gfxinfo");
+        sample.proc_stat = splitLines(readProbe("proc_stat"));
+        sample.proc_pid_stat = splitLines(readProbe("proc_pid_stat"));
+        sample.meminfo = splitLines(readProbe("dumpsys_meminfo"));
+        sample.smaps_rollup = splitLines(readProbe("proc_pid_smaps_rollup"));
+        return sample;
+    }
+
+    bool isNear(float a, float b) { return fabs(a - b) < 1e-3f; }
+
+    // The parsing before TextParse, with std stand-ins for the Cinder split() and fromString() it used
+    namespace before
+    {
+        vector<string> split(const string& str, char separator)
+        {
+            // separators in a row count as one, but a leading one still gives an empty first token
+            vector<string> tokens(1);
+            for (size_t i = 0; i < str.size(); i++)
+            {
+                if (str[i] != separator)
+                    tokens.back() += str[i];
+                else if (i == 0 || str[i - 1] != separator)
+                    tokens.emplace_back();
+            }
+            return tokens;
+        }
+
+        template <typename T>
+        T fromString(const string& str)
+        {
+            stringstream ss;
+            ss << str;
+            T value{};
+            ss >> value;
+            return value;
+        }
+
+        CpuStat cpuStat(const string& line)
+        {
+            CpuStat stat;
+            char cpu[16];
+            sscanf(line.c_str(), "%15s%ld%ld%ld%ld%ld%ld%ld", cpu, &stat.user, &stat.nice, &stat.sys, &stat.idle, &stat.iowait, &stat.irq, &stat.softirq);
+            stat.cpu_id = cpu[3] - '0';
+            return stat;
+        }
+
+        AppCpuStat appCpuStat(const string& line)
+        {
+            // one token late, tokens[14] is stime
+            AppCpuStat stat;
+            auto tokens = split(line, ' ');
+            stat.utime = fromString<long int>(tokens[14]);
+            stat.stime = fromString<long int>(tokens[15]);
+            stat.cutime = fromString<long int>(tokens[16]);
+            stat.cstime = fromString<long int>(tokens[17]);
+            return stat;
+        }
+
+        void latency(const vector<string>& lines, vector<uint64_t>& frames)
+        {
+            vector<vector<string>> timestamps;
+            for (size_t i = 1; i < lines.size(); i++)
+            {
+                auto tokens = split(lines[i], '\t');
+                if (tokens.size() < 3) continue;
+                if (tokens[0][0] == '0') continue;
+                timestamps.push_back({ tokens[0], tokens[1], tokens[2] });
+            }
+            for (const auto& triple : timestamps)
+            {
+                auto ts = fromString<uint64_t>(triple[2]);
+                if (ts == INT64_MAX) continue;
+                frames.push_back(ts / 1000000);
+            }
+        }
+
+        void gfxinfo(const vector<string>& lines, const string& packageName, vector<uint64_t>& frames)
+        {
+            bool find_app = false;
+            bool find_timestamps = false;
+            for (const auto& line : lines)
+            {
+                if (find_timestamps)
+                {
+                    if (line.find("---PROFILEDATA---") != string::npos)
+                        break;
+                    auto tokens = split(line, ',');
+                    if (fromString<uint64_t>(tokens[0]) != 0)
+                        continue;
+                    frames.push_back(fromString<uint64_t>(tokens[13]) / 1000000);
+                }
+                if (line.find(packageName) != string::npos)
+                    find_app = true;
+                if (find_app && line.find("Flags,IntendedVsync") != string::npos)
+                    find_timestamps = true;
+            }
+        }
+
+        void splitMeminfoRow(const string& line, string& label, vector<float>& values)
+        {
+            label.clear();
+            values.clear();
+            for (const auto& token : split(line, ' '))
+            {
+                if (token.empty()) continue;
+                if (isdigit(token[0]))
+                    values.push_back(fromString<float>(token));
+                else if (values.empty())
+                    label += label.empty() ? token : " " + token;
+            }
+        }
+
+        bool meminfo(const vector<string>& lines, MemoryStat& stat)
+        {
+            static const unordered_map<string, float MemoryStat::*> kRows = {
+                { "Native Heap", &MemoryStat::pssNativeHeap },
+                { "EGL mtrack", &MemoryStat::pssEGL },
+                { "Gfx dev", &MemoryStat::pssGfx },
+                { "GL mtrack", &MemoryStat::pssGL },
+                { "Unknown", &MemoryStat::pssUnknown },
+            };
+
+            string label;
+            vector<float> values;
+            for (const auto& line : lines)
+            {
+                splitMeminfoRow(line, label, values);
+                if (values.empty()) continue;
+
+                if (label == "TOTAL")
+                {
+                    if (values.size() < 3) return false;
+                    stat.pssTotal = values[0] / 1024;
+                    stat.privateDirty = values[1] / 1024;
+                    stat.privateClean = values[2] / 1024;
+                    return true;
+                }
+
+                auto it = kRows.find(label);
+                if (it != kRows.end())
+                    stat.*(it->second) = values[0] / 1024;
+            }
+            return false;
+        }
+
+        bool fastMemory(const vector<string>& lines, MemoryStat& stat)
+        {
+            bool found = false;
+            for (const auto& line : lines)
+            {
+                auto colon = line.find(':');
+                if (colon == string::npos) continue;
+
+                auto key = line.substr(0, colon);
+                float mb = strtof(line.c_str() + colon + 1, nullptr) / 1024;
+                if (key == "Pss") stat.pssFast = mb, found = true;
+                else if (key == "Private_Clean") stat.privateClean = mb;
+                else if (key == "Private_Dirty") stat.privateDirty = mb;
+            }
+            return found;
+        }
+    }
+
+    void testCpuStat(const Sample& sample)
+    {
+        CpuStat total(sample.proc_stat[0]);
+        CHECK(total.cpu_id == -1);
+        CHECK(total.user == 1834512 && total.nice == 98231 && total.sys == 1102387 && total.idle == 29873412);
+        CHECK(total.iowait == 43122 && total.irq == 212876 && total.softirq == 98734);
+
+        int cores = 0;
+        for (const auto& line : sample.proc_stat)
+        {
+            if (line.compare(0, 3, "cpu") != 0) continue;
+            CpuStat stat(line);
+            if (stat.cpu_id >= 0)
+            {
+                CHECK(stat.cpu_id == cores);
+                CHECK(stat.getAll() > stat.getIdle() && stat.getIdle() > 0);
+                CHECK(stat.getAll() == before::cpuStat(line).getAll());
+                cores++;
+            }
+        }
+        CHECK(cores == 8);
+
+        // the cores past 9 of big phones, which a single digit read as core 1
+        CpuStat core10("cpu10 1303 66 1406 73744 56 0 27 0 0 0");
+        CHECK(core10.cpu_id == 10);
+        CHECK(core10.user == 1303 && core10.idle == 73744 && core10.softirq == 27);
+
+        // fields a kernel doesn't print stay 0
+        CpuStat old("cpu3 10 20 30 40");
+        CHECK(old.cpu_id == 3 && old.idle == 40 && old.iowait == 0 && old.softirq == 0);
+
+        CpuStat a("cpu 100 0 100 800 0 0 0"), b("cpu 200 0 200 1400 0 0 0");
+        CHECK(isNear(calcCpuUsage(a, b), 25));
+    }
+
+    void testAppCpuStat(const Sample& sample)
+    {
+        // utime, stime, cutime and cstime are fields 14 to 17 of proc(5)
+        AppCpuStat stat(sample.proc_pid_stat[0]);
+        CHECK(stat.utime == 38821);
+        CHECK(stat.stime == 9123);
+        CHECK(stat.cutime == 12);
+        CHECK(stat.cstime == 7);
+        CHECK(stat.getActiveTime() == 38821 + 9123 + 12 + 7);
+
+        // a thread can name itself with spaces and brackets, the fields count from the last ')'
+        AppCpuStat named("1234 (Thread (1) x) S 1 1234 0 0 -1 4194560 100 0 0 0 501 302 3 4 20 0 1 0 100 1000 10");
+        CHECK(named.utime == 501 && named.stime == 302 && named.cutime == 3 && named.cstime == 4);
+        AppCpuStat spaced("77 (Unity Main ) R 1 77 0 0 -1 0 0 0 0 0 11 22 33 44 20 0 1 0");
+        CHECK(spaced.utime == 11 && spaced.stime == 22 && spaced.cutime == 33 && spaced.cstime == 44);
+
+        // "cat: /proc/1234/stat: No such file or directory" and cut off lines read as nothing
+        AppCpuStat missing("cat: /proc/1234/stat: No such file or directory");
+        CHECK(missing.getActiveTime() == 0);
+        AppCpuStat cut("1234 (app) S 1 1234 0 0 -1 4194560 100 0 0 0 501");
+        CHECK(cut.utime == 501 && cut.stime == 0);
+
+        CpuStat a("cpu 100 0 100 800 0 0 0"), b("cpu 200 0 200 1400 0 0 0");
+        AppCpuStat appA("1 (app) S 1 1 0 0 -1 0 0 0 0 0 10 10 0 0"), appB("1 (app) S 1 1 0 0 -1 0 0 0 0 0 30 30 0 0");
+        CHECK(isNear(calcAppCpuUsage(a, b, appA, appB, 8), 40 * 8 * 100.0f / 800));
+    }
+
+    void testCpuFiles()
+    {
+        int cpu = -1, value = -1;
+        CHECK(parseCpuFileLine("/sys/devices/system/cpu/cpu10/cpufreq/scaling_cur_freq:1800000", cpu, value));
+        CHECK(cpu == 10 && value == 1800000);
+        CHECK(!parseCpuFileLine("1800000", cpu, value));
+
+        float fps = 0;
+        CHECK(parseDisplayFps("  cur: 90", fps));
+        CHECK(isNear(fps, 90));
+        CHECK(!parseDisplayFps("cur: 0", fps));
+        CHECK(!parseDisplayFps("refresh-rate : 60.000002", fps));
+    }
+
+    void testLatency(const Sample& sample)
+    {
+        vector<uint64_t> frames, oldFrames;
+        CHECK(parseLatency(sample.latency, frames) == 16666666);
+        before::latency(sample.latency, oldFrames);
+        // 9 empty slots of the ring and the newest frame with its fence pending are left out
+        CHECK(frames.size() == 127 - 9 - 1);
+        CHECK(frames == oldFrames);
+        for (size_t i = 1; i < frames.size(); i++)
+            CHECK(frames[i] > frames[i - 1]);
+
+        frames.clear();
+        CHECK(parseLatency({}, frames) == 0 && frames.empty());
+        CHECK(parseLatency({ "16666666", "garbage", "0\t0\t0", "1000000\t2000000\t3000000" }, frames) == 16666666);
+        CHECK(frames.size() == 1 && frames[0] == 3);
+    }
+
+    void testGfxinfo(const Sample& sample)
+    {
+        GfxFrameStatsParser parser;
+        vector<uint64_t> window, oldFrames;
+        vector<pair<uint64_t, GfxFramePhases>> newFrames;
+        CHECK(parser.parse(sample.gfxinfo, window, newFrames));
+        before::gfxinfo(splitLines(sample.gfxinfo), "com.example.game", oldFrames);
+        // the two outliers with flags set are left out
+        CHECK(window.size() == 120 - 2);
+        CHECK(window == oldFrames);
+        CHECK(newFrames.size() == window.size());
+        for (const auto& frame : newFrames)
+            CHECK(frame.second.getUiThreadMs() > 0 && frame.second.getRenderThreadMs() > 0);
+
+        // the next dump of the same frames has nothing new to break down
+        window.clear();
+        newFrames.clear();
+        CHECK(parser.parse(sample.gfxinfo, window, newFrames));
+        CHECK(window.size() == 120 - 2 && newFrames.empty());
+    }
+
+    void testMeminfo(const Sample& sample)
+    {
+        MemoryStat stat, old;
+        CHECK(parseMeminfo(sample.meminfo, stat));
+        CHECK(isNear(stat.pssTotal, 523553 / 1024.0f));
+        CHECK(isNear(stat.privateDirty, 451292 / 1024.0f));
+        CHECK(isNear(stat.privateClean, 58416 / 1024.0f));
+        CHECK(isNear(stat.pssNativeHeap, 183524 / 1024.0f));
+        CHECK(isNear(stat.pssEGL, 96));
+        CHECK(isNear(stat.pssGL, 60));
+        CHECK(isNear(stat.pssGfx, 48512 / 1024.0f));
+        CHECK(isNear(stat.pssUnknown, 12340 / 1024.0f));
+        CHECK(before::meminfo(sample.meminfo, old));
+        CHECK(memcmp(&stat, &old, sizeof(stat)) == 0);
+
+        // a dump cut before the TOTAL row
+        MemoryStat cut;
+        CHECK(!parseMeminfo(vector<string>(sample.meminfo.begin(), sample.meminfo.begin() + 10), cut));
+        CHECK(!parseMeminfo({ "No process found for: com.example.game" }, cut));
+
+        MemoryStat fast;
+        CHECK(parseFastMemory(sample.smaps_rollup, fast));
+        CHECK(isNear(fast.pssFast, 498213 / 1024.0f));
+        CHECK(isNear(fast.privateClean, 58012 / 1024.0f));
+        CHECK(isNear(fast.privateDirty, 401877 / 1024.0f));
+
+        // statm of an app that isn't debuggable, the resident pages stand in for Pss
+        MemoryStat statm;
+        CHECK(parseFastMemory({ "4555813 149563 40311 2 0 172404 0" }, statm));
+        CHECK(isNear(statm.pssFast, 149563 * 4 / 1024.0f));
+        CHECK(statm.privateClean == -1 && statm.privateDirty == -1);
+        MemoryStat none;
+        CHECK(!parseFastMemory({ "cat: /proc/1234/statm: No such file or directory" }, none));
+        CHECK(!parseFastMemory({}, none));
+    }
+
+    template <typename F>
+    double timeUs(int iterations, F f)
+    {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            f();
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+
+    // What updateProfiler() spends on the text of one sample, per probe
+    void benchmark(const Sample& sample)
+    {
+        const int kIterations = 2000;
+        const auto gfxLines = splitLines(sample.gfxinfo);
+        size_t sink = 0;
+
+        struct Probe
+        {
+            const char* name;
+            double beforeUs, afterUs;
+        };
+        Probe probes[] = {
+            { "SurfaceFlinger --latency",
+                timeUs(kIterations, [&] { vector<uint64_t> frames; before::latency(sample.latency, frames); sink += frames.size(); }),
+                timeUs(kIterations, [&] { vector<uint64_t> frames; parseLatency(sample.latency, frames); sink += frames.size(); }) },
+            { "gfxinfo framestats",
+                timeUs(kIterations, [&] { vector<uint64_t> frames; before::gfxinfo(gfxLines, "com.example.game", frames); sink += frames.size(); }),
+                // the parser lives across samples, as mGfxParser does, so only the first dump breaks down every row
+                [&] {
+                    GfxFrameStatsParser parser;
+                    return timeUs(kIterations, [&] {
+                        vector<uint64_t> window;
+                        vector<pair<uint64_t, GfxFramePhases>> newFrames;
+                        parser.parse(sample.gfxinfo, window, newFrames);
+                        sink += window.size();
+                    });
+                }() },
+            { "/proc/stat",
+                timeUs(kIterations, [&] {
+                    for (const auto& line : sample.proc_stat)
+                        if (line.find("cpu") != string::npos) sink += before::cpuStat(line).idle;
+                }),
+                timeUs(kIterations, [&] {
+                    for (const auto& line : sample.proc_stat)
+                        if (line.compare(0, 3, "cpu") == 0) sink += CpuStat(line).idle;
+                }) },
+            { "/proc/pid/stat",
+                timeUs(kIterations, [&] { sink += before::appCpuStat(sample.proc_pid_stat[0]).utime; }),
+                timeUs(kIterations, [&] { sink += AppCpuStat(sample.proc_pid_stat[0]).utime; }) },
+            { "meminfo + smaps_rollup",
+                timeUs(kIterations, [&] {
+                    MemoryStat full, fast;
+                    sink += before::meminfo(sample.meminfo, full) + before::fastMemory(sample.smaps_rollup, fast);
+                }),
+                timeUs(kIterations, [&] {
+                    MemoryStat full, fast;
+                    sink += parseMeminfo(sample.meminfo, full) + parseFastMemory(sample.smaps_rollup, fast);
+                }) },
+        };
+
+        double beforeUs = 0, afterUs = 0;
+        for (const auto& probe : probes)
+        {
+            printf("%-26s %8.2f us -> %6.2f us per sample\n", probe.name, probe.beforeUs, probe.afterUs);
+            beforeUs += probe.beforeUs;
+            afterUs += probe.afterUs;
+        }
+        printf("%-26s %8.2f us -> %6.2f us per sample, %.1fx faster\n", "total", beforeUs, afterUs, beforeUs / afterUs);
+        CHECK(sink > 0);
+        // far apart enough not to flake on a busy machine
+        CHECK(afterUs < beforeUs);
+    }
+}
+
+int main()
+{
+    auto sample = loadSample();
+    testCpuStat(sample);
+    testAppCpuStat(sample);
+    testCpuFiles();
+    testLatency(sample);
+    testGfxinfo(sample);
+    testMeminfo(sample);
+    benchmark(sample);
+
+    printf("ProbeParseTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
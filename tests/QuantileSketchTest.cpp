@@ -0,0 +1,80 @@
+// QuantileSketch against exact quantiles of lognormal frame times, on one sketch and merged from several
+#include "QuantileSketch.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    struct Tolerance
+    {
+        double q;
+        double relative; // of the value
+    };
+    // p50 / p90 within 0.1%, p99 within about 1%
+    const Tolerance kTolerances[] = { { 0.5, 0.001 }, { 0.9, 0.001 }, { 0.99, 0.01 }, { 0.01, 0.01 } };
+
+    double getExact(const vector<float>& sorted, double q)
+    {
+        return sorted[size_t(q * (sorted.size() - 1) + 0.5)];
+    }
+
+    void checkQuantiles(const char* name, const QuantileSketch& sketch, const vector<float>& sorted)
+    {
+        CHECK(sketch.getCount() == sorted.size());
+        CHECK(sketch.getQuantile(0) == sorted.front());
+        CHECK(sketch.getQuantile(1) == sorted.back());
+        for (const auto& tolerance : kTolerances)
+        {
+            double exact = getExact(sorted, tolerance.q);
+            double error = fabs(sketch.getQuantile(tolerance.q) - exact) / exact;
+            printf("%s p%g: %.3f exact %.3f, %.3f%% off\n", name, tolerance.q * 100, sketch.getQuantile(tolerance.q), exact, error * 100);
+            CHECK(error < tolerance.relative);
+        }
+    }
+}
+
+int main()
+{
+    QuantileSketch empty;
+    CHECK(empty.empty() && empty.getQuantile(0.5) == 0);
+
+    // 3M frames around 60 fps, the slow tail of a game
+    const int kFrames = 3000000;
+    const int kSessions = 8;
+    mt19937 rng(3);
+    lognormal_distribution<float> frameTime(log(16.6f), 0.25f);
+    vector<float> values(kFrames);
+    QuantileSketch whole;
+    QuantileSketch sessions[kSessions];
+    for (int i = 0; i < kFrames; i++)
+    {
+        values[i] = frameTime(rng);
+        whole.add(values[i]);
+        // sessions of different lengths, as devices join at different times
+        sessions[i % 3 == 0 ? 0 : i % kSessions].add(values[i]);
+    }
+    sort(values.begin(), values.end());
+    checkQuantiles("one sketch", whole, values);
+
+    QuantileSketch merged;
+    for (const auto& session : sessions)
+        merged.merge(session);
+    checkQuantiles("merged", merged, values);
+
+    // merging again into a sketch with values of its own
+    QuantileSketch twice = sessions[0];
+    for (int i = 1; i < kSessions; i++)
+        twice.merge(sessions[i]);
+    checkQuantiles("merged into one", twice, values);
+
+    // the memory doesn't grow with the stream
+    CHECK(whole.getMemoryBytes() < 64 * 1024);
+
+    printf("QuantileSketchTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
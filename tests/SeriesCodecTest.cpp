@@ -0,0 +1,197 @@
+// SeriesCodec round trips, bit for bit, and its compression and decode speed on a synthetic session
+#include "SeriesCodec.h"
+#include "SeriesStore.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    uint32_t getBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float fromBits(uint32_t bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    bool isSame(T a, T b) { return a == b; }
+    template <>
+    bool isSame(float a, float b) { return getBits(a) == getBits(b); }
+
+    // every prefix length a chunk can be sealed or measured at matters, the ends of the bit stream move
+    template <typename T>
+    void checkRoundTrip(const vector<T>& values)
+    {
+        const size_t counts[] = { 1, 2, 3, 63, 64, 65, values.size() };
+        for (size_t count : counts)
+        {
+            if (count > values.size())
+                continue;
+            vector<uint64_t> words;
+            encodeChunk(values.data(), count, words);
+            vector<T> decoded(count);
+            decodeChunk(words, count, decoded.data());
+            bool same = true;
+            for (size_t i = 0; i < count; i++)
+                same = same && isSame(values[i], decoded[i]);
+            CHECK(same);
+        }
+    }
+}
+
+static void testTimestamps()
+{
+    mt19937 rng(5);
+    vector<uint64_t> times;
+    uint64_t ts = 1700000000000ull; // CLOCK_REALTIME in ms
+    for (int i = 0; i < 4096; i++)
+    {
+        times.push_back(ts);
+        if (i % 500 == 499)
+            ts += 30000; // a pause
+        else if (i % 97 == 0)
+            ts += 0; // the same ms twice
+        else if (i % 1000 == 999)
+            ts += 1ull << 40; // a clock nobody expected
+        else
+            ts += 16 + rng() % 7; // frames with jitter
+    }
+    checkRoundTrip(times);
+
+    // the extremes of every delta-of-delta bucket
+    vector<uint64_t> edges = { 0, 0, 1, 0, UINT64_MAX, 0, UINT64_MAX, 1ull << 63, 5, 5 + 64, 5, 5 + 256, 5, 5 + 2048, 5 };
+    checkRoundTrip(edges);
+}
+
+static void testValues()
+{
+    const float nan = numeric_limits<float>::quiet_NaN();
+    const float inf = numeric_limits<float>::infinity();
+
+    vector<float> constant(4096, 42.5f);
+    checkRoundTrip(constant);
+
+    // -0 and 0 differ in their bits, so do the NaNs
+    vector<float> special = { 0.0f, -0.0f, 0.0f, -0.0f, -0.0f, nan, nan, -nan, fromBits(0x7fc00123), 1.0f, nan,
+        inf, -inf, numeric_limits<float>::denorm_min(), numeric_limits<float>::max(), -numeric_limits<float>::max(), 0.0f };
+    for (int i = 0; i < 100; i++)
+        special.push_back(i % 3 == 0 ? -0.0f : i % 3 == 1 ? nan : 16.6f);
+    checkRoundTrip(special);
+
+    mt19937 rng(9);
+    uniform_real_distribution<float> dist(-1e6f, 1e6f);
+    vector<float> noise;
+    for (int i = 0; i < 4096; i++)
+        noise.push_back(dist(rng));
+    checkRoundTrip(noise);
+}
+
+// A chunk is sealed by the first value after it, set() unpacks it and seals it again
+static void testSetSealed()
+{
+    const size_t kChunk = ChunkedColumn<float>::kChunkSize;
+    ChunkedColumn<float> column;
+    vector<float> values;
+    for (size_t i = 0; i < kChunk * 2 + 10; i++)
+    {
+        values.push_back(i % 10 == 0 ? -0.0f : float(i % 100));
+        column.push_back(values.back());
+    }
+
+    auto check = [&] {
+        bool same = column.size() == values.size();
+        for (size_t i = 0; same && i < values.size(); i++)
+            same = isSame(column.get(i), values[i]);
+        CHECK(same);
+    };
+    check();
+
+    // into both sealed chunks, the first value of a chunk included, and the open one
+    const size_t changed[] = { 0, 7, kChunk - 1, kChunk, kChunk + 1234, kChunk * 2 + 3 };
+    float value = numeric_limits<float>::quiet_NaN();
+    for (size_t i : changed)
+    {
+        values[i] = value;
+        column.set(i, value);
+        value = value == value ? numeric_limits<float>::quiet_NaN() : 1e30f;
+    }
+    check();
+    CHECK(isSame(column.getChunkFirst(1), values[kChunk]));
+
+    // the open chunk with a value set is sealed like any other
+    while (values.size() < kChunk * 3 + 1)
+    {
+        values.push_back(float(values.size()));
+        column.push_back(values.back());
+    }
+    check();
+    column.set(kChunk * 2 + 3, 7.0f);
+    values[kChunk * 2 + 3] = 7.0f;
+    check();
+}
+
+// Compression and decode speed of a session of 1.5M frames, the numbers the replay Benchmark logs
+static void testSession()
+{
+    const int kFrames = 1500000;
+    mt19937 rng(1);
+    normal_distribution<float> jitter(0, 1.5f);
+    ChunkedColumn<uint64_t> times;
+    ChunkedColumn<float> frameTimes, fps, memory;
+    double ts = 1700000000000.0;
+    float mb = 900;
+    for (int i = 0; i < kFrames; i++)
+    {
+        // frame times in whole ms, fps and memory once a second with a decimal
+        float frameTime = roundf(max(8.0f, 16.6f + jitter(rng) + (i % 600 == 0 ? 40 : 0)));
+        ts += frameTime;
+        times.push_back(uint64_t(ts));
+        frameTimes.push_back(frameTime);
+        if (i % 60 == 0)
+        {
+            fps.push_back(roundf((60 + jitter(rng)) * 10) / 10);
+            mb += (rng() % 3 == 0) ? 0.5f : 0;
+            memory.push_back(mb);
+        }
+    }
+
+    SeriesCodecStats timeStats, valueStats;
+    times.measureCodec(timeStats);
+    frameTimes.measureCodec(valueStats);
+    fps.measureCodec(valueStats);
+    memory.measureCodec(valueStats);
+    auto values = timeStats.values + valueStats.values;
+    auto decodeSeconds = timeStats.decodeSeconds + valueStats.decodeSeconds;
+    printf("%d frames: timestamps %.1fx, values %.1fx smaller, decode %.0f M values/s\n", kFrames,
+        timeStats.getRatio(), valueStats.getRatio(), decodeSeconds > 0 ? values / decodeSeconds * 1e-6 : 0);
+
+    // loose floors, a codec that stops packing falls well below them
+    CHECK(timeStats.getRatio() > 6);
+    CHECK(valueStats.getRatio() > 2);
+    CHECK(frameTimes.getMemoryBytes() < kFrames * sizeof(float) / 2);
+}
+
+int main()
+{
+    testTimestamps();
+    testValues();
+    testSetSealed();
+    testSession();
+
+    printf("SeriesCodecTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
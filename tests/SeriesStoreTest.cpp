@@ -0,0 +1,142 @@
+// The levels of detail of a series against the samples they cover
+#include "SeriesStore.h"
+#include "TestUtil.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+// The newest bucket of every level, open or full, reads the min and max of its samples
+static void checkNewestBuckets(const Series& series, const vector<float>& values)
+{
+    size_t bucketSize = Series::kLodBase;
+    for (int level = 0; level < Series::kLodLevels; level++, bucketSize *= Series::kLodFactor)
+    {
+        SeriesView view;
+        view.series = &series;
+        view.level = level;
+        view.first = (values.size() - 1) / bucketSize;
+        view.count = 2;
+
+        size_t start = view.first * bucketSize;
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        for (size_t i = start; i < values.size(); i++)
+        {
+            lo = min(lo, values[i]);
+            hi = max(hi, values[i]);
+        }
+        CHECK(view.getTime(0) == series.getTime(start));
+        CHECK(view.get(0) == lo);
+        CHECK(view.get(1) == hi);
+    }
+}
+
+static void testAscending()
+{
+    SeriesStore store;
+    auto& series = store.add("ascending", { "value" });
+    vector<float> values;
+    for (int i = 0; i < 10000; i++)
+    {
+        values.push_back(float(i));
+        series.append(i, values.back());
+    }
+    checkNewestBuckets(series, values);
+}
+
+static void testRandom()
+{
+    SeriesStore store;
+    auto& series = store.add("random", { "value" });
+    vector<float> values;
+    mt19937 rng(7);
+    uniform_real_distribution<float> dist(-1000, 1000);
+    const size_t checkpoints[] = { 1, 31, 32, 33, 127, 128, 129, 5000, 40000, 600000 };
+    for (size_t size : checkpoints)
+    {
+        while (values.size() < size)
+        {
+            values.push_back(dist(rng));
+            series.append(values.size() * 10, values.back());
+        }
+        checkNewestBuckets(series, values);
+    }
+
+    // a changed sample in the open buckets moves their min and max
+    size_t i = values.size() - 3;
+    values[i] = 5000;
+    series.set(i, 0, values[i]);
+    checkNewestBuckets(series, values);
+    values[i] = 0;
+    series.set(i, 0, values[i]);
+    checkNewestBuckets(series, values);
+}
+
+// Summaries of ranges after samples were set, in full blocks of the range index and the open one
+static void testSummaryAfterSet()
+{
+    SeriesStore store;
+    auto& series = store.add("summary", { "value" });
+    vector<float> values;
+    mt19937 rng(11);
+    uniform_real_distribution<float> dist(0, 100);
+    for (size_t i = 0; i < RangeIndex::kBlockSize * 9 + 100; i++)
+    {
+        values.push_back(dist(rng));
+        series.append(i, values.back());
+    }
+    series.getSummary(0, values.size()); // builds the index
+
+    auto check = [&](size_t first, size_t last) {
+        auto summary = series.getSummary(first, last);
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        double sum = 0;
+        for (size_t i = first; i < last; i++)
+        {
+            lo = min(lo, values[i]);
+            hi = max(hi, values[i]);
+            sum += values[i];
+        }
+        CHECK(summary.Count == int(last - first));
+        CHECK(summary.Min == lo);
+        CHECK(summary.Max == hi);
+        CHECK(fabs(summary.Sum - sum) < 1e-6 * fabs(sum) + 1e-3);
+    };
+
+    // blocks 0 and 1 are read through the nodes above them, block 8 and the open one on their own
+    const size_t changed[] = { 0, 5000, RangeIndex::kBlockSize * 8 + 7, values.size() - 2 };
+    const float changedValues[] = { 1000, -1000, 2000, -2000 };
+    for (int k = 0; k < 4; k++)
+    {
+        values[changed[k]] = changedValues[k];
+        series.set(changed[k], 0, changedValues[k]);
+    }
+    check(0, values.size());
+    check(0, RangeIndex::kBlockSize * 8);
+    check(1, RangeIndex::kBlockSize * 8);
+    check(1, values.size() - 1);
+    check(RangeIndex::kBlockSize, RangeIndex::kBlockSize * 9);
+    check(RangeIndex::kBlockSize * 2, values.size());
+
+    // a min or max set back to an ordinary value no longer shows
+    for (size_t i : changed)
+    {
+        values[i] = 50;
+        series.set(i, 0, values[i]);
+    }
+    check(0, values.size());
+    check(0, RangeIndex::kBlockSize * 8);
+    check(RangeIndex::kBlockSize * 8, values.size());
+}
+
+int main()
+{
+    testAscending();
+    testRandom();
+    testSummaryAfterSet();
+
+    printf("SeriesStoreTest: %d failures\n", getTestFailures());
+    return getTestFailures();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+// A failed check is printed and counted, main() returns the count so ctest sees the failure
+inline int& getTestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            getTestFailures()++; \
+        } \
+    } while (0)
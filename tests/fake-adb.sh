@@ -0,0 +1,14 @@
+#!/bin/sh
+# Stands in for adb in the tests, `adb -s <serial> shell [cmd]` runs a local sh as the device shell
+if [ "$1" = "-s" ]; then
+    shift 2
+fi
+if [ "$1" != "shell" ]; then
+    echo "fake-adb: unsupported command: $*" >&2
+    exit 1
+fi
+shift
+if [ $# -eq 0 ]; then
+    exec sh
+fi
+exec sh -c "$*"